@@ -0,0 +1,195 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#include "tests/async.h"
+#include "tmplsql/async.h"
+#include "tmplsql/coro.h"
+#include "tmplsql/param.h"
+#include "tmplsql/lexical_cast.h"
+#include "tmplsql/tmplsql.h"
+
+#include <unistd.h>
+
+using namespace async_test;
+
+namespace {
+	struct counter : public tmplsql::async_callback {
+		counter() : completed_ok( 0 ) { }
+		void completed( const tmplsql::async_result_ptr& result ) {
+			monitor.lock();
+			if ( result->ok() ) {
+				++completed_ok;
+			}
+			monitor.notify();
+			monitor.unlock();
+		}
+		IceUtil::Monitor<IceUtil::Mutex> monitor;
+		int completed_ok;
+	};
+}
+
+void
+fixture::wait() {
+	tmplsql::async_engine engine( "", 4 );
+	CPPUNIT_ASSERT( 4 == engine.connections() );
+
+	// more than there are connections for, so some have to queue
+	std::vector<tmplsql::async_result_ptr> results;
+	for ( int i = 0; i < 20; ++i ) {
+		std::vector<std::string> params( 1, tmplsql::lexical_cast<std::string>( i ) );
+		results.push_back( engine.submit( "select $1::int * 2, pg_sleep( 0.05 )", params ) );
+	}
+	for ( int i = 0; i < 20; ++i ) {
+		tmplsql::rdms::result_set rows = results[i]->wait();
+		CPPUNIT_ASSERT( results[i]->ok() );
+		CPPUNIT_ASSERT( 1 == rows.size() );
+		CPPUNIT_ASSERT( i * 2 == tmplsql::lexical_cast<int>( rows.begin()[0] ) );
+	}
+
+	// straight from a handle, bound values and all
+	tmplsql::handle sql;
+	*sql << "select " << tmplsql::param( 42 ) << "::int";
+	tmplsql::async_result_ptr result = engine.submit( *sql );
+	CPPUNIT_ASSERT( "42" == std::string( result->wait().begin()[0] ) );
+}
+
+void
+fixture::callback() {
+	counter *c = new counter;
+	tmplsql::async_callback_ptr callback = c;
+	tmplsql::async_engine engine( "", 2 );
+	for ( int i = 0; i < 10; ++i ) {
+		engine.submit( "select 1", std::vector<std::string>(), tmplsql::rdms::text_results, callback );
+	}
+	c->monitor.lock();
+	while ( c->completed_ok < 10 ) {
+		c->monitor.wait();
+	}
+	c->monitor.unlock();
+	CPPUNIT_ASSERT( 10 == c->completed_ok );
+}
+
+void
+fixture::errors() {
+	tmplsql::async_engine engine( "", 1 );
+	tmplsql::async_result_ptr bad = engine.submit( "select * from tmplsql_no_such_table" );
+	tmplsql::async_result_ptr good = engine.submit( "select 1" );
+	bad->wait();
+	CPPUNIT_ASSERT( ! bad->ok() );
+	CPPUNIT_ASSERT( ! bad->error_msg().empty() );
+	good->wait();
+	CPPUNIT_ASSERT( good->ok() );
+
+	engine.stop();
+	tmplsql::async_result_ptr late = engine.submit( "select 1" );
+	CPPUNIT_ASSERT( late->ready() );
+	CPPUNIT_ASSERT( ! late->ok() );
+}
+
+void
+fixture::reconnect() {
+	tmplsql::async_engine engine( "", 1 );
+	tmplsql::async_result_ptr before = engine.submit( "select pg_backend_pid()" );
+	std::string pid( before->wait().begin()[0] );
+
+	// drop the engine's connection from the server end, and give the engine a moment to see it go
+	tmplsql::handle sql;
+	*sql << "select pg_terminate_backend( " << tmplsql::param( pid ) << "::int )";
+	CPPUNIT_ASSERT( sql->single_value() == "t" );
+	usleep( 200 * 1000 );
+
+	// the next query reconnects, without blocking the loop, and runs on the new connection
+	tmplsql::async_result_ptr after = engine.submit( "select pg_backend_pid()" );
+	tmplsql::async_result_ptr next = engine.submit( "select 1" );
+	tmplsql::rdms::result_set rows = after->wait();
+	CPPUNIT_ASSERT( after->ok() );
+	CPPUNIT_ASSERT( pid != std::string( rows.begin()[0] ) );
+	next->wait();
+	CPPUNIT_ASSERT( next->ok() );
+}
+
+#if __cplusplus >= 202002L && defined( __cpp_impl_coroutine )
+
+namespace {
+	// just enough of a coroutine type to run one to completion, flagging when it is done
+	struct detached {
+		struct promise_type {
+			detached get_return_object() { return detached(); }
+			std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+			std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+			void return_void() { }
+			void unhandled_exception() { }
+		};
+	};
+
+	struct async_id : public tmplsql::field<int> {
+		async_id() : tmplsql::field<int>( "id", "tmplsql_async_tester" ) { }
+	};
+	typedef tmplsql::query<async_id> id_query;
+
+	struct outcome {
+		outcome() : done( false ), exec_ok( false ), rows( 0 ), ids( 0 ), id_total( 0 ) { }
+		bool done;
+		bool exec_ok;
+		std::string value;
+		unsigned int rows;
+		unsigned int ids;
+		int id_total;
+	};
+
+	// everything after each co_await is carried on by whoever drains ready
+	detached
+	run_queries( tmplsql::async_engine& engine, tmplsql::co_queue& ready, outcome& out ) {
+		tmplsql::handle sql;
+		*sql << "select generate_series( 1, " << tmplsql::param( 3 ) << " )";
+		tmplsql::rdms::result_set rows = co_await tmplsql::co_select( engine, ready, *sql );
+		*sql << "select 'hello'";
+		std::string value = co_await tmplsql::co_single_value( engine, ready, *sql );
+		*sql << "select 1";
+		bool exec_ok = co_await tmplsql::co_exec( engine, ready, *sql );
+
+		id_query q;
+		for ( id_query::iterator it = co_await tmplsql::co_begin( engine, ready, q ); it != q.end(); ++it ) {
+			++out.ids;
+			out.id_total += it.get<0>();
+		}
+
+		out.rows = rows.size();
+		out.value = value;
+		out.exec_ok = exec_ok;
+		out.done = true;
+	}
+}
+
+void
+fixture::coroutine() {
+	tmplsql::handle sql;
+	*sql << "create table tmplsql_async_tester ( id int )";
+	CPPUNIT_ASSERT( sql->exec() );
+	*sql << "insert into tmplsql_async_tester select generate_series( 1, 3 )";
+	CPPUNIT_ASSERT( sql->exec() );
+
+	tmplsql::async_engine engine( "", 2 );
+	tmplsql::co_queue ready;
+	outcome out;
+	run_queries( engine, ready, out );
+	// the coroutine only ever runs here, so it can do as it likes with the engine, including waiting on it
+	while ( ! out.done ) {
+		ready.run_one();
+	}
+	CPPUNIT_ASSERT( 0 == ready.run_ready() );
+	CPPUNIT_ASSERT( 3 == out.rows );
+	CPPUNIT_ASSERT( "hello" == out.value );
+	CPPUNIT_ASSERT( out.exec_ok );
+	CPPUNIT_ASSERT( 3 == out.ids );
+	CPPUNIT_ASSERT( 6 == out.id_total );
+
+	*sql << "drop table tmplsql_async_tester";
+	CPPUNIT_ASSERT( sql->exec() );
+}
+
+#endif
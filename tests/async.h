@@ -0,0 +1,50 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+#ifndef _TESTS_ASYNC_H_
+#define _TESTS_ASYNC_H_
+
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/TestCaller.h>
+
+
+namespace async_test {
+	struct fixture : public CppUnit::TestFixture  {
+		void wait();
+		void callback();
+		void errors();
+		void reconnect();
+#if __cplusplus >= 202002L && defined( __cpp_impl_coroutine )
+		void coroutine();
+#endif
+	};
+	#if (__GNUC__)
+	__attribute__ ((unused))
+	#endif
+	static CppUnit::Test *
+	suite(){
+		CppUnit::TestSuite *suite = new CppUnit::TestSuite( "async Tests" );
+
+		suite->addTest( new CppUnit::TestCaller<fixture>( "wait",
+								  &fixture::wait ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "callback",
+								  &fixture::callback ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "errors",
+								  &fixture::errors ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "reconnect",
+								  &fixture::reconnect ) );
+#if __cplusplus >= 202002L && defined( __cpp_impl_coroutine )
+		suite->addTest( new CppUnit::TestCaller<fixture>( "coroutine",
+								  &fixture::coroutine ) );
+#endif
+		return suite;
+	}
+}
+
+#endif // _TESTS_ASYNC_H_
@@ -0,0 +1,145 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#include "tests/binary.h"
+#include "tmplsql/binary.h"
+
+#include <limits>
+
+using namespace binary_test;
+using namespace tmplsql::detail;
+
+// values as the server sends them in binary results, in network byte order
+
+void
+fixture::integers() {
+	const char int2[] = { '\xff', '\xfe' };
+	CPPUNIT_ASSERT( -2 == binary_value<int>::decode( int2, sizeof( int2 ), int2_oid ) );
+
+	const char int4[] = { '\x00', '\x01', '\xe2', '\x40' };
+	CPPUNIT_ASSERT( 123456 == binary_value<int>::decode( int4, sizeof( int4 ), int4_oid ) );
+	CPPUNIT_ASSERT( 123456 == binary_value<long long>::decode( int4, sizeof( int4 ), int4_oid ) );
+
+	const char int8[] = { '\x00', '\x00', '\x00', '\x02', '\x54', '\x0b', '\xe3', '\xff' };
+	CPPUNIT_ASSERT( 9999999999LL == binary_value<long long>::decode( int8, sizeof( int8 ), int8_oid ) );
+
+	const char negative[] = { '\xff', '\xff', '\xff', '\xff', '\xff', '\xff', '\xff', '\xfd' };
+	CPPUNIT_ASSERT( -3 == binary_value<long>::decode( negative, sizeof( negative ), int8_oid ) );
+
+	// text columns are still parsed
+	CPPUNIT_ASSERT( 42 == binary_value<int>::decode( "42", 2, text_oid ) );
+}
+
+void
+fixture::floats() {
+	// 332.54 as a float8
+	const char float8[] = { '\x40', '\x74', '\xc8', '\xa3', '\xd7', '\x0a', '\x3d', '\x71' };
+	CPPUNIT_ASSERT( 332.54 == binary_value<double>::decode( float8, sizeof( float8 ), float8_oid ) );
+
+	// 1.5 as a float4
+	const char float4[] = { '\x3f', '\xc0', '\x00', '\x00' };
+	CPPUNIT_ASSERT( 1.5 == binary_value<double>::decode( float4, sizeof( float4 ), float4_oid ) );
+	CPPUNIT_ASSERT( 1.5f == binary_value<float>::decode( float4, sizeof( float4 ), float4_oid ) );
+
+	const char int4[] = { '\x00', '\x00', '\x00', '\x07' };
+	CPPUNIT_ASSERT( 7.0 == binary_value<double>::decode( int4, sizeof( int4 ), int4_oid ) );
+
+	CPPUNIT_ASSERT( 3.25 == binary_value<double>::decode( "3.25", 4, text_oid ) );
+}
+
+void
+fixture::numerics() {
+	// -12345.678: digits 1 2345 6780, weight 1, negative, scale 3
+	const char numeric[] = { '\x00', '\x03', '\x00', '\x01', '\x40', '\x00', '\x00', '\x03',
+				 '\x00', '\x01', '\x09', '\x29', '\x1a', '\x7c' };
+	double value = binary_value<double>::decode( numeric, sizeof( numeric ), numeric_oid );
+	CPPUNIT_ASSERT( value < -12345.677 && value > -12345.679 );
+	CPPUNIT_ASSERT( -12345 == binary_value<long>::decode( numeric, sizeof( numeric ), numeric_oid ) );
+
+	// 20000: the single digit 2, weight 1
+	const char large[] = { '\x00', '\x01', '\x00', '\x01', '\x00', '\x00', '\x00', '\x00', '\x00', '\x02' };
+	CPPUNIT_ASSERT( 20000 == binary_value<int>::decode( large, sizeof( large ), numeric_oid ) );
+	CPPUNIT_ASSERT( 20000.0 == binary_value<double>::decode( large, sizeof( large ), numeric_oid ) );
+
+	// NaN and the infinities decode as they would from text
+	const char nan[] = { '\x00', '\x00', '\x00', '\x00', '\xc0', '\x00', '\x00', '\x00' };
+	double value_nan = binary_value<double>::decode( nan, sizeof( nan ), numeric_oid );
+	CPPUNIT_ASSERT( value_nan != value_nan );
+	float float_nan = binary_value<float>::decode( nan, sizeof( nan ), numeric_oid );
+	CPPUNIT_ASSERT( float_nan != float_nan );
+	const char infinity[] = { '\x00', '\x00', '\x00', '\x00', '\xd0', '\x00', '\x00', '\x00' };
+	CPPUNIT_ASSERT( std::numeric_limits<double>::infinity() == binary_value<double>::decode( infinity, sizeof( infinity ), numeric_oid ) );
+	const char negative_infinity[] = { '\x00', '\x00', '\x00', '\x00', '\xf0', '\x00', '\x00', '\x00' };
+	CPPUNIT_ASSERT( -std::numeric_limits<double>::infinity()
+			== binary_value<double>::decode( negative_infinity, sizeof( negative_infinity ), numeric_oid ) );
+}
+
+void
+fixture::bools() {
+	CPPUNIT_ASSERT( binary_value<bool>::decode( "\x01", 1, bool_oid ) );
+	CPPUNIT_ASSERT( ! binary_value<bool>::decode( "\x00", 1, bool_oid ) );
+	CPPUNIT_ASSERT( 1 == binary_value<int>::decode( "\x01", 1, bool_oid ) );
+	CPPUNIT_ASSERT( binary_value<bool>::decode( "t", 1, text_oid ) );
+}
+
+void
+fixture::timestamps() {
+	// 2001-09-09 01:46:40.5 UTC, which is 1000000000.5 seconds after the unix epoch
+	// and ( 1000000000 - 946684800 ) * 1000000 + 500000 = 53315200500000 microseconds after the postgres one
+	const char timestamp[] = { '\x00', '\x00', '\x30', '\x7d', '\x69', '\x96', '\x41', '\x20' };
+	CPPUNIT_ASSERT( 1000000000L == binary_value<long>::decode( timestamp, sizeof( timestamp ), timestamptz_oid ) );
+	CPPUNIT_ASSERT( 1000000000.5 == binary_value<double>::decode( timestamp, sizeof( timestamp ), timestamp_oid ) );
+
+	// a second before the postgres epoch
+	const char before[] = { '\xff', '\xff', '\xff', '\xff', '\xff', '\xf0', '\xbd', '\xc0' };
+	CPPUNIT_ASSERT( 946684799L == binary_value<long>::decode( before, sizeof( before ), timestamp_oid ) );
+
+	// 2000-01-02
+	const char date[] = { '\x00', '\x00', '\x00', '\x01' };
+	CPPUNIT_ASSERT( 946771200L == binary_value<long>::decode( date, sizeof( date ), date_oid ) );
+}
+
+void
+fixture::strings() {
+	CPPUNIT_ASSERT( "foo" == binary_value<std::string>::decode( "foo", 3, varchar_oid ) );
+	const char int4[] = { '\xff', '\xff', '\xff', '\xf6' };
+	CPPUNIT_ASSERT( "-10" == binary_value<std::string>::decode( int4, sizeof( int4 ), int4_oid ) );
+	CPPUNIT_ASSERT( "t" == binary_value<std::string>::decode( "\x01", 1, bool_oid ) );
+
+	// floats are written with as few digits as read back the same
+	const char float8[] = { '\x40', '\x74', '\xc8', '\xa3', '\xd7', '\x0a', '\x3d', '\x71' };
+	CPPUNIT_ASSERT( "332.54" == binary_value<std::string>::decode( float8, sizeof( float8 ), float8_oid ) );
+
+	// numerics keep every digit, up to the scale
+	const char numeric[] = { '\x00', '\x03', '\x00', '\x01', '\x40', '\x00', '\x00', '\x03',
+				 '\x00', '\x01', '\x09', '\x29', '\x1a', '\x7c' };
+	CPPUNIT_ASSERT( "-12345.678" == binary_value<std::string>::decode( numeric, sizeof( numeric ), numeric_oid ) );
+	// 12345678901234567890.05: digits 1234 5678 9012 3456 7890 0500, weight 4, scale 2
+	const char wide[] = { '\x00', '\x06', '\x00', '\x04', '\x00', '\x00', '\x00', '\x02',
+			      '\x04', '\xd2', '\x16', '\x2e', '\x23', '\x34', '\x0d', '\x80', '\x1e', '\xd2', '\x01', '\xf4' };
+	CPPUNIT_ASSERT( "12345678901234567890.05" == binary_value<std::string>::decode( wide, sizeof( wide ), numeric_oid ) );
+	// 0.0001: the single digit 1, weight -1, scale 4
+	const char small[] = { '\x00', '\x01', '\xff', '\xff', '\x00', '\x00', '\x00', '\x04', '\x00', '\x01' };
+	CPPUNIT_ASSERT( "0.0001" == binary_value<std::string>::decode( small, sizeof( small ), numeric_oid ) );
+
+	// dates and times as the ISO date style has them
+	const char timestamp[] = { '\x00', '\x00', '\x30', '\x7d', '\x69', '\x96', '\x41', '\x20' };
+	CPPUNIT_ASSERT( "2001-09-09 01:46:40.5" == binary_value<std::string>::decode( timestamp, sizeof( timestamp ), timestamp_oid ) );
+	CPPUNIT_ASSERT( "2001-09-09 01:46:40.5+00" == binary_value<std::string>::decode( timestamp, sizeof( timestamp ), timestamptz_oid ) );
+	const char before[] = { '\xff', '\xff', '\xff', '\xff', '\xff', '\xf0', '\xbd', '\xc0' };
+	CPPUNIT_ASSERT( "1999-12-31 23:59:59" == binary_value<std::string>::decode( before, sizeof( before ), timestamp_oid ) );
+	const char date[] = { '\x00', '\x00', '\x00', '\x01' };
+	CPPUNIT_ASSERT( "2000-01-02" == binary_value<std::string>::decode( date, sizeof( date ), date_oid ) );
+	// 0001-12-31 BC is 730120 days before 2000-01-01
+	const char bc[] = { '\xff', '\xf4', '\xdb', '\xf8' };
+	CPPUNIT_ASSERT( "0001-12-31 BC" == binary_value<std::string>::decode( bc, sizeof( bc ), date_oid ) );
+
+	// 1 year 2 mons -3 days +04:05:06.5
+	const char interval[] = { '\x00', '\x00', '\x00', '\x03', '\x6c', '\x93', '\x61', '\xa0',
+				  '\xff', '\xff', '\xff', '\xfd', '\x00', '\x00', '\x00', '\x0e' };
+	CPPUNIT_ASSERT( "1 year 2 mons -3 days +04:05:06.5" == binary_value<std::string>::decode( interval, sizeof( interval ), interval_oid ) );
+}
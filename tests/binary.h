@@ -0,0 +1,49 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+#ifndef _TESTS_BINARY_H_
+#define _TESTS_BINARY_H_
+
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/TestCaller.h>
+
+
+namespace binary_test {
+	struct fixture : public CppUnit::TestFixture  {
+		void integers();
+		void floats();
+		void numerics();
+		void bools();
+		void timestamps();
+		void strings();
+	};
+	#if (__GNUC__)
+	__attribute__ ((unused))
+	#endif
+	static CppUnit::Test *
+	suite(){
+		CppUnit::TestSuite *suite = new CppUnit::TestSuite( "binary Tests" );
+
+		suite->addTest( new CppUnit::TestCaller<fixture>( "integers",
+								  &fixture::integers ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "floats",
+								  &fixture::floats ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "numerics",
+								  &fixture::numerics ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "bools",
+								  &fixture::bools ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "timestamps",
+								  &fixture::timestamps ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "strings",
+								  &fixture::strings ) );
+		return suite;
+	}
+}
+
+#endif // _TESTS_BINARY_H_
@@ -0,0 +1,164 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#include "tests/copy.h"
+#include "tmplsql/copy_writer.h"
+#include "tmplsql/copy_reader.h"
+#include "tmplsql/recordset.h"
+#include "tmplsql/param.h"
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace copy_test;
+using namespace tmplsql::detail;
+
+void
+fixture::text_format() {
+	std::string out;
+	encode_columns( out, boost::make_tuple( -1234, std::string( "tab\there\\" ), true, 0.5 ), false, true );
+	CPPUNIT_ASSERT( "-1234\ttab\\there\\\\\tt\t0.5" == out );
+
+	out.clear();
+	encode_text( out, static_cast<const char*>( 0 ) );
+	encode_text( out, "line\nbreak" );
+	CPPUNIT_ASSERT( "\\Nline\\nbreak" == out );
+
+	out.clear();
+	encode_text( out, static_cast<long long>( -9223372036854775807LL - 1 ) );
+	CPPUNIT_ASSERT( "-9223372036854775808" == out );
+}
+
+void
+fixture::binary_format() {
+	std::string out;
+	encode( out, static_cast<short>( -2 ) );
+	CPPUNIT_ASSERT( std::string( "\0\0\0\2\xff\xfe", 6 ) == out );
+
+	out.clear();
+	encode( out, 123456 );
+	CPPUNIT_ASSERT( 8 == out.size() );
+	CPPUNIT_ASSERT( 123456 == binary_value<int>::decode( out.data() + 4, 4, int4_oid ) );
+
+	out.clear();
+	encode( out, 332.54 );
+	CPPUNIT_ASSERT( 12 == out.size() );
+	CPPUNIT_ASSERT( 332.54 == binary_value<double>::decode( out.data() + 4, 8, float8_oid ) );
+
+	out.clear();
+	encode( out, std::string( "abc" ) );
+	encode( out, static_cast<const char*>( 0 ) );
+	CPPUNIT_ASSERT( std::string( "\0\0\0\3abc\xff\xff\xff\xff", 11 ) == out );
+}
+
+void
+fixture::load() {
+	tmplsql::handle sql;
+	*sql << "create temporary table tmplsql_copy ( id int, name text, ratio float8 )";
+	CPPUNIT_ASSERT( sql->exec() );
+
+	{
+		tmplsql::copy_writer<int,std::string,double> w( sql, "tmplsql_copy ( id, name, ratio )" );
+		for ( int i = 0; i < 10000; ++i ) {
+			CPPUNIT_ASSERT( w.write( boost::make_tuple( i, std::string( "row\t" ), i / 4.0 ) ) );
+		}
+		CPPUNIT_ASSERT( w.finish() );
+		CPPUNIT_ASSERT( 10000 == w.rows() );
+	}
+	{
+		tmplsql::copy_writer<int,std::string,double> w( sql, "tmplsql_copy", tmplsql::rdms::binary_results, 1024 );
+		for ( int i = 0; i < 10000; ++i ) {
+			CPPUNIT_ASSERT( w.write( boost::make_tuple( -i, std::string( "bin" ), 1.5 ) ) );
+		}
+		CPPUNIT_ASSERT( w.finish() );
+	}
+	{
+		// never finished, so nothing is loaded
+		tmplsql::copy_writer<int,std::string,double> w( sql, "tmplsql_copy" );
+		w.write( boost::make_tuple( 1, std::string( "lost" ), 0.0 ) );
+	}
+	*sql << "select count(*), sum( ratio ) from tmplsql_copy where name in ( 'row\t', 'bin' )";
+	tmplsql::recordset<int,double> rs( sql );
+	tmplsql::recordset<int,double>::iterator it = rs.begin();
+	CPPUNIT_ASSERT( it != rs.end() );
+	CPPUNIT_ASSERT( 20000 == it.get<0>() );
+	CPPUNIT_ASSERT( 12498750 + 15000 == it.get<1>() );
+
+	*sql << "drop table tmplsql_copy";
+	sql->exec();
+}
+
+void
+fixture::decode_row() {
+	// a row as binary COPY sends it, with a null in the middle and a column missing from the end
+	std::string row;
+	encode_columns( row, boost::make_tuple( static_cast<short>( 7 ), -5000000000LL, std::string( "text" ) ), true, true );
+	encode( row, static_cast<const char*>( 0 ) );
+	encode( row, 0.25f );
+
+	boost::tuple<int,long long,std::string,std::string,double,int> decoded( 1, 1, "x", "x", 1, 1 );
+	const char *p = row.data();
+	decode_copy_columns( p, row.data() + row.size(), decoded );
+	CPPUNIT_ASSERT( p == row.data() + row.size() );
+	CPPUNIT_ASSERT( 7 == decoded.get<0>() );
+	CPPUNIT_ASSERT( -5000000000LL == decoded.get<1>() );
+	CPPUNIT_ASSERT( "text" == decoded.get<2>() );
+	CPPUNIT_ASSERT( decoded.get<3>().empty() );
+	CPPUNIT_ASSERT( 0.25 == decoded.get<4>() );
+	CPPUNIT_ASSERT( 0 == decoded.get<5>() );
+}
+
+void
+fixture::export_rows() {
+	tmplsql::handle sql;
+	*sql << "select i, 'row ' || i, i / 2.0::float8 from generate_series( 1, 1000 ) as i";
+	{
+		tmplsql::copy_reader<int,std::string,double> r( sql );
+		tmplsql::copy_reader<int,std::string,double>::row_type row;
+		int rows = 0;
+		while ( r.next( row ) ) {
+			++rows;
+			CPPUNIT_ASSERT( rows == row.get<0>() );
+			CPPUNIT_ASSERT( rows / 2.0 == row.get<2>() );
+		}
+		CPPUNIT_ASSERT( r.ok() );
+		CPPUNIT_ASSERT( 1000 == rows );
+		CPPUNIT_ASSERT( 1000 == r.rows() );
+		CPPUNIT_ASSERT( "row 1000" == row.get<1>() );
+	}
+
+	FILE *file = tmpfile();
+	*sql << "select i from generate_series( 1, 3 ) as i";
+	{
+		tmplsql::rdms::copy_out out( *sql );
+		CPPUNIT_ASSERT( out.write_to( fileno( file ) ) );
+		CPPUNIT_ASSERT( 3 == out.rows() );
+	}
+	char text[ 16 ] = { 0 };
+	rewind( file );
+	CPPUNIT_ASSERT( 6 == fread( text, 1, sizeof( text ), file ) );
+	CPPUNIT_ASSERT( std::string( "1\n2\n3\n" ) == text );
+	fclose( file );
+
+	// COPY can't take parameters, so bound values are quoted in to the query instead.  Placeholders in quotes stay put
+	*sql << "select i, '$1' from generate_series( 1, " << tmplsql::param( 2 ) << " ) as i where "
+	     << tmplsql::param( "it's" ) << " = 'it''s'";
+	{
+		tmplsql::copy_reader<int,std::string> r( sql );
+		tmplsql::copy_reader<int,std::string>::row_type row;
+		int rows = 0;
+		while ( r.next( row ) ) {
+			++rows;
+			CPPUNIT_ASSERT( "$1" == row.get<1>() );
+		}
+		CPPUNIT_ASSERT( r.ok() );
+		CPPUNIT_ASSERT( 2 == rows );
+	}
+
+	// the handle is left as it should be
+	*sql << "select 42";
+	CPPUNIT_ASSERT( "42" == sql->single_value() );
+}
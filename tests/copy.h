@@ -0,0 +1,46 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+#ifndef _TESTS_COPY_H_
+#define _TESTS_COPY_H_
+
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/TestCaller.h>
+
+
+namespace copy_test {
+	struct fixture : public CppUnit::TestFixture  {
+		void text_format();
+		void binary_format();
+		void load();
+		void decode_row();
+		void export_rows();
+	};
+	#if (__GNUC__)
+	__attribute__ ((unused))
+	#endif
+	static CppUnit::Test *
+	suite(){
+		CppUnit::TestSuite *suite = new CppUnit::TestSuite( "copy Tests" );
+
+		suite->addTest( new CppUnit::TestCaller<fixture>( "text_format",
+								  &fixture::text_format ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "binary_format",
+								  &fixture::binary_format ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "load",
+								  &fixture::load ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "decode_row",
+								  &fixture::decode_row ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "export_rows",
+								  &fixture::export_rows ) );
+		return suite;
+	}
+}
+
+#endif // _TESTS_COPY_H_
@@ -0,0 +1,89 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#include "tests/escape.h"
+#include "tmplsql/escape.h"
+#include "tmplsql/quote.h"
+#include "postgresql/libpq-fe.h"
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+using namespace escape_test;
+
+// text of length characters, mostly letters, with plenty of quotes and backslashes and the odd nul
+static std::string
+random_text( size_t length, bool nuls ) {
+	static const char chars[] = "abcdefgh''\\\\ \xc3\xa9";
+	std::string ret_val;
+	for ( size_t i = 0; i < length; ++i ) {
+		if ( nuls && ! ( rand() % 97 ) ) {
+			ret_val += '\0';
+		} else {
+			ret_val += chars[ rand() % ( sizeof( chars ) - 1 ) ];
+		}
+	}
+	return ret_val;
+}
+
+void
+fixture::vector_matches_scalar() {
+	srand( 42 );
+	// every length either side of the vector widths, and starting at every alignment
+	for ( size_t length = 0; length < 200; ++length ) {
+		for ( size_t offset = 0; offset < 4; ++offset ) {
+			std::string text = random_text( length + offset, true );
+			for ( int backslashes = 0; backslashes < 2; ++backslashes ) {
+				std::vector<char> scalar( length * 2 + 1, 'x' ), vector( length * 2 + 1, 'y' );
+				size_t scalar_size = tmplsql::detail::escape_scalar( &scalar[0], text.data() + offset, length, backslashes );
+				size_t vector_size = tmplsql::detail::escape_vector( &vector[0], text.data() + offset, length, backslashes );
+				CPPUNIT_ASSERT_EQUAL( scalar_size, vector_size );
+				CPPUNIT_ASSERT( std::string( &scalar[0], scalar_size + 1 ) == std::string( &vector[0], vector_size + 1 ) );
+			}
+		}
+	}
+}
+
+void
+fixture::matches_libpq() {
+	srand( 7 );
+	for ( size_t length = 0; length < 300; length += 7 ) {
+		std::string text = random_text( length, true );
+		std::vector<char> ours( length * 2 + 1 ), libpq( length * 2 + 1 );
+		size_t our_size = tmplsql::escape_string( &ours[0], text.data(), length );
+		size_t libpq_size = PQescapeString( &libpq[0], text.data(), length );
+		CPPUNIT_ASSERT_EQUAL( libpq_size, our_size );
+		CPPUNIT_ASSERT( std::string( &libpq[0], libpq_size ) == std::string( &ours[0], our_size ) );
+	}
+}
+
+void
+fixture::quote() {
+	CPPUNIT_ASSERT( tmplsql::quote( "fu'ed" ) == "'fu''ed'" );
+	CPPUNIT_ASSERT( tmplsql::quote( std::string( "fu'ed" ), false ) == "fu''ed" );
+	CPPUNIT_ASSERT( tmplsql::quote( "" ) == "''" );
+	CPPUNIT_ASSERT( tmplsql::quote( "''" ) == "''''''" );
+	// as with PQescapeString, the text stops at a nul
+	CPPUNIT_ASSERT( tmplsql::quote( std::string( "ab\0cd", 5 ) ) == "'ab'" );
+	CPPUNIT_ASSERT_EQUAL( 42, tmplsql::quote( 42 ) );
+}
+
+void
+fixture::quoted() {
+	std::string long_text = random_text( 5000, false );
+	const char *texts[] = { "fu'ed", "", "a\\b", "'", long_text.c_str() };
+	for ( size_t i = 0; i < sizeof( texts ) / sizeof( texts[0] ); ++i ) {
+		std::ostringstream str;
+		str << tmplsql::quoted( texts[i] );
+		CPPUNIT_ASSERT( str.str() == tmplsql::quote( texts[i] ) );
+	}
+
+	std::ostringstream str;
+	str << tmplsql::quoted( std::string( "ab\0cd", 5 ) ) << tmplsql::quoted( 42 );
+	CPPUNIT_ASSERT( str.str() == "'ab'42" );
+}
@@ -0,0 +1,43 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+#ifndef _TESTS_ESCAPE_H_
+#define _TESTS_ESCAPE_H_
+
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/TestCaller.h>
+
+
+namespace escape_test {
+	struct fixture : public CppUnit::TestFixture  {
+		void vector_matches_scalar();
+		void matches_libpq();
+		void quote();
+		void quoted();
+	};
+	#if (__GNUC__)
+	__attribute__ ((unused))
+	#endif
+	static CppUnit::Test *
+	suite(){
+		CppUnit::TestSuite *suite = new CppUnit::TestSuite( "escape Tests" );
+
+		suite->addTest( new CppUnit::TestCaller<fixture>( "vector_matches_scalar",
+								  &fixture::vector_matches_scalar ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "matches_libpq",
+								  &fixture::matches_libpq ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "quote",
+								  &fixture::quote ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "quoted",
+								  &fixture::quoted ) );
+		return suite;
+	}
+}
+
+#endif // _TESTS_ESCAPE_H_
@@ -81,3 +81,26 @@ fixture::assign_comp() {
 
 }
 
+void
+fixture::copy_on_share() {
+	tmplsql::field<int> f( "field", "table" );
+	f.initialize( 1234 );
+	CPPUNIT_ASSERT( f.delete_ok() );
+
+	// copies share the one value
+	tmplsql::field<int> f2( f );
+	CPPUNIT_ASSERT( f2 == 1234 );
+	f2.initialize( 42 );
+	CPPUNIT_ASSERT( f == 42 );
+	CPPUNIT_ASSERT( ! f.delete_ok() );
+
+	tmplsql::field<int> f3( "field", "table" );
+	f3.initialize( 7 );
+	f3 = f;
+	f.initialize( 8 );
+	CPPUNIT_ASSERT( f3 == 8 );
+	{
+		tmplsql::field<int> f4( f3 );
+	}
+	CPPUNIT_ASSERT( f2 == 8 );
+}
@@ -22,6 +22,7 @@ namespace fields_test {
 		void primary_key();
 		void assign_comp();
 		void modified();
+		void copy_on_share();
 	};
 
 	#if (__GNUC__)
@@ -40,6 +41,8 @@ namespace fields_test {
  								  &fixture::modified ) );
  		suite->addTest( new CppUnit::TestCaller<fixture>( "assign_comp()",
  								  &fixture::assign_comp ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "copy_on_share()",
+								  &fixture::copy_on_share ) );
 	return suite;
 	}
 
@@ -0,0 +1,83 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#include "tests/lexical_cast.h"
+#include "tmplsql/lexical_cast.h"
+#include <string>
+#include <limits>
+
+using namespace lexical_cast_test;
+
+
+void
+fixture::integers() {
+	CPPUNIT_ASSERT_EQUAL( 42, tmplsql::lexical_cast<int>( "42" ) );
+	CPPUNIT_ASSERT_EQUAL( -42, tmplsql::lexical_cast<int>( "-42" ) );
+	CPPUNIT_ASSERT_EQUAL( 42, tmplsql::lexical_cast<int>( " +42\n" ) );
+	CPPUNIT_ASSERT_EQUAL( std::numeric_limits<long long>::min(), tmplsql::lexical_cast<long long>( "-9223372036854775808" ) );
+	CPPUNIT_ASSERT_EQUAL( std::numeric_limits<unsigned long long>::max(), tmplsql::lexical_cast<unsigned long long>( "18446744073709551615" ) );
+	CPPUNIT_ASSERT_EQUAL( static_cast<short>( -32768 ), tmplsql::lexical_cast<short>( "-32768" ) );
+
+	// PQgetvalue hands back char*
+	char text[] = "1234";
+	CPPUNIT_ASSERT_EQUAL( 1234L, tmplsql::lexical_cast<long>( text ) );
+
+	unsigned int value = 0;
+	CPPUNIT_ASSERT( tmplsql::lexical_cast( "4294967295", value ) );
+	CPPUNIT_ASSERT_EQUAL( 4294967295U, value );
+}
+
+void
+fixture::floats() {
+	CPPUNIT_ASSERT_EQUAL( 1.5, tmplsql::lexical_cast<double>( "1.5" ) );
+	CPPUNIT_ASSERT_EQUAL( -0.25f, tmplsql::lexical_cast<float>( " -0.25 " ) );
+	CPPUNIT_ASSERT_EQUAL( 1e300, tmplsql::lexical_cast<double>( "1e300" ) );
+	CPPUNIT_ASSERT_EQUAL( 0.1, tmplsql::lexical_cast<double>( "0.1" ) );
+
+	// as the server writes them
+	double value = 0;
+	CPPUNIT_ASSERT( tmplsql::lexical_cast( "Infinity", value ) );
+	CPPUNIT_ASSERT( value == std::numeric_limits<double>::infinity() );
+	CPPUNIT_ASSERT( tmplsql::lexical_cast( "-Infinity", value ) );
+	CPPUNIT_ASSERT( value == -std::numeric_limits<double>::infinity() );
+	CPPUNIT_ASSERT( tmplsql::lexical_cast( "NaN", value ) );
+	CPPUNIT_ASSERT( value != value );
+}
+
+void
+fixture::errors() {
+	int value = 7;
+	CPPUNIT_ASSERT( ! tmplsql::lexical_cast( "", value ) );
+	CPPUNIT_ASSERT( ! tmplsql::lexical_cast( "  ", value ) );
+	CPPUNIT_ASSERT( ! tmplsql::lexical_cast( "12x", value ) );
+	CPPUNIT_ASSERT( ! tmplsql::lexical_cast( "1 2", value ) );
+	CPPUNIT_ASSERT( ! tmplsql::lexical_cast( "+-1", value ) );
+	CPPUNIT_ASSERT( ! tmplsql::lexical_cast( "2147483648", value ) );
+	CPPUNIT_ASSERT( ! tmplsql::lexical_cast( static_cast<const char*>( 0 ), value ) );
+	// left alone when the text isn't a number
+	CPPUNIT_ASSERT_EQUAL( 7, value );
+
+	unsigned int unsigned_value = 0;
+	CPPUNIT_ASSERT( ! tmplsql::lexical_cast( "-1", unsigned_value ) );
+	float float_value = 0;
+	CPPUNIT_ASSERT( ! tmplsql::lexical_cast( "1e100", float_value ) );
+
+	// the one argument form gives 0
+	CPPUNIT_ASSERT_EQUAL( 0, tmplsql::lexical_cast<int>( "fu" ) );
+	CPPUNIT_ASSERT_EQUAL( 0.0, tmplsql::lexical_cast<double>( "1.5.5" ) );
+}
+
+void
+fixture::other_types() {
+	CPPUNIT_ASSERT( tmplsql::lexical_cast<std::string>( 42 ) == "42" );
+	CPPUNIT_ASSERT( tmplsql::lexical_cast<bool>( "t" ) );
+	CPPUNIT_ASSERT_EQUAL( 'x', tmplsql::lexical_cast<char>( "x" ) );
+
+	std::string text;
+	CPPUNIT_ASSERT( tmplsql::lexical_cast( "word", text ) );
+	CPPUNIT_ASSERT( text == "word" );
+}
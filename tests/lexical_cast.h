@@ -0,0 +1,43 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+#ifndef _TESTS_LEXICAL_CAST_H_
+#define _TESTS_LEXICAL_CAST_H_
+
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/TestCaller.h>
+
+
+namespace lexical_cast_test {
+	struct fixture : public CppUnit::TestFixture  {
+		void integers();
+		void floats();
+		void errors();
+		void other_types();
+	};
+	#if (__GNUC__)
+	__attribute__ ((unused))
+	#endif
+	static CppUnit::Test *
+	suite(){
+		CppUnit::TestSuite *suite = new CppUnit::TestSuite( "lexical_cast Tests" );
+
+		suite->addTest( new CppUnit::TestCaller<fixture>( "integers",
+								  &fixture::integers ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "floats",
+								  &fixture::floats ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "errors",
+								  &fixture::errors ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "other_types",
+								  &fixture::other_types ) );
+		return suite;
+	}
+}
+
+#endif // _TESTS_LEXICAL_CAST_H_
@@ -0,0 +1,104 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+// Benchmark for converting column text to numbers.
+//
+// Compares tmplsql::lexical_cast, which reads numbers with std::from_chars or by hand, against the
+// std::stringstream it used for them before, on the text of a result set of int, bigint and float8 columns.
+// No database is needed, the rows are made up in memory in the form the server sends them.
+//
+// usage: lexical_cast_bench [rows]
+
+#include "tmplsql/lexical_cast.h"
+
+#include <IceUtil/Time.h>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+// lexical_cast as it was
+template<typename Target>
+inline Target
+stream_cast( const char *arg ) {
+	std::stringstream interpreter;
+	Target result;
+	if( ! ( interpreter << arg) || !(interpreter >> result) || ! ( interpreter >> std::ws ).eof() ) {
+		return 0;
+	}
+	return result;
+}
+
+struct stream_decoder {
+	static int int_value( const char *text ) { return stream_cast<int>( text ); }
+	static long long bigint_value( const char *text ) { return stream_cast<long long>( text ); }
+	static double float_value( const char *text ) { return stream_cast<double>( text ); }
+};
+
+struct lexical_decoder {
+	static int int_value( const char *text ) { return tmplsql::lexical_cast<int>( text ); }
+	static long long bigint_value( const char *text ) { return tmplsql::lexical_cast<long long>( text ); }
+	static double float_value( const char *text ) { return tmplsql::lexical_cast<double>( text ); }
+};
+
+// the text of each column, one row after another
+struct rows {
+	std::vector<std::string> ints, bigints, floats;
+};
+
+template <class Decoder>
+double
+rows_per_second( const rows& r, double& checksum ){
+	IceUtil::Time start = IceUtil::Time::now();
+	for ( std::vector<std::string>::size_type i = 0; i < r.ints.size(); ++i ){
+		checksum += Decoder::int_value( r.ints[i].c_str() );
+		checksum += Decoder::bigint_value( r.bigints[i].c_str() );
+		checksum += Decoder::float_value( r.floats[i].c_str() );
+	}
+	IceUtil::Time elapsed = IceUtil::Time::now() - start;
+	double usecs = elapsed.toMicroSeconds() ? elapsed.toMicroSeconds() : 1;
+	return r.ints.size() / ( usecs / 1000000.0 );
+}
+
+int
+main( int argc, char **argv ){
+	unsigned long count = argc > 1 ? atol( argv[1] ) : 1000000;
+
+	rows r;
+	srand( 42 );
+	char text[ 64 ];
+	for ( unsigned long i = 0; i < count; ++i ){
+		snprintf( text, sizeof( text ), "%d", rand() - RAND_MAX / 2 );
+		r.ints.push_back( text );
+		snprintf( text, sizeof( text ), "%lld", static_cast<long long>( rand() ) * rand() );
+		r.bigints.push_back( text );
+		snprintf( text, sizeof( text ), "%.15g", rand() / 1000.0 );
+		r.floats.push_back( text );
+	}
+
+	double stream_sum = 0, lexical_sum = 0;
+	double streamed = rows_per_second<stream_decoder>( r, stream_sum );
+	double lexical = rows_per_second<lexical_decoder>( r, lexical_sum );
+
+	std::cout << "rows of int, bigint and float8 decoded per second, " << count << " rows\n\n"
+		  << std::setw(16) << "stringstream"
+		  << std::setw(16) << "lexical_cast"
+		  << std::setw(10) << "speedup" << "\n"
+		  << std::setw(16) << std::fixed << std::setprecision(0) << streamed
+		  << std::setw(16) << lexical
+		  << std::setw(9) << std::setprecision(2) << lexical / streamed << "x\n";
+
+	if ( stream_sum != lexical_sum ){
+		std::cout << "the two disagree on the values decoded" << std::endl;
+		return 1;
+	}
+	return 0;
+}
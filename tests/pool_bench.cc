@@ -0,0 +1,147 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+// Contention benchmark for the connection pool's free list.
+//
+// Compares the sharded lock-free free list used by rdms::handle()/release() against the
+// std::queue guarded by a single IceUtil::RecMutex that it replaced.  No database is needed,
+// the "connections" are dummy objects, so only the cost of checkout and return is measured.
+//
+// usage: pool_bench [max_threads] [iterations_per_thread] [spare_handles]
+
+#include "tmplsql/free_list.h"
+
+#include <IceUtil/Thread.h>
+#include <IceUtil/Time.h>
+#include <IceUtil/RecMutex.h>
+
+#include <iostream>
+#include <iomanip>
+#include <queue>
+#include <vector>
+#include <stdlib.h>
+
+struct fake_connection {
+	fake_connection() : uses(0) { }
+	unsigned long uses;
+};
+
+// the pool as it was, one queue and one lock
+struct queue_pool {
+	queue_pool( unsigned int spare ) : max_spare_(spare) { }
+	fake_connection* checkout(){
+		fake_connection *ret_val = 0;
+		mutex_.lock();
+		if ( queue_.empty() ) {
+			ret_val = new fake_connection;
+		} else {
+			ret_val = queue_.front();
+			queue_.pop();
+		}
+		mutex_.unlock();
+		return ret_val;
+	}
+	void release( fake_connection *c ){
+		mutex_.lock();
+		if ( queue_.size() && queue_.size() >= max_spare_ ) {
+			delete queue_.front();
+			queue_.pop();
+		}
+		queue_.push( c );
+		mutex_.unlock();
+	}
+	~queue_pool(){
+		while ( queue_.size() ){
+			delete queue_.front();
+			queue_.pop();
+		}
+	}
+	std::queue<fake_connection*> queue_;
+	IceUtil::RecMutex mutex_;
+	std::queue<fake_connection*>::size_type max_spare_;
+};
+
+// the pool as it is now
+struct sharded_pool {
+	sharded_pool( unsigned int spare ) : list_(spare) { }
+	fake_connection* checkout(){
+		fake_connection *ret_val = list_.pop();
+		return ret_val ? ret_val : new fake_connection;
+	}
+	void release( fake_connection *c ){
+		if ( ! list_.push( c ) ){
+			delete c;
+		}
+	}
+	~sharded_pool(){
+		while ( fake_connection *c = list_.pop() ){
+			delete c;
+		}
+	}
+	tmplsql::detail::sharded_free_list<fake_connection> list_;
+};
+
+template <class Pool>
+class worker : public IceUtil::Thread {
+public:
+	worker( Pool& pool, unsigned long iterations ) : pool_(pool), iterations_(iterations) { }
+	void run(){
+		for ( unsigned long i = 0; i < iterations_; ++i ){
+			fake_connection *c = pool_.checkout();
+			// a token amount of work while the connection is checked out
+			++c->uses;
+			pool_.release( c );
+		}
+	}
+private:
+	Pool& pool_;
+	unsigned long iterations_;
+};
+
+template <class Pool>
+double
+ops_per_second( unsigned int threads, unsigned long iterations, unsigned int spare ){
+	Pool pool( spare );
+	std::vector<IceUtil::ThreadPtr> workers;
+	for ( unsigned int i = 0; i < threads; ++i ){
+		workers.push_back( new worker<Pool>( pool, iterations ) );
+	}
+	IceUtil::Time start = IceUtil::Time::now();
+	for ( unsigned int i = 0; i < threads; ++i ){
+		workers[i]->start();
+	}
+	for ( unsigned int i = 0; i < threads; ++i ){
+		workers[i]->getThreadControl().join();
+	}
+	IceUtil::Time elapsed = IceUtil::Time::now() - start;
+	double usecs = elapsed.toMicroSeconds() ? elapsed.toMicroSeconds() : 1;
+	return ( threads * iterations ) / ( usecs / 1000000.0 );
+}
+
+int
+main( int argc, char **argv ){
+	unsigned int max_threads = argc > 1 ? atoi( argv[1] ) : 32;
+	unsigned long iterations = argc > 2 ? atol( argv[2] ) : 200000;
+	unsigned int spare = argc > 3 ? atoi( argv[3] ) : 32;
+
+	std::cout << "checkout/release pairs per second, " << iterations << " per thread, "
+		  << spare << " spare handles\n\n"
+		  << std::setw(8) << "threads"
+		  << std::setw(16) << "queue+mutex"
+		  << std::setw(16) << "sharded"
+		  << std::setw(10) << "speedup" << "\n";
+
+	for ( unsigned int threads = 1; threads <= max_threads; threads *= 2 ){
+		double queued  = ops_per_second<queue_pool>( threads, iterations, spare );
+		double sharded = ops_per_second<sharded_pool>( threads, iterations, spare );
+		std::cout << std::setw(8) << threads
+			  << std::setw(16) << std::fixed << std::setprecision(0) << queued
+			  << std::setw(16) << sharded
+			  << std::setw(9) << std::setprecision(2) << sharded / queued << "x\n";
+	}
+	return 0;
+}
@@ -9,8 +9,15 @@
 #include "rdms.h"
 #include <iostream>
 #include "tmplsql/quote.h"
+#include "tmplsql/param.h"
+#include "tmplsql/returning.h"
+#include "tmplsql/lexical_cast.h"
+#include "tmplsql/sql_writer.h"
+#include <IceUtil/Thread.h>
+#include <limits>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 
 using namespace rdms_test;
 
@@ -51,6 +58,15 @@ fixture::stream(){
 	CPPUNIT_ASSERT( sql->current_statement() == "testing one two three" );
 	sql->abandon_statement();
 	CPPUNIT_ASSERT( sql->current_statement().empty() );
+
+	// statements bigger than the buffer has room for, written a character and a block at a time
+	std::string big( 100000, 'x' );
+	*sql << big << 'y' << 42;
+	CPPUNIT_ASSERT( sql->current_statement() == big + "y42" );
+	sql->abandon_statement();
+	*sql << "select " << 1;
+	CPPUNIT_ASSERT( sql->current_statement() == "select 1" );
+	CPPUNIT_ASSERT( sql->single_value() == "1" );
 }
 
 void
@@ -103,6 +119,53 @@ fixture::insert() {
 	CPPUNIT_ASSERT( sql->exec() );	
 }
 
+void
+fixture::returning() {
+	tmplsql::handle sql = this->get_handle();
+	*sql << "drop table tmplsqlr_tester";
+	sql->exec();
+	*sql << "create table tmplsqlr_tester( id serial primary key, test1 text, test2 text default 'def' )";
+	CPPUNIT_ASSERT( sql->exec() );
+
+	*sql << "insert into tmplsqlr_tester (test1) values (" << tmplsql::param( "foo" ) << ")";
+	tmplsql::returning<int,std::string> one( sql, "id, test2" );
+	CPPUNIT_ASSERT( one.ok() );
+	tmplsql::returning<int,std::string>::row_type row;
+	CPPUNIT_ASSERT( one.first( row ) );
+	CPPUNIT_ASSERT( row.get<0>() > 0 );
+	CPPUNIT_ASSERT( "def" == row.get<1>() );
+
+	// every key from a single statement
+	*sql << "insert into tmplsqlr_tester (test1) select 'bar' from generate_series( 1, 5 )";
+	tmplsql::returning<int> many( sql, "id" );
+	CPPUNIT_ASSERT( many.ok() );
+	std::vector< boost::tuple<int> > ids = many.rows();
+	CPPUNIT_ASSERT( 5 == ids.size() );
+	CPPUNIT_ASSERT( ids[0].get<0>() > row.get<0>() );
+
+	// insert() reads the sequence back the same way
+	*sql << "insert into tmplsqlr_tester (test1) values ('baz')";
+	CPPUNIT_ASSERT( tmplsql::lexical_cast<int>( sql->insert( "tmplsqlr_tester_id_seq" ).c_str() ) == ids[4].get<0>() + 1 );
+	// even with a semicolon on the end
+	*sql << "insert into tmplsqlr_tester (test1) values ('baz'); ";
+	CPPUNIT_ASSERT( tmplsql::lexical_cast<int>( sql->insert( "tmplsqlr_tester_id_seq" ).c_str() ) == ids[4].get<0>() + 2 );
+	// or a RETURNING clause of its own
+	*sql << "insert into tmplsqlr_tester (test1) values ('baz') returning test1";
+	CPPUNIT_ASSERT( tmplsql::lexical_cast<int>( sql->insert( "tmplsqlr_tester_id_seq" ).c_str() ) == ids[4].get<0>() + 3 );
+	// and just the one value for a select's rows
+	*sql << "insert into tmplsqlr_tester (test1) select 'qux' from generate_series( 1, 3 )";
+	CPPUNIT_ASSERT( tmplsql::lexical_cast<int>( sql->insert( "tmplsqlr_tester_id_seq" ).c_str() ) == ids[4].get<0>() + 6 );
+
+	*sql << "insert into tmplsqlr_no_such_table (test1) values ('foo')";
+	tmplsql::returning<int> bad( sql, "id" );
+	CPPUNIT_ASSERT( ! bad.ok() );
+	tmplsql::returning<int>::row_type id;
+	CPPUNIT_ASSERT( ! bad.first( id ) );
+
+	*sql << "drop table tmplsqlr_tester";
+	CPPUNIT_ASSERT( sql->exec() );
+}
+
 
 void
 fixture::single_value(){
@@ -197,6 +260,33 @@ fixture::quote(){
 	CPPUNIT_ASSERT( sql->exec() );
 }
 
+void
+fixture::escape_settings(){
+	tmplsql::handle sql = this->get_handle();
+	const std::string nasty = "a\\'; drop table tmplsql_tester; --";
+
+	// the connection is made with standard strings on, then a SET turns them off part way through the session,
+	// after which the backslash has to be doubled or it would end the literal
+	const char *settings[] = { "on", "off", "on" };
+	for ( unsigned int i = 0; i < sizeof( settings ) / sizeof( settings[0] ); ++i ) {
+		*sql << "set standard_conforming_strings = " << settings[i];
+		CPPUNIT_ASSERT( sql->exec() );
+
+		*sql << "insert into tmplsql_tester (test1, test2, test3) values (" << tmplsql::quoted( nasty ) << ",now()," << 1 << ")";
+		CPPUNIT_ASSERT( sql->exec() );
+		*sql << "select test1 from tmplsql_tester where test3 = " << 1;
+		CPPUNIT_ASSERT( sql->single_value() == nasty );
+
+		*sql << "update tmplsql_tester set test1 = " << tmplsql::quote( nasty + nasty ) << " where test3 = " << 1;
+		CPPUNIT_ASSERT( sql->exec() );
+		*sql << "select test1 from tmplsql_tester where test3 = " << 1;
+		CPPUNIT_ASSERT( sql->single_value() == nasty + nasty );
+
+		*sql << "delete from tmplsql_tester";
+		CPPUNIT_ASSERT( sql->exec() );
+	}
+}
+
 void
 fixture::epoch_date(){
 	tmplsql::handle sql = this->get_handle();
@@ -285,3 +375,472 @@ fixture::result_sets(){
 }
 
 
+void
+fixture::statement_cache(){
+	tmplsql::rdms::pool_options options( 1 );
+	options.statement_cache_size = 2;
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "cached", tmplsql::rdms::connection_string( "test" ), options ) );
+
+	tmplsql::handle sql( "cached" );
+	CPPUNIT_ASSERT( sql.valid() );
+
+	// first time through it's just run, the second it's prepared, from then on it's run prepared
+	for ( int i = 0; i < 3; ++i ){
+		*sql << "select 1";
+		CPPUNIT_ASSERT( sql->single_value() == "1" );
+	}
+	CPPUNIT_ASSERT( 2 == sql->statement_cache_misses() );
+	CPPUNIT_ASSERT( 1 == sql->statement_cache_hits() );
+
+	// the cache stays with the connection when it goes back to the pool
+	sql.release();
+	sql = tmplsql::handle( "cached" );
+	*sql << "select 1";
+	CPPUNIT_ASSERT( sql->single_value() == "1" );
+	CPPUNIT_ASSERT( 2 == sql->statement_cache_hits() );
+
+	// statements only run the once never get in to the cache, so can't push it out
+	*sql << "select 2";
+	sql->single_value();
+	*sql << "select 3";
+	sql->single_value();
+	*sql << "select 1";
+	CPPUNIT_ASSERT( sql->single_value() == "1" );
+	CPPUNIT_ASSERT( 3 == sql->statement_cache_hits() );
+
+	// those run again do, and pushing it out of the cache means starting over
+	for ( int i = 0; i < 2; ++i ){
+		*sql << "select 2";
+		sql->single_value();
+		*sql << "select 3";
+		sql->single_value();
+	}
+	*sql << "select 1";
+	CPPUNIT_ASSERT( sql->single_value() == "1" );
+	CPPUNIT_ASSERT( 3 == sql->statement_cache_hits() );
+
+	// more than one statement is never prepared, but still runs
+	for ( int i = 0; i < 2; ++i ){
+		*sql << "select 1; select 4";
+		CPPUNIT_ASSERT( sql->single_value() == "4" );
+	}
+	CPPUNIT_ASSERT( 3 == sql->statement_cache_hits() );
+
+	// by default only the statements marked by cache_statement(), as query<> marks those it builds, are cached
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "query_cached", tmplsql::rdms::connection_string( "test" ),
+						   tmplsql::rdms::pool_options( 1 ) ) );
+	tmplsql::handle q( "query_cached" );
+	for ( int i = 0; i < 3; ++i ){
+		*q << "select 1";
+		CPPUNIT_ASSERT( q->single_value() == "1" );
+	}
+	CPPUNIT_ASSERT( 0 == q->statement_cache_hits() );
+
+	*q << "create table tmplsqlc_tester( id int, test1 text )";
+	CPPUNIT_ASSERT( q->exec() );
+	*q << "insert into tmplsqlc_tester values ( 1, 'foo' )";
+	CPPUNIT_ASSERT( q->exec() );
+	for ( int i = 0; i < 2; ++i ){
+		*q << "select * from tmplsqlc_tester where id = " << tmplsql::param( 1 );
+		q->cache_statement();
+		CPPUNIT_ASSERT( q->select().num_rows() == 1 );
+	}
+	CPPUNIT_ASSERT( 1 == q->statement_cache_hits() );
+
+	// altering the table changes the columns the prepared statement gives back, so it's prepared again
+	*q << "alter table tmplsqlc_tester add column test2 text";
+	CPPUNIT_ASSERT( q->exec() );
+	*q << "select * from tmplsqlc_tester where id = " << tmplsql::param( 1 );
+	q->cache_statement();
+	tmplsql::rdms::result_set rows = q->select();
+	CPPUNIT_ASSERT( rows.num_rows() == 1 );
+	CPPUNIT_ASSERT( rows.num_fields() == 3 );
+
+	*q << "drop table tmplsqlc_tester";
+	CPPUNIT_ASSERT( q->exec() );
+}
+
+
+void
+fixture::params(){
+	tmplsql::handle sql = this->get_handle();
+
+	*sql << "select " << tmplsql::param( "fu'ed" ) << "::text || " << tmplsql::param( 42 ) << "::text";
+	CPPUNIT_ASSERT( sql->current_statement() == "select $1::text || $2::text" );
+	CPPUNIT_ASSERT( sql->single_value() == "fu'ed42" );
+
+	// bound values go with the statement
+	*sql << "select " << tmplsql::param( 1 );
+	sql->abandon_statement();
+	*sql << "select 'no params'";
+	CPPUNIT_ASSERT( sql->single_value() == "no params" );
+
+	// anywhere else they're quoted in to the text
+	std::stringstream str;
+	str << "select " << tmplsql::param( "fu'ed" ) << ", " << tmplsql::param( 42 );
+	CPPUNIT_ASSERT( str.str() == "select 'fu''ed', 42" );
+}
+
+
+void
+fixture::pipeline(){
+	tmplsql::handle sql = this->get_handle();
+	*sql << "create temporary table tmplsql_pipeline( id int primary key )";
+	CPPUNIT_ASSERT( sql->exec() );
+
+	tmplsql::rdms::pipeline batch( *sql );
+	for ( int i = 0; i < 100; ++i ){
+		*sql << "insert into tmplsql_pipeline (id) values (" << tmplsql::param( i ) << ")";
+		batch.add();
+	}
+	*sql << "select count(*) from tmplsql_pipeline";
+	batch.add();
+	CPPUNIT_ASSERT( 101 == batch.size() );
+	CPPUNIT_ASSERT( sql->current_statement().empty() );
+	CPPUNIT_ASSERT( batch.run() );
+	CPPUNIT_ASSERT( batch.ok( 0 ) );
+	CPPUNIT_ASSERT( ! strcmp( batch.rows( 100 ).begin()[0], "100" ) );
+
+	// a failure takes the whole batch with it
+	*sql << "insert into tmplsql_pipeline (id) values (" << tmplsql::param( 1000 ) << ")";
+	batch.add();
+	*sql << "insert into tmplsql_pipeline (id) values (" << tmplsql::param( 1 ) << ")";
+	batch.add();
+	*sql << "insert into tmplsql_pipeline (id) values (" << tmplsql::param( 1001 ) << ")";
+	batch.add();
+	CPPUNIT_ASSERT( ! batch.run() );
+	CPPUNIT_ASSERT( batch.ok( 0 ) );
+	CPPUNIT_ASSERT( ! batch.ok( 1 ) );
+	CPPUNIT_ASSERT( ! batch.error_msg( 1 ).empty() );
+	CPPUNIT_ASSERT( ! batch.ok( 2 ) );
+	CPPUNIT_ASSERT( ! sql->error_msg().empty() );
+
+	*sql << "select count(*) from tmplsql_pipeline";
+	CPPUNIT_ASSERT( sql->single_value() == "100" );
+}
+
+void
+fixture::batch(){
+	tmplsql::handle sql = this->get_handle();
+	*sql << "create temporary table tmplsql_batch( id int primary key )";
+	CPPUNIT_ASSERT( sql->exec() );
+
+	{
+		tmplsql::rdms::batch trans( *sql );
+		for ( int i = 0; i < 3; ++i ){
+			*sql << "insert into tmplsql_batch (id) values (" << tmplsql::param( i ) << ")";
+			CPPUNIT_ASSERT( sql->exec() );
+		}
+		// nothing has been sent yet
+		CPPUNIT_ASSERT( ! sql->in_trans() );
+		CPPUNIT_ASSERT( 3 == trans.size() );
+
+		// a read sends what's queued first, and sees it
+		*sql << "select count(*) from tmplsql_batch";
+		CPPUNIT_ASSERT( sql->single_value() == "3" );
+		CPPUNIT_ASSERT( sql->in_trans() );
+		CPPUNIT_ASSERT( trans.ok( 2 ) );
+
+		*sql << "insert into tmplsql_batch (id) values (" << tmplsql::param( 3 ) << ")";
+		CPPUNIT_ASSERT( sql->exec() );
+		CPPUNIT_ASSERT( trans.commit() );
+		CPPUNIT_ASSERT( 4 == trans.size() );
+		CPPUNIT_ASSERT( trans.ok( 3 ) );
+		CPPUNIT_ASSERT( ! sql->in_trans() );
+	}
+
+	// a failure is reported against its statement, and rolls back the lot
+	{
+		tmplsql::rdms::batch trans( *sql );
+		*sql << "insert into tmplsql_batch (id) values (" << tmplsql::param( 10 ) << ")";
+		sql->exec();
+		*sql << "insert into tmplsql_batch (id) values (" << tmplsql::param( 1 ) << ")";
+		sql->exec();
+		*sql << "insert into tmplsql_batch (id) values (" << tmplsql::param( 11 ) << ")";
+		sql->exec();
+		CPPUNIT_ASSERT( ! trans.commit() );
+		CPPUNIT_ASSERT( trans.ok( 0 ) );
+		CPPUNIT_ASSERT( ! trans.ok( 1 ) );
+		CPPUNIT_ASSERT( ! trans.error_msg( 1 ).empty() );
+		CPPUNIT_ASSERT( ! trans.ok( 2 ) );
+		CPPUNIT_ASSERT( ! sql->in_trans() );
+	}
+
+	// as does going out of scope uncommitted
+	{
+		tmplsql::rdms::batch trans( *sql );
+		*sql << "insert into tmplsql_batch (id) values (" << tmplsql::param( 20 ) << ")";
+		sql->exec();
+	}
+
+	*sql << "select count(*) from tmplsql_batch";
+	CPPUNIT_ASSERT( sql->single_value() == "4" );
+}
+
+void
+fixture::sql_values(){
+	tmplsql::handle sql = this->get_handle();
+
+	*sql << "select " << 42 << ',' << -7L << ',' << 0.1 << ',' << true << ',' << std::numeric_limits<double>::quiet_NaN()
+	     << ',' << tmplsql::timestamp( 1000000000, 1500 );
+	CPPUNIT_ASSERT_EQUAL( std::string( "select 42,-7,0.1,true,'NaN','2001-09-09 01:46:40.001500+00'" ), sql->current_statement() );
+	sql->abandon_statement();
+
+	// the value has to make the round trip intact
+	*sql << "select " << 1.0 / 3.0 << "::float8 = " << tmplsql::param( 1.0 / 3.0 ) << "::float8";
+	CPPUNIT_ASSERT_EQUAL( std::string( "t" ), sql->single_value() );
+
+	*sql << "select " << tmplsql::timestamp( 1000000000 ) << "::timestamptz = 'epoch'::timestamptz + interval '1000000000 seconds'";
+	CPPUNIT_ASSERT_EQUAL( std::string( "t" ), sql->single_value() );
+	// microseconds outside of a second are carried in to the seconds, and years outside of 1 to 9999 AD are written
+	// as the server writes them
+	*sql << tmplsql::timestamp( 1000000000, -500000 ) << ',' << tmplsql::timestamp( 1000000000, 2500000 ) << ','
+	     << tmplsql::timestamp( 253402300800LL ) << ',' << tmplsql::timestamp( -62167219200LL );
+	CPPUNIT_ASSERT_EQUAL( std::string( "'2001-09-09 01:46:39.500000+00','2001-09-09 01:46:42.500000+00',"
+					   "'10000-01-01 00:00:00+00','0001-01-01 00:00:00+00 BC'" ), sql->current_statement() );
+	sql->abandon_statement();
+	*sql << "select " << tmplsql::timestamp( -62167219200LL ) << "::timestamptz = 'epoch'::timestamptz + interval '-62167219200 seconds'";
+	CPPUNIT_ASSERT_EQUAL( std::string( "t" ), sql->single_value() );
+}
+
+// the server process behind sql's own connection.  Reads in a transaction are never routed
+static std::string
+backend_pid( tmplsql::handle& sql ){
+	CPPUNIT_ASSERT( sql->begin_trans() );
+	*sql << "select pg_backend_pid()";
+	std::string ret_val = sql->single_value();
+	CPPUNIT_ASSERT( sql->abort_trans() );
+	return ret_val;
+}
+
+void
+fixture::read_routing(){
+	// all three pools talk to the test database, so which one a read ran on is told by the backend that ran it
+	tmplsql::rdms::connection_string test( "test" );
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "routed", test, tmplsql::rdms::pool_options( 1 ) ) );
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "routed_a", test, tmplsql::rdms::pool_options( 1 ) ) );
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "routed_b", test, tmplsql::rdms::pool_options( 1 ) ) );
+	CPPUNIT_ASSERT( ! tmplsql::handle( "no_such_pool" ).valid() );
+
+	std::vector<std::string> replicas;
+	replicas.push_back( "routed_a" );
+	replicas.push_back( "routed_b" );
+	CPPUNIT_ASSERT( ! tmplsql::rdms::route_reads( "routed", std::vector<std::string>( 1, "no_such_pool" ) ) );
+	CPPUNIT_ASSERT( ! tmplsql::rdms::route_reads( "routed", std::vector<std::string>( 1, "routed" ) ) );
+	CPPUNIT_ASSERT( tmplsql::rdms::route_reads( "routed", replicas ) );
+
+	tmplsql::handle sql( "routed" );
+	CPPUNIT_ASSERT( sql.valid() );
+	const std::string own = backend_pid( sql );
+
+	// round robin sends each read to the next replica, whose connection goes back to its own pool afterwards
+	*sql << "select pg_backend_pid()";
+	const std::string first = sql->single_value();
+	*sql << "select pg_backend_pid()";
+	const std::string second = sql->single_value();
+	CPPUNIT_ASSERT( first != own );
+	CPPUNIT_ASSERT( second != own );
+	CPPUNIT_ASSERT( first != second );
+	CPPUNIT_ASSERT( 1 == tmplsql::rdms::statistics( "routed_a" ).idle_connections );
+	CPPUNIT_ASSERT( 1 == tmplsql::rdms::statistics( "routed_b" ).idle_connections );
+	*sql << "select pg_backend_pid()";
+	CPPUNIT_ASSERT( sql->single_value() == first );
+
+	// once something has been exec()'d through the handle it reads its own writes, until it goes back to the pool
+	*sql << "set application_name = 'tmplsql_routed'";
+	CPPUNIT_ASSERT( sql->exec() );
+	*sql << "select pg_backend_pid()";
+	CPPUNIT_ASSERT( sql->single_value() == own );
+	sql.release();
+	sql = tmplsql::handle( "routed" );
+	*sql << "select pg_backend_pid()";
+	CPPUNIT_ASSERT( sql->single_value() != own );
+
+	// least outstanding passes over the replica that has a connection checked out
+	CPPUNIT_ASSERT( tmplsql::rdms::route_reads( "routed", replicas, tmplsql::rdms::least_outstanding ) );
+	tmplsql::handle busy( "routed_a" );
+	*busy << "select pg_backend_pid()";
+	const std::string busy_pid = busy->single_value();
+	for ( int i = 0; i < 2; ++i ){
+		*sql << "select pg_backend_pid()";
+		const std::string pid = sql->single_value();
+		CPPUNIT_ASSERT( pid != own );
+		CPPUNIT_ASSERT( pid != busy_pid );
+	}
+	busy.release();
+
+	// a replica pool that is at max_connections isn't waited on, the read runs on the handle's own connection
+	tmplsql::rdms::pool_options single( 1 );
+	single.max_connections = 1;
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "routed_a", test, single ) );
+	CPPUNIT_ASSERT( tmplsql::rdms::route_reads( "routed", std::vector<std::string>( 1, "routed_a" ) ) );
+	busy = tmplsql::handle( "routed_a" );
+	CPPUNIT_ASSERT( busy.valid() );
+	*sql << "select pg_backend_pid()";
+	CPPUNIT_ASSERT( sql->single_value() == own );
+	CPPUNIT_ASSERT( 0 == tmplsql::rdms::statistics( "routed_a" ).waits );
+	*busy << "select pg_backend_pid()";
+	const std::string replica_pid = busy->single_value();
+	busy.release();
+	*sql << "select pg_backend_pid()";
+	CPPUNIT_ASSERT( sql->single_value() == replica_pid );
+
+	// an empty list turns routing off
+	CPPUNIT_ASSERT( tmplsql::rdms::route_reads( "routed", std::vector<std::string>() ) );
+	*sql << "select pg_backend_pid()";
+	CPPUNIT_ASSERT( sql->single_value() == own );
+}
+
+namespace {
+	// checks a connection out of the "limited" pool on a thread of its own, waiting as long as the pool says to
+	class checkout_thread : public IceUtil::Thread {
+	public:
+		checkout_thread() : got( false ) { }
+		void run(){
+			tmplsql::handle sql( "limited" );
+			got = sql.valid() && sql->ping();
+		}
+		bool got;
+	};
+}
+
+void
+fixture::pool_limits(){
+	tmplsql::rdms::pool_options options( 1 );
+	options.max_connections = 1;
+	options.checkout_timeout = 100;
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "limited", tmplsql::rdms::connection_string( "test" ), options ) );
+	// the statistics last from one configuration to the next, so only what changes is looked at
+	tmplsql::rdms::pool_statistics before = tmplsql::rdms::statistics( "limited" );
+
+	tmplsql::handle held( "limited" );
+	CPPUNIT_ASSERT( held.valid() );
+	CPPUNIT_ASSERT( 1 == tmplsql::rdms::statistics( "limited" ).open_connections );
+
+	// with the one connection held, the next checkout waits out checkout_timeout and is left invalid
+	tmplsql::handle refused( "limited" );
+	CPPUNIT_ASSERT( ! refused.valid() );
+	tmplsql::rdms::pool_statistics after = tmplsql::rdms::statistics( "limited" );
+	CPPUNIT_ASSERT( before.waits + 1 == after.waits );
+	CPPUNIT_ASSERT( before.timeouts + 1 == after.timeouts );
+	CPPUNIT_ASSERT( after.max_wait_ms >= 100 );
+	CPPUNIT_ASSERT( 0 == after.waiting );
+	CPPUNIT_ASSERT( 1 == after.open_connections );
+
+	// a thread waiting in line is handed the connection as soon as it's released
+	held.release();
+	options.checkout_timeout = 10000;
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "limited", tmplsql::rdms::connection_string( "test" ), options ) );
+	held = tmplsql::handle( "limited" );
+	CPPUNIT_ASSERT( held.valid() );
+
+	checkout_thread *waiter = new checkout_thread;
+	IceUtil::ThreadPtr thread = waiter;
+	thread->start();
+	for ( int i = 0; i < 1000 && ! tmplsql::rdms::statistics( "limited" ).waiting; ++i ){
+		usleep( 1000 );
+	}
+	CPPUNIT_ASSERT( 1 == tmplsql::rdms::statistics( "limited" ).waiting );
+	held.release();
+	thread->getThreadControl().join();
+	CPPUNIT_ASSERT( waiter->got );
+
+	tmplsql::rdms::pool_statistics served = tmplsql::rdms::statistics( "limited" );
+	CPPUNIT_ASSERT( after.waits + 1 == served.waits );
+	CPPUNIT_ASSERT( after.timeouts == served.timeouts );
+	CPPUNIT_ASSERT( 0 == served.waiting );
+	CPPUNIT_ASSERT( 1 == served.open_connections );
+	CPPUNIT_ASSERT( 1 == served.idle_connections );
+}
+
+void
+fixture::pool_maintenance(){
+	tmplsql::rdms::connection_string test( "test" );
+	tmplsql::rdms::pool_options options( 2, 2 );
+	// the thread won't get round to it while the test runs, so check_idle() is called by hand.  Having it there stops
+	// checkout() pinging the connections it hands out, which would cover up any check_idle() should have replaced
+	options.maintenance_interval = 3600 * 1000;
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "maintained", test, options ) );
+
+	// a connection the server drops while it's idle is replaced
+	std::string pids[2];
+	{
+		tmplsql::handle first( "maintained" ), second( "maintained" );
+		pids[0] = backend_pid( first );
+		pids[1] = backend_pid( second );
+	}
+	CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "maintained" ).idle_connections );
+	tmplsql::handle sql = this->get_handle();
+	*sql << "select pg_terminate_backend( " << tmplsql::param( pids[0] ) << "::int )";
+	CPPUNIT_ASSERT( sql->single_value() == "t" );
+	usleep( 200 * 1000 );
+	tmplsql::rdms::check_idle( "maintained" );
+	CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "maintained" ).open_connections );
+	CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "maintained" ).idle_connections );
+	{
+		tmplsql::handle first( "maintained" ), second( "maintained" );
+		std::string now[2] = { backend_pid( first ), backend_pid( second ) };
+		CPPUNIT_ASSERT( now[0] != pids[0] && now[1] != pids[0] );
+		CPPUNIT_ASSERT( now[0] == pids[1] || now[1] == pids[1] );
+	}
+
+	// connections past max_lifetime are recycled, keeping the pool the same size
+	options.max_lifetime = 1;
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "maintained", test, options ) );
+	{
+		tmplsql::handle first( "maintained" ), second( "maintained" );
+		pids[0] = backend_pid( first );
+		pids[1] = backend_pid( second );
+	}
+	sleep( 2 );
+	tmplsql::rdms::check_idle( "maintained" );
+	CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "maintained" ).idle_connections );
+	{
+		tmplsql::handle first( "maintained" ), second( "maintained" );
+		std::string now[2] = { backend_pid( first ), backend_pid( second ) };
+		for ( int i = 0; i < 2; ++i ){
+			CPPUNIT_ASSERT( now[i] != pids[0] && now[i] != pids[1] );
+		}
+	}
+
+	// those idle for longer than idle_timeout are closed, down to min_idle_connections
+	options.max_lifetime = 0;
+	options.min_idle_connections = 1;
+	options.idle_timeout = 1;
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "maintained", test, options ) );
+	{
+		tmplsql::handle first( "maintained" ), second( "maintained" );
+		CPPUNIT_ASSERT( first.valid() && second.valid() );
+	}
+	CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "maintained" ).idle_connections );
+	sleep( 2 );
+	tmplsql::rdms::check_idle( "maintained" );
+	CPPUNIT_ASSERT( 1 == tmplsql::rdms::statistics( "maintained" ).open_connections );
+	CPPUNIT_ASSERT( 1 == tmplsql::rdms::statistics( "maintained" ).idle_connections );
+	tmplsql::handle kept( "maintained" );
+	CPPUNIT_ASSERT( kept->ping() );
+}
+
+void
+fixture::pool_warm_up(){
+	// min_idle_connections are open and waiting as soon as the pool is initialized
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "warmed", tmplsql::rdms::connection_string( "test" ),
+						   tmplsql::rdms::pool_options( 2, 2 ) ) );
+	CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "warmed" ).open_connections );
+	CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "warmed" ).idle_connections );
+	{
+		// handles are drawn from those, not newly opened
+		tmplsql::handle first( "warmed" ), second( "warmed" );
+		CPPUNIT_ASSERT( first->ping() && second->ping() );
+		CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "warmed" ).open_connections );
+		CPPUNIT_ASSERT( 0 == tmplsql::rdms::statistics( "warmed" ).idle_connections );
+
+		// warm_up() tops the idle connections back up
+		CPPUNIT_ASSERT( tmplsql::rdms::warm_up( "warmed" ) );
+		CPPUNIT_ASSERT( 4 == tmplsql::rdms::statistics( "warmed" ).open_connections );
+		CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "warmed" ).idle_connections );
+	}
+	// leaving the checked out ones surplus to requirements
+	CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "warmed" ).open_connections );
+	CPPUNIT_ASSERT( 2 == tmplsql::rdms::statistics( "warmed" ).idle_connections );
+}
@@ -25,12 +25,23 @@ namespace rdms_test {
 		void errors();
 		void exec();
 		void insert();
+		void returning();
 		void single_value();
 		void streams();
 		void transactions();
 		void quote();
+		void escape_settings();
 		void epoch_date();
 		void result_sets();
+		void statement_cache();
+		void params();
+		void pipeline();
+		void batch();
+		void sql_values();
+		void read_routing();
+		void pool_limits();
+		void pool_maintenance();
+		void pool_warm_up();
 	};
 
 	#if (__GNUC__)
@@ -51,6 +62,8 @@ namespace rdms_test {
 							      &fixture::exec ) );
 		suite->addTest( new CppUnit::TestCaller<fixture>( "insert", 
 							      &fixture::insert ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "returning",
+							      &fixture::returning ) );
 		suite->addTest( new CppUnit::TestCaller<fixture>( "single_value", 
 							      &fixture::single_value ) );
 		suite->addTest( new CppUnit::TestCaller<fixture>( "streams",
@@ -59,10 +72,30 @@ namespace rdms_test {
 							      &fixture::transactions ) );
 		suite->addTest( new CppUnit::TestCaller<fixture>( "quote", 
 							      &fixture::quote ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "escape_settings",
+							      &fixture::escape_settings ) );
 		suite->addTest( new CppUnit::TestCaller<fixture>( "epoch_date", 
 							      &fixture::epoch_date ) );
 		suite->addTest( new CppUnit::TestCaller<fixture>( "result_sets", 
 							      &fixture::result_sets ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "statement_cache",
+							      &fixture::statement_cache ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "params",
+							      &fixture::params ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "pipeline",
+							      &fixture::pipeline ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "batch",
+							      &fixture::batch ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "sql_values",
+							      &fixture::sql_values ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "read_routing",
+							      &fixture::read_routing ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "pool_limits",
+							      &fixture::pool_limits ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "pool_maintenance",
+							      &fixture::pool_maintenance ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "pool_warm_up",
+							      &fixture::pool_warm_up ) );
 
 		return suite;
 	}
@@ -7,8 +7,12 @@
 
 #include "tests/recordset.h"
 #include "tmplsql/recordset.h"
+#include "tmplsql/stream_recordset.h"
+#include "tmplsql/cursor_recordset.h"
+#include "tmplsql/param.h"
 #include "tmplsql/rdms.h"
 #include <iostream>
+#include <sstream>
 using namespace recordset_test;
 
 
@@ -62,3 +66,147 @@ fixture::length(){
 }
 
 
+
+void
+fixture::stream(){
+	tmplsql::handle sql;
+	*sql << "select i, 'row ' || i from generate_series( 1, 5000 ) as i";
+	tmplsql::stream_recordset<int,std::string> rs( sql, tmplsql::rdms::text_results, 100 );
+
+	int rows = 0;
+	long sum = 0;
+	for ( tmplsql::stream_recordset<int,std::string>::iterator it = rs.begin(); it != rs.end(); ++it ) {
+		++rows;
+		sum += it.get<0>();
+		if ( 1 == rows ) {
+			CPPUNIT_ASSERT( it.get<1>() == "row 1" );
+		}
+	}
+	CPPUNIT_ASSERT( rs.ok() );
+	CPPUNIT_ASSERT( 5000 == rows );
+	CPPUNIT_ASSERT( 12502500 == sum );
+	// it only goes round once
+	CPPUNIT_ASSERT( rs.begin() == rs.end() );
+
+	{
+		// walking away part way through leaves the handle usable
+		*sql << "select i from generate_series( 1, 1000000 ) as i";
+		tmplsql::stream_recordset<int> partial( sql, tmplsql::rdms::binary_results );
+		tmplsql::stream_recordset<int>::iterator it = partial.begin();
+		CPPUNIT_ASSERT( it != partial.end() );
+		CPPUNIT_ASSERT( 1 == it.get<0>() );
+	}
+	*sql << "select 42";
+	CPPUNIT_ASSERT( "42" == sql->single_value() );
+}
+
+void
+fixture::cursor(){
+	tmplsql::handle sql;
+	*sql << "select i from generate_series( 1, 2500 ) as i where i > " << tmplsql::param( 0 );
+	{
+		tmplsql::cursor_recordset<int> rs( sql, 1000 );
+		int rows = 0;
+		for ( tmplsql::cursor_recordset<int>::iterator it = rs.begin(); it != rs.end(); ++it ) {
+			CPPUNIT_ASSERT( ++rows == it.get<0>() );
+		}
+		CPPUNIT_ASSERT( rs.ok() );
+		CPPUNIT_ASSERT( 2500 == rows );
+		CPPUNIT_ASSERT( sql->in_trans() );
+	}
+	// the transaction it began is over
+	CPPUNIT_ASSERT( ! sql->in_trans() );
+
+	// in the caller's own transaction, which is left open
+	CPPUNIT_ASSERT( sql->begin_trans() );
+	*sql << "select i from generate_series( 1, 10 ) as i";
+	{
+		tmplsql::cursor_recordset<int> rs( sql, 3, tmplsql::rdms::binary_results );
+		int sum = 0;
+		for ( tmplsql::cursor_recordset<int>::iterator it = rs.begin(); it != rs.end(); ++it ) {
+			sum += it.get<0>();
+		}
+		CPPUNIT_ASSERT( 55 == sum );
+	}
+	CPPUNIT_ASSERT( sql->in_trans() );
+	CPPUNIT_ASSERT( sql->commit_trans() );
+}
+
+void
+fixture::columns(){
+	tmplsql::handle sql;
+	// every third row has nulls, and there are enough rows to fill several words of the null bitmap
+	const char *stmt = "select i, case when i % 3 = 0 then null else i * 10000000000 end, i / 4.0,"
+		" case when i % 3 = 0 then null else 'row ' || i end from generate_series( 1, 1000 ) as i";
+	for ( int format = tmplsql::rdms::text_results; format <= tmplsql::rdms::binary_results; ++format ) {
+		*sql << stmt;
+		tmplsql::recordset<int,long long,double,std::string> rs( sql, static_cast<tmplsql::rdms::result_format>( format ) );
+		tmplsql::recordset<int,long long,double,std::string>::columns_type cols = rs.columns();
+
+		CPPUNIT_ASSERT( 1000 == cols.get<0>().size() );
+		CPPUNIT_ASSERT( ! cols.get<0>().has_nulls() );
+		CPPUNIT_ASSERT( cols.get<1>().has_nulls() );
+		long long sum = 0;
+		for ( size_t row = 0; row < cols.get<0>().size(); ++row ) {
+			int i = row + 1;
+			CPPUNIT_ASSERT( i == cols.get<0>().values[ row ] );
+			CPPUNIT_ASSERT( i / 4.0 == cols.get<2>().values[ row ] );
+			CPPUNIT_ASSERT( ( 0 == i % 3 ) == cols.get<1>().is_null( row ) );
+			CPPUNIT_ASSERT( ( 0 == i % 3 ) == cols.get<3>().is_null( row ) );
+			if ( i % 3 ) {
+				CPPUNIT_ASSERT( i * 10000000000LL == cols.get<1>().values[ row ] );
+			} else {
+				CPPUNIT_ASSERT( 0 == cols.get<1>().values[ row ] );
+				CPPUNIT_ASSERT( cols.get<3>().values[ row ].empty() );
+			}
+			sum += cols.get<0>().values[ row ];
+		}
+		CPPUNIT_ASSERT( 500500 == sum );
+		CPPUNIT_ASSERT( "row 1" == cols.get<3>().values[0] );
+	}
+}
+
+void
+fixture::text_refs(){
+	tmplsql::handle sql;
+	const char *stmt = "select i, case when i % 3 = 0 then null else 'row ' || i end from generate_series( 1, 100 ) as i";
+	for ( int format = tmplsql::rdms::text_results; format <= tmplsql::rdms::binary_results; ++format ) {
+		*sql << stmt;
+		tmplsql::recordset<int,tmplsql::text_ref> rs( sql, static_cast<tmplsql::rdms::result_format>( format ) );
+		int rows = 0;
+		for ( tmplsql::recordset<int,tmplsql::text_ref>::iterator it = rs.begin(); it != rs.end(); ++it ) {
+			int i = it.get<0>();
+			tmplsql::text_ref text = it.get<1>();
+			if ( i % 3 ) {
+				std::ostringstream expected;
+				expected << "row " << i;
+				CPPUNIT_ASSERT( expected.str() == text );
+				CPPUNIT_ASSERT( expected.str().size() == text.size() );
+				CPPUNIT_ASSERT( expected.str() == text.str() );
+			} else {
+				CPPUNIT_ASSERT( text.empty() );
+			}
+			++rows;
+		}
+		CPPUNIT_ASSERT( 100 == rows );
+
+		*sql << stmt;
+		tmplsql::recordset<int,tmplsql::text_ref> cols_rs( sql, static_cast<tmplsql::rdms::result_format>( format ) );
+		tmplsql::recordset<int,tmplsql::text_ref>::columns_type cols = cols_rs.columns();
+		CPPUNIT_ASSERT( 100 == cols.get<1>().size() );
+		CPPUNIT_ASSERT( "row 1" == cols.get<1>().values[0] );
+		CPPUNIT_ASSERT( cols.get<1>().is_null( 2 ) );
+		CPPUNIT_ASSERT( cols.get<1>().values[2].empty() );
+	}
+
+	// the results are kept track of whether or not text_ref::check_lifetime is set, so a text_ref may outlive
+	// them as long as its text isn't looked at
+	tmplsql::text_ref kept;
+	{
+		*sql << "select 'kept'";
+		tmplsql::rdms::result_set rows = sql->select();
+		kept = rows.begin().text( 0 );
+		CPPUNIT_ASSERT( kept == "kept" );
+	}
+	CPPUNIT_ASSERT( 4 == kept.size() );
+}
@@ -19,6 +19,10 @@ namespace recordset_test {
 		void select();
 		void get_values();
 		void length();
+		void stream();
+		void cursor();
+		void columns();
+		void text_refs();
 	};
 
 	#if (__GNUC__)
@@ -33,6 +37,14 @@ namespace recordset_test {
 								  &fixture::get_values ) );
 		suite->addTest( new CppUnit::TestCaller<fixture>( "length",
 								  &fixture::length ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "stream",
+								  &fixture::stream ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "cursor",
+								  &fixture::cursor ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "columns",
+								  &fixture::columns ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "text_refs",
+								  &fixture::text_refs ) );
 
 		return suite;
 	}
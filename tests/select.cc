@@ -42,6 +42,7 @@ struct j_field1 : public tmplsql::field<std::string> {
 typedef tmplsql::query<field1,field2,field3> myquery;
 typedef tmplsql::query<j_id> subquery;
 typedef tmplsql::query<field1,field2,field3,j_id,j_field1> myjoin;
+typedef tmplsql::query<field1,field3> readquery;
 void
 fixture::init(){
 	tmplsql::handle sql;
@@ -279,3 +280,64 @@ fixture::update(){
 	this->boom();
 
 }
+
+void
+fixture::parallel(){
+	this->init();
+	tmplsql::handle sql;
+	// enough rows to fill a good few pages
+	*sql << "insert into tmplsql_tester (field1, field2, field3) select 'bulk', i, i from generate_series( 3, 5000 ) as i";
+	CPPUNIT_ASSERT( sql->exec() );
+
+	myquery q;
+	q.set_parallel( 4 );
+	int rows = 0;
+	long sum = 0;
+	for ( myquery::iterator it = q.begin(); it != q.end(); ++it ) {
+		++rows;
+		sum += it.get<1>();
+	}
+	CPPUNIT_ASSERT( 5000 == rows );
+	CPPUNIT_ASSERT( 5000L * 5001 / 2 == sum );
+
+	// along with a filter
+	field2 f;
+	f.initialize( 4000 );
+	q.set_filter( f );
+	myquery::iterator it = q.begin();
+	CPPUNIT_ASSERT( q.end() != it );
+	CPPUNIT_ASSERT( it.get<1>() == 4000 );
+	++it;
+	CPPUNIT_ASSERT( q.end() == it );
+
+	// on a pool whose one connection is already held it reads on its own, rather than waiting for another
+	tmplsql::rdms::pool_options options;
+	options.max_connections = 1;
+	CPPUNIT_ASSERT( tmplsql::rdms::initialize( "single", tmplsql::rdms::connection_string( "test" ), options ) );
+	tmplsql::handle single( "single" );
+	*single << "select count(*) from tmplsql_tester where ";
+	single->page_range( "tmplsql_tester" );
+	tmplsql::rdms::result_set counted = single->select_parallel( 4 );
+	CPPUNIT_ASSERT( std::string( counted.begin()[0] ) == "5000" );
+	this->boom();
+}
+
+void
+fixture::read_only(){
+	this->init();
+	// no primary key, so the fields come back by value rather than from a row_saver
+	readquery q;
+	readquery::iterator it = q.begin();
+	CPPUNIT_ASSERT( q.end() != it );
+	field1 f1 = it.get<0>();
+	CPPUNIT_ASSERT( f1 == "test1" );
+	CPPUNIT_ASSERT( it.get<1>() == 2.0234 );
+	// there's nothing to write a change back to
+	CPPUNIT_ASSERT( ! f1.set( "changed" ) );
+	++it;
+	CPPUNIT_ASSERT( it.get<0>() == "test2" );
+	CPPUNIT_ASSERT( it.get<1>() == 332.54 );
+	++it;
+	CPPUNIT_ASSERT( q.end() == it );
+	this->boom();
+}
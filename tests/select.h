@@ -26,6 +26,8 @@ namespace select_test {
 		void join();
 		void reopen();
 		void update();
+		void parallel();
+		void read_only();
 		void boom();
 	};
 
@@ -49,6 +51,10 @@ namespace select_test {
  								  &fixture::reopen ) );
  		suite->addTest( new CppUnit::TestCaller<fixture>( "update",
  								  &fixture::update ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "parallel",
+								  &fixture::parallel ) );
+		suite->addTest( new CppUnit::TestCaller<fixture>( "read_only",
+								  &fixture::read_only ) );
 		return suite;
 	}
 
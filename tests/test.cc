@@ -17,6 +17,11 @@
 #include "tests/recordset.h"
 #include "tests/fields.h"
 #include "tests/select.h"
+#include "tests/binary.h"
+#include "tests/copy.h"
+#include "tests/async.h"
+#include "tests/escape.h"
+#include "tests/lexical_cast.h"
 #include <queue>
 
 static std::queue<tmplsql::rdms*> sq;
@@ -47,6 +52,11 @@ main (int argc, char **argv)
   	runner.addTest( recordset_test::suite() );
   	runner.addTest( fields_test::suite() );
  	runner.addTest( select_test::suite() );
+ 	runner.addTest( binary_test::suite() );
+ 	runner.addTest( copy_test::suite() );
+ 	runner.addTest( async_test::suite() );
+ 	runner.addTest( escape_test::suite() );
+ 	runner.addTest( lexical_cast_test::suite() );
 
 	runner.run();
 	std::cout << "--------------------------------------------------------------------------------\n";
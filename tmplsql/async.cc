@@ -0,0 +1,531 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#include "tmplsql/async.h"
+#include "tmplsql/escape.h"
+
+#include "config.h"
+
+#include <IceUtil/Thread.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+using namespace tmplsql;
+
+namespace tmplsql {
+	namespace detail {
+
+		// a connection belonging to an async_engine, and the query it has in flight
+		struct async_connection {
+			async_connection( rdms *h ) :
+				sql( h ),
+				fd( -1 ),
+				busy( false ),
+				writing( false ),
+				resetting( false ),
+				reconnected( false ),
+				last( 0 )
+			{ }
+			rdms *sql;
+			// the socket as it is being watched, -1 if it isn't
+			int fd;
+			bool busy;
+			// is there still some of the query to be sent, or has the reconnect asked to write
+			bool writing;
+			// is the connection being reconnected, after the server dropped it while it was idle
+			bool resetting;
+			// has the connection been reconnected for the query already
+			bool reconnected;
+			async_engine::query current;
+			// the result the query has to show for itself so far
+			PGresult *last;
+		};
+
+		// the thread the engine's loop runs on
+		class async_thread : public IceUtil::Thread {
+		public:
+			async_thread( async_engine *engine ) :
+				engine_( engine )
+			{ }
+
+			void run() {
+				engine_->run();
+			}
+		private:
+			async_engine *engine_;
+		};
+
+	} // namespace detail
+} // namespace tmplsql
+
+
+///////////////////////////// async_result /////////////////////////////////////////
+
+async_result::async_result( const std::string& stmt ) :
+	statement_( stmt ),
+	done_( false ),
+	ok_( false )
+{
+
+}
+
+void
+async_result::complete( PGresult *res, const std::string& error ) {
+	if ( ! res ) {
+		res = PQmakeEmptyPGresult( 0, PGRES_FATAL_ERROR );
+	}
+	ExecStatusType status = PQresultStatus( res );
+	monitor_.lock();
+	ok_ = error.empty() && ( PGRES_TUPLES_OK == status || PGRES_COMMAND_OK == status );
+	if ( ! ok_ ) {
+		error_ = error.empty() ? PQresultErrorMessage( res ) : error;
+	}
+	rows_ = rdms::result_set( res );
+	done_ = true;
+	monitor_.notifyAll();
+	monitor_.unlock();
+}
+
+rdms::result_set
+async_result::wait() {
+	monitor_.lock();
+	while ( ! done_ ) {
+		monitor_.wait();
+	}
+	rdms::result_set ret_val( rows_ );
+	monitor_.unlock();
+	return ret_val;
+}
+
+bool
+async_result::ready() {
+	monitor_.lock();
+	bool ret_val = done_;
+	monitor_.unlock();
+	return ret_val;
+}
+
+bool
+async_result::ok() {
+	monitor_.lock();
+	bool ret_val = ok_;
+	monitor_.unlock();
+	return ret_val;
+}
+
+std::string
+async_result::error_msg() {
+	monitor_.lock();
+	std::string ret_val( error_ );
+	monitor_.unlock();
+	return ret_val;
+}
+
+const std::string&
+async_result::statement() const {
+	return statement_;
+}
+
+async_callback::~async_callback() {
+
+}
+
+
+///////////////////////////// async_engine /////////////////////////////////////////
+
+async_engine::async_engine( const std::string& pool_name, int connections ) :
+	stopping_( false ),
+	events_fd_( -1 ),
+	wake_read_fd_( -1 ),
+	wake_write_fd_( -1 )
+{
+	for ( int i = 0; i < connections; ++i ) {
+		rdms *sql = rdms::handle( pool_name );
+		if ( ! sql ) {
+			break;
+		}
+		PQsetnonblocking( sql->conn, 1 );
+		connections_.push_back( new detail::async_connection( sql ) );
+	}
+
+#ifdef HAVE_SYS_EVENTFD_H
+	wake_read_fd_ = wake_write_fd_ = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+#else
+	int fds[2];
+	if ( 0 == pipe( fds ) ) {
+		wake_read_fd_ = fds[0];
+		wake_write_fd_ = fds[1];
+		fcntl( wake_read_fd_, F_SETFL, O_NONBLOCK );
+		fcntl( wake_write_fd_, F_SETFL, O_NONBLOCK );
+	}
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+	events_fd_ = epoll_create1( EPOLL_CLOEXEC );
+	epoll_event event;
+	event.events = EPOLLIN;
+	// connections are told apart by their pointer, the wake up by having none
+	event.data.ptr = 0;
+	epoll_ctl( events_fd_, EPOLL_CTL_ADD, wake_read_fd_, &event );
+	for ( unsigned int i = 0; i < connections_.size(); ++i ) {
+		this->watch( *connections_[i], false );
+	}
+#endif
+
+	thread_ = new detail::async_thread( this );
+	thread_->start();
+}
+
+async_engine::~async_engine() {
+	this->stop();
+	if ( events_fd_ >= 0 ) {
+		close( events_fd_ );
+	}
+	if ( wake_read_fd_ >= 0 ) {
+		close( wake_read_fd_ );
+	}
+	if ( wake_write_fd_ >= 0 && wake_write_fd_ != wake_read_fd_ ) {
+		close( wake_write_fd_ );
+	}
+}
+
+async_result_ptr
+async_engine::submit( const std::string& stmt, const std::vector<std::string>& params,
+		      rdms::result_format format, const async_callback_ptr& callback ) {
+	query q;
+	q.result = new async_result( stmt );
+	q.callback = callback;
+	q.params = params;
+	q.format = format;
+
+	mutex_.lock();
+	const char *refused = stopping_ ? "async_engine stopped" : connections_.empty() ? "async_engine has no connections" : 0;
+	if ( ! refused ) {
+		queue_.push_back( q );
+	}
+	mutex_.unlock();
+
+	if ( refused ) {
+		q.result->complete( 0, refused );
+		if ( callback ) {
+			callback->completed( q.result );
+		}
+	} else {
+		this->wake();
+	}
+	return q.result;
+}
+
+async_result_ptr
+async_engine::submit( rdms& sql, rdms::result_format format, const async_callback_ptr& callback ) {
+	async_result_ptr ret_val = this->submit( sql.buffer_.curval(), sql.params_, format, callback );
+	sql.abandon_statement();
+	return ret_val;
+}
+
+int
+async_engine::connections() const {
+	return connections_.size();
+}
+
+void
+async_engine::wake() {
+	// an eventfd wants eight bytes, a pipe doesn't mind
+	unsigned long long one = 1;
+	if ( write( wake_write_fd_, &one, sizeof( one ) ) < 0 ) {
+		// already full of wake ups, which will do just as well
+	}
+}
+
+// start c's query going.  Returns false if it couldn't be sent, in which case it has already failed
+bool
+async_engine::send( detail::async_connection& c ) {
+	PGconn *conn = c.sql->conn;
+	std::vector<const char*> values( c.current.params.size() );
+	for ( unsigned int i = 0; i < values.size(); ++i ) {
+		values[i] = c.current.params[i].c_str();
+	}
+	c.busy = true;
+	c.last = 0;
+	const char *stmt = c.current.result->statement().c_str();
+	// as rdms::exec() would, so that statements without parameters may come several to a string
+	int sent = values.empty() && rdms::text_results == c.current.format ? PQsendQuery( conn, stmt )
+		: PQsendQueryParams( conn, stmt, values.size(), 0, values.empty() ? 0 : &values[0], 0, 0, c.current.format );
+	if ( sent ) {
+		int unflushed = PQflush( conn );
+		if ( unflushed >= 0 ) {
+			this->watch( c, 1 == unflushed );
+			return true;
+		}
+	}
+	if ( ! c.reconnected && PQstatus( conn ) == CONNECTION_BAD ) {
+		// the server dropped the connection while it was idle.  It's reconnected without blocking, driven from the
+		// loop like any other socket, and the query sent once that's done.  The old socket is let go of first,
+		// as its number may be handed to the new one
+		this->watch( c, false );
+		if ( PQresetStart( conn ) ) {
+			c.resetting = true;
+			c.reconnected = true;
+			// as per the libpq docs, behave as if the last poll asked us to wait for the socket to be writable
+			this->watch( c, true );
+			return true;
+		}
+	}
+	this->finish( c, 0, PQerrorMessage( conn ) );
+	return false;
+}
+
+// carry on reconnecting c, and once that's done send its query.  Only c's query fails if the reconnect does
+void
+async_engine::reset( detail::async_connection& c ) {
+	PGconn *conn = c.sql->conn;
+	switch ( PQresetPoll( conn ) ) {
+	case PGRES_POLLING_READING:
+		this->watch( c, false );
+		return;
+	case PGRES_POLLING_WRITING:
+		this->watch( c, true );
+		return;
+	case PGRES_POLLING_OK:
+		c.resetting = false;
+		detail::note_escape_settings( conn );
+		PQsetnonblocking( conn, 1 );
+		// statements prepared on the old connection went with it
+		c.sql->statements_.clear();
+		c.sql->stale_statements_.clear();
+		this->send( c );
+		return;
+	default:
+		c.resetting = false;
+		this->watch( c, false );
+		this->finish( c, 0, PQerrorMessage( conn ) );
+	}
+}
+
+// read whatever has arrived for c, completing its query if that's the last of it
+void
+async_engine::receive( detail::async_connection& c ) {
+	PGconn *conn = c.sql->conn;
+	if ( ! PQconsumeInput( conn ) ) {
+		if ( c.busy ) {
+			this->finish( c, c.last, PQerrorMessage( conn ) );
+		}
+		// a dead socket is always readable, so stop watching it until the next query reconnects
+		this->watch( c, false );
+		return;
+	}
+	while ( c.busy && ! PQisBusy( conn ) ) {
+		PGresult *res = PQgetResult( conn );
+		if ( ! res ) {
+			this->finish( c, c.last, "" );
+			return;
+		}
+		// with more than one statement the last result is the one that counts, unless an earlier one failed
+		ExecStatusType status = c.last ? PQresultStatus( c.last ) : PGRES_COMMAND_OK;
+		if ( PGRES_TUPLES_OK == status || PGRES_COMMAND_OK == status ) {
+			PQclear( c.last );
+			c.last = res;
+		} else {
+			PQclear( res );
+		}
+	}
+}
+
+void
+async_engine::finish( detail::async_connection& c, PGresult *res, const std::string& error ) {
+	query done = c.current;
+	c.current = query();
+	c.busy = false;
+	c.reconnected = false;
+	c.last = 0;
+	if ( c.writing ) {
+		this->watch( c, false );
+	}
+	done.result->complete( res, error );
+	if ( done.callback ) {
+		done.callback->completed( done.result );
+	}
+}
+
+// note whether c has something still to send, and make sure its socket is being watched accordingly
+void
+async_engine::watch( detail::async_connection& c, bool writing ) {
+	c.writing = writing;
+	int fd = PQstatus( c.sql->conn ) == CONNECTION_BAD ? -1 : PQsocket( c.sql->conn );
+#ifdef HAVE_SYS_EPOLL_H
+	epoll_event event;
+	event.events = EPOLLIN | ( writing ? EPOLLOUT : 0 );
+	event.data.ptr = &c;
+	if ( fd != c.fd ) {
+		if ( c.fd >= 0 ) {
+			// may already be gone if the socket was closed
+			epoll_ctl( events_fd_, EPOLL_CTL_DEL, c.fd, &event );
+		}
+		if ( fd >= 0 ) {
+			epoll_ctl( events_fd_, EPOLL_CTL_ADD, fd, &event );
+		}
+	} else if ( fd >= 0 ) {
+		epoll_ctl( events_fd_, EPOLL_CTL_MOD, fd, &event );
+	}
+#endif
+	c.fd = fd;
+}
+
+void
+async_engine::run() {
+	for (;;) {
+		// hand out as much of the queue as there are free connections for
+		for ( unsigned int i = 0; i < connections_.size(); ++i ) {
+			detail::async_connection& c = *connections_[i];
+			while ( ! c.busy ) {
+				mutex_.lock();
+				if ( stopping_ || queue_.empty() ) {
+					mutex_.unlock();
+					break;
+				}
+				c.current = queue_.front();
+				queue_.pop_front();
+				mutex_.unlock();
+				this->send( c );
+			}
+		}
+		mutex_.lock();
+		bool stopping = stopping_;
+		mutex_.unlock();
+		if ( stopping ) {
+			break;
+		}
+
+		// then wait for something to happen: a connection able to read or write, or a wake up
+		std::vector<detail::async_connection*> ready;
+		std::vector<bool> writable;
+		bool woken = false;
+#ifdef HAVE_SYS_EPOLL_H
+		epoll_event events[ 64 ];
+		int num_events = epoll_wait( events_fd_, events, 64, -1 );
+		for ( int i = 0; i < num_events; ++i ) {
+			if ( ! events[i].data.ptr ) {
+				woken = true;
+			} else {
+				ready.push_back( static_cast<detail::async_connection*>( events[i].data.ptr ) );
+				writable.push_back( events[i].events & EPOLLOUT );
+			}
+		}
+#else
+		std::vector<pollfd> fds( 1 );
+		std::vector<detail::async_connection*> polled;
+		fds[0].fd = wake_read_fd_;
+		fds[0].events = POLLIN;
+		for ( unsigned int i = 0; i < connections_.size(); ++i ) {
+			detail::async_connection *c = connections_[i];
+			if ( c->fd >= 0 ) {
+				pollfd fd;
+				fd.fd = c->fd;
+				fd.events = POLLIN | ( c->writing ? POLLOUT : 0 );
+				fds.push_back( fd );
+				polled.push_back( c );
+			}
+		}
+		for ( unsigned int i = 0; i < fds.size(); ++i ) {
+			fds[i].revents = 0;
+		}
+		if ( poll( &fds[0], fds.size(), -1 ) > 0 ) {
+			woken = fds[0].revents;
+			for ( unsigned int i = 1; i < fds.size(); ++i ) {
+				if ( fds[i].revents ) {
+					ready.push_back( polled[ i - 1 ] );
+					writable.push_back( fds[i].revents & POLLOUT );
+				}
+			}
+		}
+#endif
+		if ( woken ) {
+			unsigned long long count;
+			while ( read( wake_read_fd_, &count, sizeof( count ) ) > 0 ) { }
+		}
+		for ( unsigned int i = 0; i < ready.size(); ++i ) {
+			detail::async_connection& c = *ready[i];
+			if ( c.resetting ) {
+				this->reset( c );
+				continue;
+			}
+			if ( writable[i] && c.writing ) {
+				int unflushed = PQflush( c.sql->conn );
+				if ( unflushed < 0 ) {
+					this->finish( c, 0, PQerrorMessage( c.sql->conn ) );
+					continue;
+				}
+				this->watch( c, 1 == unflushed );
+			}
+			this->receive( c );
+		}
+	}
+}
+
+void
+async_engine::stop() {
+	mutex_.lock();
+	bool running = ! stopping_;
+	stopping_ = true;
+	std::deque<query> queued;
+	queued.swap( queue_ );
+	mutex_.unlock();
+	if ( ! running ) {
+		return;
+	}
+	this->wake();
+	thread_->getThreadControl().join();
+	thread_ = 0;
+
+	for ( unsigned int i = 0; i < connections_.size(); ++i ) {
+		detail::async_connection& c = *connections_[i];
+		PGconn *conn = c.sql->conn;
+		if ( c.resetting ) {
+			// half way through reconnecting, so not fit to go back to the pool
+			this->finish( c, 0, "async_engine stopped" );
+			delete c.sql;
+			delete connections_[i];
+			continue;
+		}
+		if ( c.busy ) {
+			if ( PGcancel *cancel = PQgetCancel( conn ) ) {
+				char err[ 256 ];
+				PQcancel( cancel, err, sizeof( err ) );
+				PQfreeCancel( cancel );
+			}
+			PQclear( c.last );
+			c.last = 0;
+		}
+		// the connection goes back to the pool in blocking mode with nothing left to read
+		PQsetnonblocking( conn, 0 );
+		while ( PGresult *res = PQgetResult( conn ) ) {
+			PQclear( res );
+		}
+		if ( c.busy ) {
+			this->finish( c, 0, "async_engine stopped" );
+		}
+		c.sql->release();
+		delete connections_[i];
+	}
+	connections_.clear();
+
+	for ( unsigned int i = 0; i < queued.size(); ++i ) {
+		queued[i].result->complete( 0, "async_engine stopped" );
+		if ( queued[i].callback ) {
+			queued[i].callback->completed( queued[i].result );
+		}
+	}
+}
@@ -0,0 +1,162 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_ASYNC_H_
+#define _TMPLSQL_ASYNC_H_
+
+#include "tmplsql/handle.h"
+
+#include <IceUtil/Shared.h>
+#include <IceUtil/Handle.h>
+#include <IceUtil/Mutex.h>
+#include <IceUtil/Monitor.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+
+namespace tmplsql {
+
+	class async_engine;
+	namespace detail {
+		class async_thread;
+		struct async_connection;
+	}
+
+	//! the outcome of a query run by async_engine, which is filled in on the engine's thread.
+	class async_result : public IceUtil::Shared {
+		friend class async_engine;
+	public:
+		//! block until the query has completed
+		/*! @return the rows the query returned, if any */
+		rdms::result_set wait();
+		//! has the query completed
+		bool ready();
+		//! did the query succeed.  Only meaningful once it has completed
+		bool ok();
+		//! the reason the query failed, if it did
+		std::string error_msg();
+		//! the statement that was run
+		const std::string& statement() const;
+	private:
+		async_result( const std::string& stmt );
+		void complete( PGresult *res, const std::string& error );
+
+		IceUtil::Monitor<IceUtil::Mutex> monitor_;
+		std::string statement_;
+		rdms::result_set rows_;
+		std::string error_;
+		bool done_;
+		bool ok_;
+	};
+
+	//! reference counted pointer to an async_result
+	typedef IceUtil::Handle<async_result> async_result_ptr;
+
+	//! notified when a query run by async_engine completes.
+	/*!
+	  completed() is called on the engine's own thread, which isn't looking after any of the engine's other queries
+	  while it runs, so it must be quick.  It must not wait on another query from the same engine, nor stop or destroy
+	  the engine, which waits for that same thread to finish.  Anything more should be passed off to another thread.
+	  A coroutine carried on from here, as co_select() does without a co_scheduler, is part of completed() until it
+	  next suspends.
+	*/
+	class async_callback : public IceUtil::Shared {
+	public:
+		//! the query behind result has completed
+		virtual void completed( const async_result_ptr& result ) = 0;
+		//! dtor
+		virtual ~async_callback();
+	};
+
+	//! reference counted pointer to an async_callback
+	typedef IceUtil::Handle<async_callback> async_callback_ptr;
+
+	//! runs queries over a set of connections from a single thread, without blocking the threads that submit them.
+	/*!
+	  The engine checks connections out of the named pool and keeps them for as long as it runs.  Queries may be
+	  submitted from any thread; they are queued, sent on whichever connection is free using libpq's non blocking calls,
+	  and the results collected as they arrive, with epoll (or poll where epoll isn't available) watching all the
+	  connections at once.  So one thread can have as many queries in flight as the engine has connections.
+	  <pre><code>
+	  tmplsql::async_engine engine( "", 16 );
+	  tmplsql::async_result_ptr a = engine.submit( "select count(*) from users" );
+	  tmplsql::async_result_ptr b = engine.submit( "select count(*) from orders" );
+	  std::cout << *a->wait().begin()[0] << " " << *b->wait().begin()[0] << std::endl;
+	  </code></pre>
+	  Each query runs in a transaction of its own, on whichever connection is free, so anything that has to see another
+	  query's effects should wait for it first.
+	*/
+	class async_engine {
+	public:
+		/*!
+		  @param pool_name pool to take connections from, see rdms::initialize
+		  @param connections most queries to have in flight at once
+		*/
+		async_engine( const std::string& pool_name = "", int connections = 8 );
+
+		//! stops the engine, see stop()
+		~async_engine();
+
+		//! queue stmt to be run
+		/*!
+		  @param stmt statement to run
+		  @param params values for the statement's $1, $2 ... placeholders
+		  @param format form to have the results sent in
+		  @param callback called once the statement has completed, if given
+		*/
+		async_result_ptr submit( const std::string& stmt, const std::vector<std::string>& params = std::vector<std::string>(),
+					 rdms::result_format format = rdms::text_results, const async_callback_ptr& callback = 0 );
+
+		//! queue the statement built up in sql, along with any values bound with tmplsql::param(), and clear it from sql
+		async_result_ptr submit( rdms& sql, rdms::result_format format = rdms::text_results,
+					 const async_callback_ptr& callback = 0 );
+
+		//! number of connections the engine has open
+		int connections() const;
+
+		//! stop the engine.  Queries still in flight are cancelled, and they and any still queued fail.
+		void stop();
+	private:
+		friend class detail::async_thread;
+		friend struct detail::async_connection;
+
+		async_engine( const async_engine& );
+		async_engine& operator=( const async_engine& );
+
+		// a query waiting its turn, or in flight
+		struct query {
+			async_result_ptr result;
+			async_callback_ptr callback;
+			std::vector<std::string> params;
+			rdms::result_format format;
+		};
+
+		void run();
+		void wake();
+		bool send( detail::async_connection& c );
+		void reset( detail::async_connection& c );
+		void receive( detail::async_connection& c );
+		void finish( detail::async_connection& c, PGresult *res, const std::string& error );
+		void watch( detail::async_connection& c, bool writing );
+
+		std::vector<detail::async_connection*> connections_;
+
+		// queries waiting for a connection, guarded by mutex_
+		IceUtil::Mutex mutex_;
+		std::deque<query> queue_;
+		bool stopping_;
+
+		int events_fd_;
+		int wake_read_fd_;
+		int wake_write_fd_;
+		IceUtil::Handle<detail::async_thread> thread_;
+	};
+
+}
+
+#endif // _TMPLSQL_ASYNC_H_
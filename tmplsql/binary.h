@@ -0,0 +1,582 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_BINARY_H_
+#define _TMPLSQL_BINARY_H_
+
+#include "tmplsql/rdms.h"
+#include "tmplsql/lexical_cast.h"
+#include "tmplsql/sql_writer.h"
+
+#include <boost/type_traits.hpp>
+#include <limits>
+#include <string>
+#include <sstream>
+#include <string.h>
+#include <stdio.h>
+
+namespace tmplsql {
+
+	namespace detail {
+
+		//! type oids of the columns that can be decoded from binary, from the server's pg_type.h
+		enum type_oid {
+			bool_oid = 16,
+			name_oid = 19,
+			int8_oid = 20,
+			int2_oid = 21,
+			int4_oid = 23,
+			text_oid = 25,
+			oid_oid = 26,
+			float4_oid = 700,
+			float8_oid = 701,
+			unknown_oid = 705,
+			bpchar_oid = 1042,
+			varchar_oid = 1043,
+			date_oid = 1082,
+			timestamp_oid = 1114,
+			timestamptz_oid = 1184,
+			interval_oid = 1186,
+			numeric_oid = 1700
+		};
+
+		//! seconds from the unix epoch to the postgres epoch of 2000-01-01, which binary dates and timestamps count from
+		const long long postgres_epoch = 946684800LL;
+
+		//! read a big endian 16 bit value
+		inline unsigned short read_uint16( const char *p ) {
+			const unsigned char *u = reinterpret_cast<const unsigned char*>( p );
+			return static_cast<unsigned short>( ( u[0] << 8 ) | u[1] );
+		}
+
+		//! read a big endian 32 bit value
+		inline unsigned int read_uint32( const char *p ) {
+			const unsigned char *u = reinterpret_cast<const unsigned char*>( p );
+			return ( static_cast<unsigned int>( u[0] ) << 24 ) | ( static_cast<unsigned int>( u[1] ) << 16 )
+				| ( static_cast<unsigned int>( u[2] ) << 8 ) | u[3];
+		}
+
+		//! read a big endian 64 bit value
+		inline unsigned long long read_uint64( const char *p ) {
+			return ( static_cast<unsigned long long>( read_uint32( p ) ) << 32 ) | read_uint32( p + 4 );
+		}
+
+		//! read a float4
+		inline float read_float4( const char *p ) {
+			unsigned int bits = read_uint32( p );
+			float ret_val;
+			memcpy( &ret_val, &bits, sizeof( ret_val ) );
+			return ret_val;
+		}
+
+		//! read a float8
+		inline double read_float8( const char *p ) {
+			unsigned long long bits = read_uint64( p );
+			double ret_val;
+			memcpy( &ret_val, &bits, sizeof( ret_val ) );
+			return ret_val;
+		}
+
+		//! read a numeric as a double.
+		/*! A binary numeric is a count of base 10000 digits, the weight of the first digit, a sign and the display scale,
+		  each 16 bits, followed by the digits themselves. */
+		inline double read_numeric( const char *p, int length ) {
+			if ( length < 8 ) {
+				return 0;
+			}
+			int ndigits = read_uint16( p );
+			int weight = static_cast<short>( read_uint16( p + 2 ) );
+			int sign = read_uint16( p + 4 );
+			// NaN and the infinities come out as they do from the text the server would have sent
+			switch ( sign ) {
+			case 0xc000:
+				return std::numeric_limits<double>::quiet_NaN();
+			case 0xd000:
+				return std::numeric_limits<double>::infinity();
+			case 0xf000:
+				return -std::numeric_limits<double>::infinity();
+			}
+			if ( ( sign && 0x4000 != sign ) || length < 8 + ndigits * 2 ) {
+				return 0;
+			}
+			double ret_val = 0;
+			for ( int i = 0; i < ndigits; ++i ) {
+				ret_val = ret_val * 10000 + read_uint16( p + 8 + i * 2 );
+			}
+			// the digits read are worth 10000^( weight - ndigits + 1 ) each
+			for ( int shift = weight - ndigits + 1; shift > 0; --shift ) {
+				ret_val *= 10000;
+			}
+			for ( int shift = weight - ndigits + 1; shift < 0; ++shift ) {
+				ret_val /= 10000;
+			}
+			return 0x4000 == sign ? -ret_val : ret_val;
+		}
+
+		//! read the integer part of a numeric, exactly as long as it fits in 64 bits.  NaN and the infinities, which no integer can hold, give 0
+		inline long long read_numeric_integer( const char *p, int length ) {
+			if ( length < 8 ) {
+				return 0;
+			}
+			int ndigits = read_uint16( p );
+			int weight = static_cast<short>( read_uint16( p + 2 ) );
+			int sign = read_uint16( p + 4 );
+			if ( ( sign && 0x4000 != sign ) || length < 8 + ndigits * 2 ) {
+				return 0;
+			}
+			long long ret_val = 0;
+			// digits 0 .. weight are the integer part, any beyond ndigits being zeros
+			for ( int i = 0; i <= weight; ++i ) {
+				ret_val = ret_val * 10000 + ( i < ndigits ? read_uint16( p + 8 + i * 2 ) : 0 );
+			}
+			return 0x4000 == sign ? -ret_val : ret_val;
+		}
+
+		//! read a timestamp, timestamptz or date as a count of seconds since the unix epoch, along with any fraction of a second
+		inline long long read_epoch( const char *p, Oid type, long long& microseconds ) {
+			if ( date_oid == type ) {
+				microseconds = 0;
+				return static_cast<int>( read_uint32( p ) ) * 86400LL + postgres_epoch;
+			}
+			// microseconds since the postgres epoch.  Round towards negative infinity so the fraction is never negative
+			long long since = static_cast<long long>( read_uint64( p ) );
+			long long seconds = since / 1000000;
+			microseconds = since % 1000000;
+			if ( microseconds < 0 ) {
+				microseconds += 1000000;
+				--seconds;
+			}
+			return seconds + postgres_epoch;
+		}
+
+		//! the text the server sends for a numeric in text results, from its binary form, with every digit kept
+		inline std::string numeric_text( const char *p, int length ) {
+			if ( length < 8 ) {
+				return std::string();
+			}
+			int ndigits = read_uint16( p );
+			int weight = static_cast<short>( read_uint16( p + 2 ) );
+			int sign = read_uint16( p + 4 );
+			int scale = read_uint16( p + 6 );
+			switch ( sign ) {
+			case 0xc000:
+				return "NaN";
+			case 0xd000:
+				return "Infinity";
+			case 0xf000:
+				return "-Infinity";
+			}
+			if ( ( sign && 0x4000 != sign ) || length < 8 + ndigits * 2 ) {
+				return std::string();
+			}
+			std::string ret_val;
+			if ( 0x4000 == sign ) {
+				ret_val += '-';
+			}
+			char group[8];
+			// digits 0 .. weight are the integer part, any beyond ndigits being zeros
+			if ( weight < 0 ) {
+				ret_val += '0';
+			}
+			for ( int i = 0; i <= weight; ++i ) {
+				snprintf( group, sizeof( group ), i ? "%04d" : "%d", i < ndigits ? read_uint16( p + 8 + i * 2 ) : 0 );
+				ret_val += group;
+			}
+			// then as many of the fraction's as the scale says, four decimal digits to each
+			if ( scale > 0 ) {
+				ret_val += '.';
+				std::string::size_type end = ret_val.size() + scale;
+				for ( int i = weight + 1; ret_val.size() < end; ++i ) {
+					snprintf( group, sizeof( group ), "%04d", i >= 0 && i < ndigits ? read_uint16( p + 8 + i * 2 ) : 0 );
+					ret_val += group;
+				}
+				ret_val.resize( end );
+			}
+			return ret_val;
+		}
+
+		//! append the date that is days after the postgres epoch to out, as YYYY-MM-DD
+		/*! @return true if the year is before 1 AD, which the server writes as a positive year followed by BC */
+		inline bool append_date( std::string& out, long long days ) {
+			// civil date from a day count, counting from 0000-03-01 so that leap days fall at the end of the year
+			long long z = days + 10957 + 719468;
+			long long era = ( z >= 0 ? z : z - 146096 ) / 146097;
+			long long doe = z - era * 146097;
+			long long yoe = ( doe - doe / 1460 + doe / 36524 - doe / 146096 ) / 365;
+			long long doy = doe - ( 365 * yoe + yoe / 4 - yoe / 100 );
+			long long mp = ( 5 * doy + 2 ) / 153;
+			int day = static_cast<int>( doy - ( 153 * mp + 2 ) / 5 + 1 );
+			int month = static_cast<int>( mp < 10 ? mp + 3 : mp - 9 );
+			long long year = yoe + era * 400 + ( month <= 2 );
+			bool bc = year <= 0;
+			char text[32];
+			snprintf( text, sizeof( text ), "%04lld-%02d-%02d", bc ? 1 - year : year, month, day );
+			out += text;
+			return bc;
+		}
+
+		//! append microseconds, which must not be negative, to out as HH:MM:SS with any fraction of a second the server would show
+		inline void append_clock( std::string& out, long long microseconds ) {
+			char text[48];
+			int length = snprintf( text, sizeof( text ), "%02lld:%02d:%02d", microseconds / 3600000000LL,
+					       static_cast<int>( microseconds / 60000000 % 60 ), static_cast<int>( microseconds / 1000000 % 60 ) );
+			if ( microseconds % 1000000 ) {
+				length += snprintf( text + length, sizeof( text ) - length, ".%06d", static_cast<int>( microseconds % 1000000 ) );
+				// trailing zeros are left off
+				while ( '0' == text[ length - 1 ] ) {
+					--length;
+				}
+			}
+			out.append( text, length );
+		}
+
+		//! the text the server sends for a date, timestamp or timestamptz in text results with the default ISO date style.
+		/*! A timestamptz is written in UTC, rather than in the time zone of the session as the server would. */
+		inline std::string datetime_text( const char *p, Oid type ) {
+			std::string ret_val;
+			bool bc;
+			if ( date_oid == type ) {
+				int days = static_cast<int>( read_uint32( p ) );
+				if ( 0x7fffffff == days ) {
+					return "infinity";
+				} else if ( static_cast<int>( 0x80000000U ) == days ) {
+					return "-infinity";
+				}
+				bc = append_date( ret_val, days );
+			} else {
+				long long since = static_cast<long long>( read_uint64( p ) );
+				if ( 0x7fffffffffffffffLL == since ) {
+					return "infinity";
+				} else if ( static_cast<long long>( 0x8000000000000000ULL ) == since ) {
+					return "-infinity";
+				}
+				// round the day towards negative infinity so the time of day is never negative
+				long long days = since / 86400000000LL;
+				if ( since % 86400000000LL < 0 ) {
+					--days;
+				}
+				bc = append_date( ret_val, days );
+				ret_val += ' ';
+				append_clock( ret_val, since - days * 86400000000LL );
+				if ( timestamptz_oid == type ) {
+					ret_val += "+00";
+				}
+			}
+			if ( bc ) {
+				ret_val += " BC";
+			}
+			return ret_val;
+		}
+
+		//! the text the server sends for an interval in text results with the default postgres interval style
+		inline std::string interval_text( const char *p ) {
+			long long microseconds = static_cast<long long>( read_uint64( p ) );
+			int days = static_cast<int>( read_uint32( p + 8 ) );
+			int months = static_cast<int>( read_uint32( p + 12 ) );
+			const int parts[3] = { months / 12, months % 12, days };
+			const char *units[3] = { "year", "mon", "day" };
+			std::string ret_val;
+			bool negative = false;
+			char text[32];
+			for ( int i = 0; i < 3; ++i ) {
+				if ( parts[i] ) {
+					snprintf( text, sizeof( text ), "%s%d %s%s", ret_val.empty() ? "" : " ", parts[i], units[i], 1 == parts[i] ? "" : "s" );
+					ret_val += text;
+					negative = parts[i] < 0;
+				}
+			}
+			if ( microseconds || ret_val.empty() ) {
+				if ( ! ret_val.empty() ) {
+					ret_val += ' ';
+				}
+				// the time's sign is shown if it's negative, or if it differs from what came before
+				if ( microseconds < 0 ) {
+					ret_val += '-';
+				} else if ( negative ) {
+					ret_val += '+';
+				}
+				append_clock( ret_val, microseconds < 0 ? -microseconds : microseconds );
+			}
+			return ret_val;
+		}
+
+		//! are values of type sent as text even in binary results
+		inline bool text_type( Oid type ) {
+			switch ( type ) {
+			case text_oid: case varchar_oid: case bpchar_oid: case name_oid: case unknown_oid:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		//! conversion of a binary value to T, chosen by what sort of type T is
+		template<typename T, bool Integral = boost::is_integral<T>::value, bool Float = boost::is_float<T>::value >
+		struct binary_value;
+
+		//! integers
+		template<typename T>
+		struct binary_value<T, true, false> {
+			static T decode( const char *p, int length, Oid type ) {
+				switch ( type ) {
+				case int2_oid:
+					return static_cast<T>( static_cast<short>( read_uint16( p ) ) );
+				case int4_oid:
+					return static_cast<T>( static_cast<int>( read_uint32( p ) ) );
+				case oid_oid:
+					return static_cast<T>( read_uint32( p ) );
+				case int8_oid:
+					return static_cast<T>( static_cast<long long>( read_uint64( p ) ) );
+				case bool_oid:
+					return static_cast<T>( *p ? 1 : 0 );
+				case float4_oid:
+					return static_cast<T>( read_float4( p ) );
+				case float8_oid:
+					return static_cast<T>( read_float8( p ) );
+				case numeric_oid:
+					return static_cast<T>( read_numeric_integer( p, length ) );
+				case date_oid: case timestamp_oid: case timestamptz_oid: {
+					long long microseconds;
+					return static_cast<T>( read_epoch( p, type, microseconds ) );
+				}
+				default:
+					return lexical_cast<T>( p );
+				}
+			}
+		};
+
+		//! floating point
+		template<typename T>
+		struct binary_value<T, false, true> {
+			static T decode( const char *p, int length, Oid type ) {
+				switch ( type ) {
+				case float4_oid:
+					return static_cast<T>( read_float4( p ) );
+				case float8_oid:
+					return static_cast<T>( read_float8( p ) );
+				case numeric_oid:
+					return static_cast<T>( read_numeric( p, length ) );
+				case date_oid: case timestamp_oid: case timestamptz_oid: {
+					long long microseconds;
+					long long seconds = read_epoch( p, type, microseconds );
+					return static_cast<T>( seconds ) + static_cast<T>( microseconds ) / 1000000;
+				}
+				case int2_oid: case int4_oid: case int8_oid: case oid_oid: case bool_oid:
+					return static_cast<T>( binary_value<long long>::decode( p, length, type ) );
+				default:
+					return lexical_cast<T>( p );
+				}
+			}
+		};
+
+		//! bool, which would otherwise be taken for an integer
+		template<>
+		struct binary_value<bool, true, false> {
+			static bool decode( const char *p, int length, Oid type ) {
+				if ( bool_oid == type ) {
+					return *p;
+				}
+				if ( text_type( type ) ) {
+					return lexical_cast<bool>( p );
+				}
+				return binary_value<long long>::decode( p, length, type ) != 0;
+			}
+		};
+
+		//! std::string, as the server would send it in text results.
+		/*! Numbers, bools, dates, timestamps and intervals are written as the server writes them, numerics with every digit.
+		  A timestamptz comes out in UTC rather than the session's time zone.  Any other type comes out as it was sent,
+		  which for those whose binary form isn't their text, such as arrays, uuid and bytea, means they should be read
+		  with rdms::text_results. */
+		template<>
+		struct binary_value<std::string, false, false> {
+			static std::string decode( const char *p, int length, Oid type ) {
+				char text[ sql_text_size ];
+				switch ( type ) {
+				case bool_oid:
+					return *p ? "t" : "f";
+				case int2_oid: case int4_oid: case int8_oid: case oid_oid:
+					return std::string( text, sql_text<long long>::write( text, binary_value<long long>::decode( p, length, type ) ) );
+				case float4_oid:
+					return std::string( text, sql_text<float>::write( text, read_float4( p ) ) );
+				case float8_oid:
+					return std::string( text, sql_text<double>::write( text, read_float8( p ) ) );
+				case numeric_oid:
+					return numeric_text( p, length );
+				case date_oid: case timestamp_oid: case timestamptz_oid:
+					return datetime_text( p, type );
+				case interval_oid:
+					return interval_text( p );
+				default:
+					return std::string( p, length );
+				}
+			}
+		};
+
+		//! anything else is converted from the text form of the value
+		template<typename T, bool Integral, bool Float>
+		struct binary_value {
+			static T decode( const char *p, int length, Oid type ) {
+				return lexical_cast<T>( binary_value<std::string>::decode( p, length, type ).c_str() );
+			}
+		};
+
+		//! convert the value in column index of row to T.
+		/*!
+		  Text results are converted with lexical_cast, as they always have been.  Binary results are decoded straight from
+		  network byte order according to both T and the column's type, so int2, int4, int8, oid, float4, float8, numeric and bool
+		  columns may be read in to any arithmetic type, and date, timestamp and timestamptz columns in to an arithmetic type
+		  holding seconds since the unix epoch.  A null comes out as T().
+		*/
+		template<typename T>
+		inline T decode( const rdms::result_set::rows_iterator& row, int index ) {
+			if ( ! row.binary( index ) ) {
+				return lexical_cast<T>( row[ index ] );
+			}
+			if ( row.is_null( index ) ) {
+				return T();
+			}
+			return binary_value<T>::decode( row[ index ], row.length( index ), row.type( index ) );
+		}
+
+		//! text_ref points at the value where it is in the results, in whichever form it was sent.  A null comes out empty.
+		template<>
+		inline text_ref decode<text_ref>( const rdms::result_set::rows_iterator& row, int index ) {
+			return row.text( index );
+		}
+
+		//! the type to decode a binary COPY column of length bytes as, when reading it in to T.
+		/*! Binary COPY doesn't say what type its columns are, so it is guessed from T and the length,
+		  which works as long as the column's type is the one binary_encoder would send T as. */
+		template<typename T>
+		inline Oid copy_column_type( int length ) {
+			if ( boost::is_same<T,bool>::value ) {
+				return bool_oid;
+			}
+			if ( boost::is_integral<T>::value ) {
+				return 1 == length ? bool_oid : 2 == length ? int2_oid : 4 == length ? int4_oid : int8_oid;
+			}
+			if ( boost::is_float<T>::value ) {
+				return 4 == length ? float4_oid : float8_oid;
+			}
+			return text_oid;
+		}
+
+		//! append a big endian 16 bit value to out
+		inline void write_uint16( std::string& out, unsigned short value ) {
+			char bytes[2] = { static_cast<char>( value >> 8 ), static_cast<char>( value ) };
+			out.append( bytes, 2 );
+		}
+
+		//! append a big endian 32 bit value to out
+		inline void write_uint32( std::string& out, unsigned int value ) {
+			char bytes[4] = { static_cast<char>( value >> 24 ), static_cast<char>( value >> 16 ),
+					  static_cast<char>( value >> 8 ), static_cast<char>( value ) };
+			out.append( bytes, 4 );
+		}
+
+		//! append a big endian 64 bit value to out
+		inline void write_uint64( std::string& out, unsigned long long value ) {
+			write_uint32( out, static_cast<unsigned int>( value >> 32 ) );
+			write_uint32( out, static_cast<unsigned int>( value ) );
+		}
+
+		//! conversion of T to its binary form, as a length followed by the bytes, the way binary COPY wants each column.
+		/*!
+		  Integers are sent as int2, int4 or int8 according to their size, float as a float4, double as a float8,
+		  bool as a bool and strings as text, so the table's columns must be of just those types.  Anything else
+		  is sent as its text form, which only a text column will take.
+		*/
+		template<typename T, bool Integral = boost::is_integral<T>::value, bool Float = boost::is_float<T>::value >
+		struct binary_encoder;
+
+		//! integers
+		template<typename T>
+		struct binary_encoder<T, true, false> {
+			static void encode( std::string& out, T value ) {
+				write_uint32( out, sizeof( T ) <= 2 ? 2 : sizeof( T ) <= 4 ? 4 : 8 );
+				if ( sizeof( T ) <= 2 ) {
+					write_uint16( out, static_cast<unsigned short>( value ) );
+				} else if ( sizeof( T ) <= 4 ) {
+					write_uint32( out, static_cast<unsigned int>( value ) );
+				} else {
+					write_uint64( out, static_cast<unsigned long long>( value ) );
+				}
+			}
+		};
+
+		//! floating point
+		template<typename T>
+		struct binary_encoder<T, false, true> {
+			static void encode( std::string& out, T value ) {
+				if ( sizeof( T ) <= 4 ) {
+					float f = static_cast<float>( value );
+					unsigned int bits;
+					memcpy( &bits, &f, sizeof( bits ) );
+					write_uint32( out, 4 );
+					write_uint32( out, bits );
+				} else {
+					double d = static_cast<double>( value );
+					unsigned long long bits;
+					memcpy( &bits, &d, sizeof( bits ) );
+					write_uint32( out, 8 );
+					write_uint64( out, bits );
+				}
+			}
+		};
+
+		//! bool, which would otherwise be taken for an integer
+		template<>
+		struct binary_encoder<bool, true, false> {
+			static void encode( std::string& out, bool value ) {
+				write_uint32( out, 1 );
+				out += value ? '\1' : '\0';
+			}
+		};
+
+		//! std::string
+		template<>
+		struct binary_encoder<std::string, false, false> {
+			static void encode( std::string& out, const std::string& value ) {
+				write_uint32( out, value.size() );
+				out += value;
+			}
+		};
+
+		//! anything else goes by its text form
+		template<typename T, bool Integral, bool Float>
+		struct binary_encoder {
+			static void encode( std::string& out, const T& value ) {
+				std::ostringstream str;
+				str.precision( 17 );
+				str << value;
+				binary_encoder<std::string>::encode( out, str.str() );
+			}
+		};
+
+		//! append value to out in binary, preceeded by its length
+		template<typename T>
+		inline void encode( std::string& out, const T& value ) {
+			binary_encoder<T>::encode( out, value );
+		}
+
+		//! const char*, where a null pointer is sent as a null
+		inline void encode( std::string& out, const char *value ) {
+			if ( ! value ) {
+				write_uint32( out, 0xffffffff );
+				return;
+			}
+			unsigned int length = strlen( value );
+			write_uint32( out, length );
+			out.append( value, length );
+		}
+
+	} // namespace detail
+
+} // namespace tmplsql
+
+#endif // _TMPLSQL_BINARY_H_
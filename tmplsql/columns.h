@@ -0,0 +1,256 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_COLUMNS_H_
+#define _TMPLSQL_COLUMNS_H_
+
+#include "tmplsql/rdms.h"
+#include "tmplsql/binary.h"
+#include <boost/tuple/tuple.hpp>
+#include <vector>
+#include <stddef.h>
+
+namespace tmplsql {
+
+	//! one column of a result set, read a column at a time by recordset::columns().
+	/*!
+	  The values are held one after another in a single vector, so that they can be summed, compared and so on in a
+	  tight loop the compiler can vectorize.  A null comes out as T(), with its bit set in nulls.
+	  <pre><code>
+	  tmplsql::recordset<int,double>::columns_type cols = rs.columns();
+	  const std::vector<double>& prices = cols.get<1>().values;
+	  double total = std::accumulate( prices.begin(), prices.end(), 0.0 );
+	  </code></pre>
+	*/
+	template<typename T>
+	struct column {
+		//! the type of the values
+		typedef T value_type;
+		//! the value of the column in each row
+		std::vector<T> values;
+		//! bit row % 64 of word row / 64 is set when the column is null in that row
+		std::vector<unsigned long long> nulls;
+
+		//! number of rows
+		size_t size() const {
+			return values.size();
+		}
+
+		//! was the column null in row
+		bool is_null( size_t row ) const {
+			return ( nulls[ row / 64 ] >> ( row % 64 ) ) & 1;
+		}
+
+		//! is the column null in any row
+		bool has_nulls() const {
+			for ( size_t i = 0; i < nulls.size(); ++i ) {
+				if ( nulls[i] ) {
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
+	namespace detail {
+
+		//! how many rows ahead of the one being decoded to prefetch
+		enum { column_prefetch_rows = 8 };
+
+		//! hint that the value at p will be read soon.  Does nothing on compilers without the builtin
+		inline void prefetch( const void *p ) {
+		#if (__GNUC__)
+			__builtin_prefetch( p );
+		#else
+			(void) p;
+		#endif
+		}
+
+		//! converts a value type to the column holding it
+		template<typename T>
+		struct make_column {
+			//! the column
+			typedef column<T> type;
+		};
+
+		//! specialization of make_column to leave null_type as is
+		template<>
+		struct make_column< boost::tuples::null_type > {
+			//! don't muck with null_type
+			typedef boost::tuples::null_type type;
+		};
+
+		//! reads a column of a result_set in to a column<T>
+		/*! Whatever depends on the column, its format and type, is worked out once up front rather than for each row.
+		  Fixed width binary columns that T holds as they are have a loop of their own, with nothing in it but the read. */
+		template<typename T>
+		struct column_decoder {
+
+			//! decode column index of every row in rs in to out
+			static void decode( const rdms::result_set& rs, int index, column<T>& out ) {
+				int rows = rs.num_rows_ > 0 ? rs.num_rows_ : 0;
+				out.values.assign( rows, T() );
+				out.nulls.assign( ( rows + 63 ) / 64, 0 );
+				if ( ! rows || index >= rs.num_fields_ ) {
+					return;
+				}
+				// rows read in parts go one part after another in to the one column
+				int offset = 0;
+				for ( unsigned int i = 0; i < rs.parts(); ++i ) {
+					PGresult *res = rs.part( i );
+					decode_part( res, index, out, offset );
+					offset += PQntuples( res );
+				}
+			}
+
+		private:
+			//! decode column index of the rows in res in to out, starting at row offset of out
+			static void decode_part( PGresult *res, int index, column<T>& out, int offset ) {
+				if ( 1 != PQfformat( res, index ) ) {
+					decode_text( res, index, out, offset );
+					return;
+				}
+				bool decoded = false;
+				switch ( PQftype( res, index ) ) {
+				case int4_oid:
+					decoded = decode_fixed<read_int4, boost::is_integral<T>::value && 4 == sizeof( T )>::run( res, index, out, offset );
+					break;
+				case int8_oid:
+					decoded = decode_fixed<read_int8, boost::is_integral<T>::value && 8 == sizeof( T )>::run( res, index, out, offset );
+					break;
+				case float8_oid:
+					decoded = decode_fixed<read_double, boost::is_same<T, double>::value>::run( res, index, out, offset );
+					break;
+				case float4_oid:
+					decoded = decode_fixed<read_float, boost::is_same<T, float>::value>::run( res, index, out, offset );
+					break;
+				}
+				if ( decoded ) {
+					return;
+				}
+				decode_binary( res, index, out, offset );
+			}
+
+			//! readers for decode_fixed
+			struct read_int4 {
+				static T read( const char *p ) { return static_cast<T>( static_cast<int>( read_uint32( p ) ) ); }
+			};
+			struct read_int8 {
+				static T read( const char *p ) { return static_cast<T>( static_cast<long long>( read_uint64( p ) ) ); }
+			};
+			struct read_double {
+				static T read( const char *p ) { return static_cast<T>( read_float8( p ) ); }
+			};
+			struct read_float {
+				static T read( const char *p ) { return static_cast<T>( read_float4( p ) ); }
+			};
+
+			//! note that row is null
+			static void set_null( column<T>& out, int row ) {
+				out.nulls[ row / 64 ] |= 1ULL << ( row % 64 );
+			}
+
+			//! binary values of a fixed width that Reader reads straight in to a T, when Usable
+			template<class Reader, bool Usable>
+			struct decode_fixed {
+				static bool run( PGresult*, int, column<T>&, int ) {
+					return false;
+				}
+			};
+
+			template<class Reader>
+			struct decode_fixed<Reader, true> {
+				static bool run( PGresult *res, int index, column<T>& out, int offset ) {
+					T *values = &out.values[ offset ];
+					int rows = PQntuples( res );
+					for ( int row = 0; row < rows; ++row ) {
+						if ( row + column_prefetch_rows < rows ) {
+							prefetch( PQgetvalue( res, row + column_prefetch_rows, index ) );
+						}
+						if ( PQgetisnull( res, row, index ) ) {
+							set_null( out, offset + row );
+						} else {
+							values[ row ] = Reader::read( PQgetvalue( res, row, index ) );
+						}
+					}
+					return true;
+				}
+			};
+
+			//! any other binary column, as detail::decode() reads it
+			static void decode_binary( PGresult *res, int index, column<T>& out, int offset ) {
+				Oid type = PQftype( res, index );
+				int rows = PQntuples( res );
+				for ( int row = 0; row < rows; ++row ) {
+					if ( row + column_prefetch_rows < rows ) {
+						prefetch( PQgetvalue( res, row + column_prefetch_rows, index ) );
+					}
+					if ( PQgetisnull( res, row, index ) ) {
+						set_null( out, offset + row );
+					} else {
+						out.values[ offset + row ] = binary_value<T>::decode( PQgetvalue( res, row, index ), PQgetlength( res, row, index ), type );
+					}
+				}
+			}
+
+			//! text, converted by lexical_cast
+			static void decode_text( PGresult *res, int index, column<T>& out, int offset ) {
+				int rows = PQntuples( res );
+				for ( int row = 0; row < rows; ++row ) {
+					if ( row + column_prefetch_rows < rows ) {
+						prefetch( PQgetvalue( res, row + column_prefetch_rows, index ) );
+					}
+					if ( PQgetisnull( res, row, index ) ) {
+						set_null( out, offset + row );
+					} else {
+						out.values[ offset + row ] = lexical_cast<T>( PQgetvalue( res, row, index ) );
+					}
+				}
+			}
+		};
+
+		//! text_refs in to the results, so reading a column of text allocates nothing but the vector of them
+		template<>
+		struct column_decoder<text_ref> {
+			static void decode( const rdms::result_set& rs, int index, column<text_ref>& out ) {
+				int rows = rs.num_rows_ > 0 ? rs.num_rows_ : 0;
+				out.values.clear();
+				out.values.reserve( rows );
+				out.nulls.assign( ( rows + 63 ) / 64, 0 );
+				if ( ! rows || index >= rs.num_fields_ ) {
+					out.values.resize( rows );
+					return;
+				}
+				for ( unsigned int i = 0; i < rs.parts(); ++i ) {
+					PGresult *res = rs.part( i );
+					int part_rows = PQntuples( res );
+					for ( int row = 0; row < part_rows; ++row ) {
+						int n = out.values.size();
+						if ( PQgetisnull( res, row, index ) ) {
+							out.nulls[ n / 64 ] |= 1ULL << ( n % 64 );
+						}
+						out.values.push_back( text_ref( PQgetvalue( res, row, index ), PQgetlength( res, row, index ), rs.life_ ) );
+					}
+				}
+			}
+		};
+
+		//! end of the columns
+		inline void fill_columns( const rdms::result_set&, int, const boost::tuples::null_type& ) { }
+
+		//! decode each column of rs, from index on, in to columns
+		template<class H, class T>
+		inline void fill_columns( const rdms::result_set& rs, int index, boost::tuples::cons<H,T>& columns ) {
+			column_decoder<typename H::value_type>::decode( rs, index, columns.get_head() );
+			fill_columns( rs, index + 1, columns.get_tail() );
+		}
+
+	} // namespace detail
+
+} // namespace tmplsql
+
+#endif // _TMPLSQL_COLUMNS_H_
@@ -0,0 +1,619 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+
+#include "tmplsql/connection_pool.h"
+
+#include "config.h"
+
+#include <IceUtil/Monitor.h>
+#include <IceUtil/Thread.h>
+#include <IceUtil/Time.h>
+
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+using namespace tmplsql;
+
+namespace tmplsql {
+	namespace detail {
+
+		// a thread waiting in connection_pool::checkout() for a connection to come free
+		struct pool_waiter {
+			pool_waiter() : handed( 0 ), done( false ) { }
+			// wake the waiter with handle h, or with 0 meaning a slot has been reserved for it to open its own
+			void serve( rdms *h ) {
+				monitor.lock();
+				handed = h;
+				done = true;
+				monitor.notify();
+				monitor.unlock();
+			}
+			IceUtil::Monitor<IceUtil::Mutex> monitor;
+			rdms *handed;
+			bool done;
+		};
+
+		// wakes up every pool_options::maintenance_interval to look over the pool's idle connections,
+		// so that checkout() can hand them out without checking them itself
+		class pool_maintainer : public IceUtil::Thread {
+		public:
+			pool_maintainer( connection_pool *pool, int interval ) :
+				pool_( pool ),
+				interval_( interval ),
+				stop_( false )
+			{ }
+
+			void run() {
+				monitor_.lock();
+				while ( ! stop_ ) {
+					monitor_.timedWait( IceUtil::Time::milliSeconds( interval_ ) );
+					if ( stop_ ) {
+						break;
+					}
+					monitor_.unlock();
+					pool_->check_idle();
+					monitor_.lock();
+				}
+				monitor_.unlock();
+			}
+
+			void stop() {
+				monitor_.lock();
+				stop_ = true;
+				monitor_.notify();
+				monitor_.unlock();
+				this->getThreadControl().join();
+			}
+		private:
+			connection_pool *pool_;
+			int interval_;
+			IceUtil::Monitor<IceUtil::Mutex> monitor_;
+			bool stop_;
+		};
+
+	} // namespace detail
+} // namespace tmplsql
+
+
+typedef std::map<std::string, connection_pool*> registry_type;
+
+// Readers look pools up through this without a lock.  Adding a pool copies the map and swaps the pointer;
+// the old copies are never freed, as a reader may still be looking at one, but pools are only created at
+// startup so there are never more than a handful of them.
+static registry_type * volatile registry = 0;
+static IceUtil::Mutex registry_mutex;
+
+
+// Open count connections at once, driving all of the handshakes from a single poll() loop
+// so that it takes about as long to open them all as it does to open one.
+static void
+connect_in_parallel( const std::string& conninfo, int count, int timeout, std::vector<PGconn*>& opened ){
+	std::vector<PGconn*> pending;
+	std::vector<PostgresPollingStatusType> status;
+	for ( int i = 0; i < count; ++i ){
+		PGconn *conn = PQconnectStart( conninfo.c_str() );
+		if ( conn && PQstatus( conn ) != CONNECTION_BAD ){
+			pending.push_back( conn );
+			// as per the libpq docs, behave as if the last poll asked us to wait for the socket to be writable
+			status.push_back( PGRES_POLLING_WRITING );
+		} else {
+			PQfinish( conn );
+		}
+	}
+
+	time_t deadline = time( NULL ) + timeout;
+	while ( pending.size() ){
+		int time_left = deadline - time( NULL );
+		if ( time_left <= 0 ){
+			break;
+		}
+		// the socket may change between polls if more than one host was given, so rebuild the set each time
+		std::vector<pollfd> fds( pending.size() );
+		for ( unsigned int i = 0; i < pending.size(); ++i ){
+			fds[i].fd = PQsocket( pending[i] );
+			fds[i].events = ( status[i] == PGRES_POLLING_READING ? POLLIN : POLLOUT );
+			fds[i].revents = 0;
+		}
+		if ( poll( &fds[0], fds.size(), time_left * 1000 ) < 0 && errno != EINTR ){
+			break;
+		}
+		// walk backwards so erasing doesn't disturb the indexes still to be checked
+		for ( unsigned int i = pending.size(); i-- > 0; ){
+			if ( ! fds[i].revents ){
+				continue;
+			}
+			status[i] = PQconnectPoll( pending[i] );
+			if ( status[i] == PGRES_POLLING_OK ){
+				opened.push_back( pending[i] );
+			} else if ( status[i] == PGRES_POLLING_FAILED ){
+#ifdef DEBUG
+				std::cerr << "Unable to connect to sql database using conection string: "
+					  << "    '" << conninfo << "'\n"
+					  << "Error msg: \n"
+					  << "    " << PQerrorMessage( pending[i] )
+					  << std::endl;
+#endif // DEBUG
+				PQfinish( pending[i] );
+			} else {
+				continue;
+			}
+			pending.erase( pending.begin() + i );
+			status.erase( status.begin() + i );
+		}
+	}
+
+	// anything left over timed out
+	for ( unsigned int i = 0; i < pending.size(); ++i ){
+		PQfinish( pending[i] );
+	}
+}
+
+
+connection_pool::connection_pool( const std::string& name ) :
+	name_( name ),
+	config_( new config( std::string(), rdms::pool_options(), 0 ) ),
+	open_handles_( 0 ),
+	num_waiters_( 0 ),
+	total_waits_( 0 ),
+	total_timeouts_( 0 ),
+	total_wait_ms_( 0 ),
+	max_wait_ms_( 0 ),
+	route_( 0 )
+{
+
+}
+
+connection_pool*
+connection_pool::find( const std::string& name ) {
+	registry_type *pools = registry;
+	if ( ! pools ) {
+		// first use, make sure the default pool is there
+		return name.empty() ? find_or_create( name ) : 0;
+	}
+	registry_type::const_iterator it = pools->find( name );
+	if ( pools->end() == it ) {
+		return name.empty() ? find_or_create( name ) : 0;
+	}
+	return it->second;
+}
+
+connection_pool*
+connection_pool::find_or_create( const std::string& name ) {
+	registry_mutex.lock();
+	registry_type *pools = registry;
+	if ( pools ) {
+		registry_type::const_iterator it = pools->find( name );
+		if ( pools->end() != it ) {
+			registry_mutex.unlock();
+			return it->second;
+		}
+	}
+	registry_type *updated = pools ? new registry_type( *pools ) : new registry_type;
+	if ( ! name.empty() && ! updated->count( std::string() ) ) {
+		(*updated)[ std::string() ] = new connection_pool( std::string() );
+	}
+	connection_pool *ret_val = new connection_pool( name );
+	(*updated)[ name ] = ret_val;
+	__sync_synchronize();
+	registry = updated;
+	registry_mutex.unlock();
+	return ret_val;
+}
+
+std::vector<connection_pool*>
+connection_pool::all() {
+	std::vector<connection_pool*> ret_val;
+	registry_type *pools = registry;
+	if ( pools ) {
+		for ( registry_type::const_iterator it = pools->begin(); pools->end() != it; ++it ) {
+			ret_val.push_back( it->second );
+		}
+	}
+	return ret_val;
+}
+
+bool
+connection_pool::configure( const std::string& conninfo, const rdms::pool_options& options ) {
+	this->shutdown();
+	rdms::pool_options settings = options;
+	if ( settings.spare_connections < 0 ) {
+		settings.spare_connections = 0;
+	}
+	if ( settings.max_connections < 0 ) {
+		settings.max_connections = 0;
+	}
+	if ( settings.max_connections && settings.spare_connections > settings.max_connections ) {
+		settings.spare_connections = settings.max_connections;
+	}
+	if ( settings.min_idle_connections > settings.spare_connections ) {
+		settings.min_idle_connections = settings.spare_connections;
+	}
+	// other threads may be part way through a checkout or checkin on the old configuration, so like the registry's
+	// old copies it is never freed.  Whatever is idle on its list is closed here, and park() closes anything
+	// that is pushed on to it after that
+	config *old = config_;
+	config *updated = new config( conninfo, settings, settings.spare_connections );
+	__sync_synchronize();
+	config_ = updated;
+	this->close_idle( old );
+
+	bool ret_val = this->warm_up();
+	if ( settings.maintenance_interval > 0 ) {
+		maintainer_ = new detail::pool_maintainer( this, settings.maintenance_interval );
+		maintainer_->start();
+	}
+	return ret_val;
+}
+
+void
+connection_pool::shutdown() {
+	if ( maintainer_ ) {
+		maintainer_->stop();
+		maintainer_ = 0;
+	}
+	this->clear();
+}
+
+void
+connection_pool::clear() {
+	this->close_idle( config_ );
+}
+
+// close every connection on cfg's idle list
+void
+connection_pool::close_idle( config *cfg ) {
+	while ( rdms *spare = cfg->idle.pop() ) {
+		delete spare;
+	}
+}
+
+// put h on cfg's idle list, or close it if every spare slot is taken.  configure() may have replaced cfg since the
+// caller looked at it, and already emptied it, in which case nothing would ever take h off of it again.  The push is a
+// full barrier, so either configure() sees h on the old list or we see the new configuration and close h ourselves
+void
+connection_pool::park( rdms *h, config *cfg ) {
+	if ( ! cfg->idle.push( h ) ) {
+		delete h;
+	} else if ( config_ != cfg ) {
+		this->close_idle( cfg );
+	}
+}
+
+// claim the right to open one more connection.  Fails if pool_options::max_connections are already open
+bool
+connection_pool::reserve_slot() {
+	int max_connections = config_->settings.max_connections;
+	if ( ! max_connections ) {
+		__sync_fetch_and_add( &open_handles_, 1 );
+		return true;
+	}
+	for (;;) {
+		int open = open_handles_;
+		if ( open >= max_connections ) {
+			return false;
+		}
+		if ( __sync_bool_compare_and_swap( &open_handles_, open, open + 1 ) ) {
+			return true;
+		}
+	}
+}
+
+// hand h (or a reserved slot, if h is 0) to the longest waiting thread.  Returns false if there was nobody waiting
+bool
+connection_pool::hand_to_waiter( rdms *h ) {
+	if ( ! num_waiters_ ) {
+		return false;
+	}
+	wait_mutex_.lock();
+	if ( waiters_.empty() ) {
+		wait_mutex_.unlock();
+		return false;
+	}
+	detail::pool_waiter *w = waiters_.front();
+	waiters_.pop_front();
+	__sync_fetch_and_sub( &num_waiters_, 1 );
+	wait_mutex_.unlock();
+	w->serve( h );
+	return true;
+}
+
+// give back a slot taken by reserve_slot().  If anyone is waiting, the slot goes straight to them
+void
+connection_pool::closed() {
+	__sync_fetch_and_sub( &open_handles_, 1 );
+	if ( num_waiters_ && this->reserve_slot() && ! this->hand_to_waiter( 0 ) ) {
+		__sync_fetch_and_sub( &open_handles_, 1 );
+	}
+}
+
+// queue up behind any other waiting threads until a connection is handed to us or pool_options::checkout_timeout
+// expires.  Returns the connection, or 0 with open_own set if we were given a slot to open one ourselves, or 0 on timeout.
+rdms*
+connection_pool::wait_for_spare( bool& open_own ) {
+	open_own = false;
+	config *cfg = config_;
+	detail::pool_waiter w;
+	IceUtil::Time start = IceUtil::Time::now();
+
+	wait_mutex_.lock();
+	waiters_.push_back( &w );
+	__sync_fetch_and_add( &num_waiters_, 1 );
+	// a handle may have come back, or a slot come free, between our first look and joining the queue
+	rdms *spare = cfg->idle.pop();
+	if ( spare || this->reserve_slot() ) {
+		waiters_.pop_back();
+		__sync_fetch_and_sub( &num_waiters_, 1 );
+		wait_mutex_.unlock();
+		open_own = ! spare;
+		return spare;
+	}
+	wait_mutex_.unlock();
+
+	bool served = true;
+	w.monitor.lock();
+	while ( ! w.done ) {
+		if ( cfg->settings.checkout_timeout ) {
+			IceUtil::Time left = start + IceUtil::Time::milliSeconds( cfg->settings.checkout_timeout ) - IceUtil::Time::now();
+			if ( left <= IceUtil::Time() ) {
+				served = false;
+				break;
+			}
+			w.monitor.timedWait( left );
+		} else {
+			w.monitor.wait();
+		}
+	}
+	w.monitor.unlock();
+
+	wait_mutex_.lock();
+	if ( ! served ) {
+		// give up our place in line, unless someone has already taken us off it and is on their way to serve us
+		std::deque<detail::pool_waiter*>::iterator it = std::find( waiters_.begin(), waiters_.end(), &w );
+		if ( waiters_.end() != it ) {
+			waiters_.erase( it );
+			__sync_fetch_and_sub( &num_waiters_, 1 );
+			++total_timeouts_;
+		} else {
+			served = true;
+		}
+	}
+	double waited = ( IceUtil::Time::now() - start ).toMicroSeconds() / 1000.0;
+	++total_waits_;
+	total_wait_ms_ += waited;
+	if ( waited > max_wait_ms_ ) {
+		max_wait_ms_ = waited;
+	}
+	wait_mutex_.unlock();
+
+	if ( ! served ) {
+		return 0;
+	}
+	w.monitor.lock();
+	while ( ! w.done ) {
+		w.monitor.wait();
+	}
+	w.monitor.unlock();
+	open_own = ! w.handed;
+	return w.handed;
+}
+
+rdms*
+connection_pool::checkout() {
+	rdms* ret_val = config_->idle.pop();
+	if ( ! ret_val ) {
+		// only once max_connections are open is there anything to wait for.  That includes the connections check_idle()
+		// has out to look at, which are handed straight to whoever is waiting as they pass
+		bool open_own = this->reserve_slot();
+		if ( ! open_own ) {
+			ret_val = this->wait_for_spare( open_own );
+		}
+		if ( open_own ) {
+			return new rdms( this );
+		} else if ( ! ret_val ) {
+			// timed out
+			return 0;
+		}
+	}
+	// the maintenance thread keeps the idle handles in good shape.  Without it, do a ping to make sure the handle is still good
+	if ( ! maintainer_ ) {
+		ret_val->ping();
+	}
+	return ret_val;
+}
+
+rdms*
+connection_pool::try_checkout() {
+	rdms *ret_val = config_->idle.pop();
+	if ( ! ret_val ) {
+		return this->reserve_slot() ? new rdms( this ) : 0;
+	}
+	if ( ! maintainer_ ) {
+		ret_val->ping();
+	}
+	return ret_val;
+}
+
+void
+connection_pool::checkin( rdms *h ) {
+	// anyone already waiting gets served first
+	if ( this->hand_to_waiter( h ) ) {
+		return;
+	}
+	// if all the spare slots are taken, it's surplus to requirements
+	config *cfg = config_;
+	this->park( h, cfg );
+	// a thread may have joined the queue between our look and the push.  If so make sure it isn't left
+	// waiting on a handle that is sitting idle
+	if ( num_waiters_ ) {
+		rdms *spare = cfg->idle.pop();
+		if ( spare && ! this->hand_to_waiter( spare ) ) {
+			this->park( spare, cfg );
+		}
+	}
+}
+
+bool
+connection_pool::warm_up() {
+	config *cfg = config_;
+	return this->open_spares( cfg->settings.min_idle_connections - static_cast<int>( cfg->idle.size() ) );
+}
+
+bool
+connection_pool::open_spares( int wanted ) {
+	if ( wanted <= 0 ) {
+		return true;
+	}
+	config *cfg = config_;
+	int reserved = 0;
+	while ( reserved < wanted && this->reserve_slot() ) {
+		++reserved;
+	}
+	std::vector<PGconn*> opened;
+	connect_in_parallel( cfg->conninfo, reserved, cfg->settings.connect_timeout, opened );
+	for ( int i = opened.size(); i < reserved; ++i ){
+		this->closed();
+	}
+	for ( unsigned int i = 0; i < opened.size(); ++i ){
+		rdms *spare = new rdms( this, opened[i] );
+		if ( ! this->hand_to_waiter( spare ) ) {
+			this->park( spare, cfg );
+		}
+	}
+	return static_cast<int>( opened.size() ) == wanted;
+}
+
+void
+connection_pool::check_idle() {
+	time_t now = time( NULL );
+	config *cfg = config_;
+	const rdms::pool_options& settings = cfg->settings;
+
+	// connections are taken out of the pool and looked at one at a time, and each that passes goes straight to
+	// whoever is waiting.  checkout() never waits on a look that may stall on a dead host unless max_connections are
+	// open, it opens a connection of its own instead.  The pool hands back whatever went in last, so those that pass
+	// with nobody waiting are held on to until the rest have been looked at.  They come off most recently used first,
+	// so it's the staler ones that lose out if there are more than pool_options::min_idle_connections
+	std::vector<rdms*> passed;
+	int replace = 0;
+	int kept = 0;
+	for ( unsigned int i = cfg->idle.size(); i > 0; --i ) {
+		rdms *spare = cfg->idle.pop();
+		if ( ! spare ) {
+			break;
+		}
+		if ( settings.max_lifetime && now - spare->created_ >= settings.max_lifetime ) {
+			// recycled, the pool stays the same size
+			++replace;
+		} else if ( ! spare->alive() ) {
+			++replace;
+		} else if ( settings.idle_timeout && kept >= settings.min_idle_connections
+			    && now - spare->last_used_ >= settings.idle_timeout ) {
+			// surplus to requirements
+		} else {
+			++kept;
+			if ( ! this->hand_to_waiter( spare ) ) {
+				passed.push_back( spare );
+			}
+			continue;
+		}
+		delete spare;
+	}
+
+	for ( unsigned int i = 0; i < passed.size(); ++i ) {
+		if ( ! this->hand_to_waiter( passed[i] ) ) {
+			this->park( passed[i], cfg );
+		}
+	}
+	// anyone left waiting while slots are free may open their own, as checkout() would have let them
+	while ( num_waiters_ && this->reserve_slot() ) {
+		if ( ! this->hand_to_waiter( 0 ) ) {
+			__sync_fetch_and_sub( &open_handles_, 1 );
+			break;
+		}
+	}
+
+	// the replacements are opened all together, as is anything else needed to get back up to min_idle_connections
+	this->open_spares( replace );
+	this->warm_up();
+}
+
+rdms::pool_statistics
+connection_pool::statistics() {
+	rdms::pool_statistics ret_val;
+	wait_mutex_.lock();
+	ret_val.waits = total_waits_;
+	ret_val.timeouts = total_timeouts_;
+	ret_val.total_wait_ms = total_wait_ms_;
+	ret_val.max_wait_ms = max_wait_ms_;
+	ret_val.waiting = waiters_.size();
+	wait_mutex_.unlock();
+	ret_val.open_connections = open_handles_;
+	ret_val.idle_connections = config_->idle.size();
+	return ret_val;
+}
+
+void
+connection_pool::route_reads( const std::vector<connection_pool*>& replicas, rdms::balance_policy policy ) {
+	read_route *route = 0;
+	if ( replicas.size() ) {
+		route = new read_route;
+		route->replicas = replicas;
+		route->policy = policy;
+		route->next = 0;
+	}
+	__sync_synchronize();
+	// like the registry, the old route is never freed as a reader may still be using it
+	route_ = route;
+}
+
+connection_pool*
+connection_pool::read_pool() {
+	read_route *route = route_;
+	if ( ! route ) {
+		return 0;
+	}
+	if ( rdms::least_outstanding == route->policy ) {
+		// the replica with the fewest connections checked out
+		connection_pool *ret_val = 0;
+		int fewest = 0;
+		for ( unsigned int i = 0; i < route->replicas.size(); ++i ) {
+			connection_pool *replica = route->replicas[i];
+			int outstanding = replica->open_handles_ - static_cast<int>( replica->config_->idle.size() );
+			if ( ! ret_val || outstanding < fewest ) {
+				ret_val = replica;
+				fewest = outstanding;
+			}
+		}
+		return ret_val;
+	}
+	return route->replicas[ __sync_fetch_and_add( &route->next, 1 ) % route->replicas.size() ];
+}
+
+const std::string&
+connection_pool::conninfo() const {
+	return config_->conninfo;
+}
+
+const rdms::pool_options&
+connection_pool::options() const {
+	return config_->settings;
+}
+
+bool
+connection_pool::maintained() const {
+	return maintainer_;
+}
+
+const std::string&
+connection_pool::name() const {
+	return name_;
+}
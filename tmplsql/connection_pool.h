@@ -0,0 +1,162 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_CONNECTION_POOL_H_
+#define _TMPLSQL_CONNECTION_POOL_H_
+
+#include "tmplsql/rdms.h"
+#include "tmplsql/free_list.h"
+
+#include <IceUtil/Mutex.h>
+#include <IceUtil/Handle.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+
+namespace tmplsql {
+
+	namespace detail {
+		struct pool_waiter;
+		class pool_maintainer;
+	}
+
+	//! a named set of connections to a single server, as set up by rdms::initialize.
+	/*!
+	  This is the machinery behind rdms::handle() and rdms::release(), it isn't meant to be used directly.
+
+	  Pools are never destroyed once they have been created; initializing one again just reconfigures it.
+	  That lets handles, the registry of pools and the read routes all hold plain pointers to them, and
+	  lets find() be called on every checkout without taking a lock.
+	*/
+	class connection_pool {
+	public:
+		//! find the pool called name.  The default pool is called "" and always exists.
+		/*! @return the pool, or 0 if there is no pool by that name */
+		static connection_pool* find( const std::string& name );
+
+		//! find the pool called name, creating an unconfigured one if needed
+		static connection_pool* find_or_create( const std::string& name );
+
+		//! every pool there is
+		static std::vector<connection_pool*> all();
+
+		//! (re)configure the pool, closing any idle connections it has and opening
+		//! rdms::pool_options::min_idle_connections new ones.
+		bool configure( const std::string& conninfo, const rdms::pool_options& options );
+
+		//! hand out an idle connection, opening a new one or waiting in line for one as the pool settings dictate.
+		/*! @return 0 if no connection came free before rdms::pool_options::checkout_timeout */
+		rdms* checkout();
+
+		//! hand out an idle connection, or open a new one if that can be done without going over max_connections.
+		/*! Never waits, for use by something that already holds a connection from the pool and only wants more if
+		  they're to be had.  @return 0 if there was no idle connection and no room to open one */
+		rdms* try_checkout();
+
+		//! take back a connection that has been cleaned up by rdms::release()
+		void checkin( rdms *h );
+
+		//! called as each connection belonging to the pool is destroyed
+		void closed();
+
+		//! open enough connections to bring the pool up to rdms::pool_options::min_idle_connections
+		bool warm_up();
+
+		//! see rdms::check_idle()
+		void check_idle();
+
+		//! close all idle connections
+		void clear();
+
+		//! stop the maintenance thread and close all idle connections
+		void shutdown();
+
+		//! see rdms::statistics()
+		rdms::pool_statistics statistics();
+
+		//! send reads made through this pool's handles to replicas.  An empty list turns routing off.
+		void route_reads( const std::vector<connection_pool*>& replicas, rdms::balance_policy policy );
+
+		//! pick the replica pool the next read should go to, or 0 if reads aren't routed
+		connection_pool* read_pool();
+
+		//! connection string for the server
+		const std::string& conninfo() const;
+
+		//! settings the pool was configured with
+		const rdms::pool_options& options() const;
+
+		//! is a maintenance thread looking after the idle connections
+		bool maintained() const;
+
+		//! name the pool was registered under
+		const std::string& name() const;
+	private:
+		connection_pool( const std::string& name );
+		connection_pool( const connection_pool& );
+		connection_pool& operator=( const connection_pool& );
+
+		bool reserve_slot();
+		bool hand_to_waiter( rdms *h );
+		rdms* wait_for_spare( bool& open_own );
+		bool open_spares( int wanted );
+
+		struct config;
+		void park( rdms *h, config *cfg );
+		void close_idle( config *cfg );
+
+		// the replicas reads are routed to.  Never changed once published, replaced wholesale by route_reads()
+		struct read_route {
+			std::vector<connection_pool*> replicas;
+			rdms::balance_policy policy;
+			volatile unsigned int next;
+		};
+
+		// everything configure() sets, published as one so that no thread sees the settings of one configuration
+		// with the connection string or idle list of another.  Never changed once published, replaced wholesale
+		// by configure(), which never frees the old one
+		struct config {
+			config( const std::string& c, const rdms::pool_options& o, unsigned int capacity ) :
+				conninfo( c ),
+				settings( o ),
+				idle( capacity )
+			{ }
+			const std::string conninfo;
+			const rdms::pool_options settings;
+			// idle connections waiting to be handed out.  Checkout and release never take a lock,
+			// see detail::sharded_free_list
+			detail::sharded_free_list<rdms> idle;
+		};
+
+		std::string name_;
+		config * volatile config_;
+
+		// number of rdms instances in existence, checked out or idle.  Every one is created against a slot
+		// reserved by reserve_slot(), and gives its slot back through closed()
+		volatile int open_handles_;
+
+		// threads waiting for a connection, served oldest first.  num_waiters_ mirrors waiters_.size()
+		// so checkin() can tell without taking the lock whether anyone needs serving
+		IceUtil::Mutex wait_mutex_;
+		std::deque<detail::pool_waiter*> waiters_;
+		volatile int num_waiters_;
+
+		// wait statistics, guarded by wait_mutex_
+		unsigned long total_waits_;
+		unsigned long total_timeouts_;
+		double total_wait_ms_;
+		double max_wait_ms_;
+
+		IceUtil::Handle<detail::pool_maintainer> maintainer_;
+
+		read_route * volatile route_;
+	};
+
+}
+
+#endif // _TMPLSQL_CONNECTION_POOL_H_
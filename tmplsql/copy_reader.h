@@ -0,0 +1,140 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_COPY_READER_H_
+#define _TMPLSQL_COPY_READER_H_
+
+#include "tmplsql/handle.h"
+#include "tmplsql/binary.h"
+#include <boost/tuple/tuple.hpp>
+
+namespace tmplsql {
+
+	namespace detail {
+
+		//! end of the columns
+		inline void decode_copy_columns( const char*&, const char*, const boost::tuples::null_type& ) { }
+
+		//! read each column of a binary COPY row from p in to row.  Nulls, and any columns the row is short of, come out as T()
+		template<class H, class T>
+		inline void decode_copy_columns( const char*& p, const char *end, boost::tuples::cons<H,T>& row ) {
+			int length = -1;
+			if ( end - p >= 4 ) {
+				length = static_cast<int>( read_uint32( p ) );
+				p += 4;
+			}
+			if ( length < 0 || end - p < length ) {
+				row.get_head() = H();
+			} else {
+				row.get_head() = binary_value<H>::decode( p, length, copy_column_type<H>( length ) );
+				p += length;
+			}
+			decode_copy_columns( p, end, row.get_tail() );
+		}
+
+	} // namespace detail
+
+	//! reads the rows of a query with binary COPY TO STDOUT, decoding each one straight in to a tuple of plain types.
+	/*!
+	  Rows are decoded from libpq's own buffer, so numbers never pass through text.  As binary COPY doesn't say what
+	  type its columns are, the query's columns must be of the types copy_writer would send T0 ... T9 as, casting in
+	  the query if need be.  See rdms::copy_out for what happens to the handle.
+	  <pre><code>
+	  tmplsql::handle sql;
+	  *sql << "select id, name, ratio::float8 from users";
+	  tmplsql::copy_reader<int,std::string,double> r( sql );
+	  tmplsql::copy_reader<int,std::string,double>::row_type row;
+	  while ( r.next( row ) ) {
+	          std::cout << row.get<0>() << " " << row.get<1>() << std::endl;
+	  }
+	  </code></pre>
+	*/
+	template <  class T0,
+		    class T1 = boost::tuples::null_type, class T2 = boost::tuples::null_type, class T3 = boost::tuples::null_type,
+		    class T4 = boost::tuples::null_type, class T5 = boost::tuples::null_type, class T6 = boost::tuples::null_type,
+		    class T7 = boost::tuples::null_type, class T8 = boost::tuples::null_type, class T9 = boost::tuples::null_type >
+	class copy_reader {
+	public:
+		//! a row as read
+		typedef boost::tuple<T0,T1, T2, T3, T4, T5, T6, T7, T8, T9 > row_type;
+
+		//! number of columns in each row
+		static const int length =  boost::tuples::length< row_type >::value;
+
+		//! ctor, starts the copy of the query held in h
+		copy_reader( const handle& h ) :
+			handle_( h ),
+			copy_( 0 ),
+			header_( false )
+		{
+			if ( handle_.valid() ) {
+				copy_ = new rdms::copy_out( *handle_, rdms::binary_results );
+			}
+		}
+
+		//! cancels the query if its rows haven't all been read
+		~copy_reader() {
+			delete copy_;
+		}
+
+		//! read the next row in to row
+		/*! @return false once there are no more rows, or the copy failed */
+		bool next( row_type& row ) {
+			const char *data;
+			int size;
+			while ( copy_ && copy_->next( data, size ) ) {
+				const char *end = data + size;
+				if ( ! header_ ) {
+					// signature and flags, then the length of the header extension and the extension itself
+					if ( size < 19 || detail::read_uint32( data + 15 ) > static_cast<unsigned int>( size - 19 ) ) {
+						continue;
+					}
+					data += 19 + detail::read_uint32( data + 15 );
+					header_ = true;
+				}
+				if ( end - data < 2 ) {
+					continue;
+				}
+				short columns = static_cast<short>( detail::read_uint16( data ) );
+				data += 2;
+				if ( columns < 0 ) {
+					// the trailer
+					continue;
+				}
+				detail::decode_copy_columns( data, end, row );
+				return true;
+			}
+			return false;
+		}
+
+		//! number of rows copied, once they have all been read
+		unsigned long rows() const {
+			return copy_ ? copy_->rows() : 0;
+		}
+
+		//! has everything gone well so far
+		bool ok() const {
+			return copy_ && copy_->ok();
+		}
+
+		//! return the tmplsql::handle that copy_reader is using
+		handle&
+		get_handle(){
+			return handle_;
+		}
+	private:
+		copy_reader( const copy_reader& );
+		copy_reader& operator=( const copy_reader& );
+
+		handle handle_;
+		rdms::copy_out *copy_;
+		bool header_;
+	};
+
+}
+
+#endif // _TMPLSQL_COPY_READER_H_
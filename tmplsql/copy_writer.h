@@ -0,0 +1,239 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_COPY_WRITER_H_
+#define _TMPLSQL_COPY_WRITER_H_
+
+#include "tmplsql/handle.h"
+#include "tmplsql/binary.h"
+#include "tmplsql/fields.h"
+#include "tmplsql/param.h"
+#include <boost/tuple/tuple.hpp>
+#include <boost/type_traits.hpp>
+#include <string>
+#include <stdio.h>
+
+namespace tmplsql {
+
+	namespace detail {
+
+		//! the value to write for a column of type T.  A field<T> is written as the value it holds
+		template<typename T, bool IsField = boost::is_base_and_derived<base_field, T>::value >
+		struct column_value {
+			typedef const T& type;
+			static type get( const T& value ) {
+				return value;
+			}
+		};
+
+		//! fields
+		template<typename T>
+		struct column_value<T, true> {
+			typedef typename T::value_type type;
+			static type get( const T& value ) {
+				return value.get();
+			}
+		};
+
+		//! append length bytes from p to out, escaped for COPY's text format
+		inline void copy_escape( std::string& out, const char *p, size_t length ) {
+			for ( const char *end = p + length; p != end; ++p ) {
+				switch ( *p ) {
+				case '\\': out += "\\\\"; break;
+				case '\t': out += "\\t"; break;
+				case '\n': out += "\\n"; break;
+				case '\r': out += "\\r"; break;
+				default: out += *p;
+				}
+			}
+		}
+
+		//! conversion of T to COPY's text format, chosen by what sort of type T is
+		template<typename T, bool Integral = boost::is_integral<T>::value, bool Float = boost::is_float<T>::value >
+		struct copy_text {
+			static void encode( std::string& out, const T& value ) {
+				std::string text = param_text( value );
+				copy_escape( out, text.data(), text.size() );
+			}
+		};
+
+		//! integers, written out digit by digit as there's nothing in them to escape
+		template<typename T>
+		struct copy_text<T, true, false> {
+			static void encode( std::string& out, T value ) {
+				char digits[ 24 ];
+				char *p = digits + sizeof( digits );
+				bool negative = value < 0;
+				do {
+					int digit = static_cast<int>( value % 10 );
+					*--p = static_cast<char>( '0' + ( negative ? -digit : digit ) );
+					value /= 10;
+				} while ( value );
+				if ( negative ) {
+					*--p = '-';
+				}
+				out.append( p, digits + sizeof( digits ) - p );
+			}
+		};
+
+		//! bool
+		template<>
+		struct copy_text<bool, true, false> {
+			static void encode( std::string& out, bool value ) {
+				out += value ? 't' : 'f';
+			}
+		};
+
+		//! floating point, with enough digits to make the round trip intact
+		template<typename T>
+		struct copy_text<T, false, true> {
+			static void encode( std::string& out, T value ) {
+				char text[ 32 ];
+				out.append( text, snprintf( text, sizeof( text ), "%.17g", static_cast<double>( value ) ) );
+			}
+		};
+
+		//! std::string
+		template<>
+		struct copy_text<std::string, false, false> {
+			static void encode( std::string& out, const std::string& value ) {
+				copy_escape( out, value.data(), value.size() );
+			}
+		};
+
+		//! append value to out in COPY's text format
+		template<typename T>
+		inline void encode_text( std::string& out, const T& value ) {
+			copy_text<T>::encode( out, value );
+		}
+
+		//! const char*, where a null pointer is written as a null
+		inline void encode_text( std::string& out, const char *value ) {
+			if ( value ) {
+				copy_escape( out, value, strlen( value ) );
+			} else {
+				out += "\\N";
+			}
+		}
+
+		//! end of the columns
+		inline void encode_columns( std::string&, const boost::tuples::null_type&, bool, bool ) { }
+
+		//! append each column of row to out, in binary or COPY's text format
+		template<class H, class T>
+		inline void encode_columns( std::string& out, const boost::tuples::cons<H,T>& row, bool binary, bool first ) {
+			if ( binary ) {
+				encode( out, column_value<H>::get( row.get_head() ) );
+			} else {
+				if ( ! first ) {
+					out += '\t';
+				}
+				encode_text( out, column_value<H>::get( row.get_head() ) );
+			}
+			encode_columns( out, row.get_tail(), binary, false );
+		}
+
+	} // namespace detail
+
+	//! bulk loads typed rows in to a table, with COPY FROM STDIN.
+	/*!
+	  The template arguments are the types of the columns, given the same way as for recordset: either plain types or
+	  field<T> classes, whose values are written.  Rows are collected in a buffer and sent when it fills, but none are
+	  loaded until finish() is called; the load is abandoned if the copy_writer is destroyed before then.
+	  With rdms::binary_results the rows are sent in COPY's binary format, which saves the server parsing them, but which
+	  needs the column types to match exactly, see detail::binary_encoder.
+	  <pre><code>
+	  tmplsql::handle sql;
+	  tmplsql::copy_writer<int,std::string> w( sql, "users ( id, name )" );
+	  w.write( tmplsql::copy_writer<int,std::string>::row_type( 1, "nathan" ) );
+	  w.write( boost::make_tuple( 2, "bob" ) );
+	  w.finish();
+	  </code></pre>
+	*/
+	template <  class T0,
+		    class T1 = boost::tuples::null_type, class T2 = boost::tuples::null_type, class T3 = boost::tuples::null_type,
+		    class T4 = boost::tuples::null_type, class T5 = boost::tuples::null_type, class T6 = boost::tuples::null_type,
+		    class T7 = boost::tuples::null_type, class T8 = boost::tuples::null_type, class T9 = boost::tuples::null_type >
+	class copy_writer {
+	public:
+		//! a row to be written
+		typedef boost::tuple<T0,T1, T2, T3, T4, T5, T6, T7, T8, T9 > row_type;
+
+		//! number of columns in each row
+		static const int length =  boost::tuples::length< row_type >::value;
+
+		//! ctor, starts the copy
+		/*! @param h handle to load through
+		  @param table name of the table, optionally followed by a parenthesized list of columns
+		  @param format rdms::text_results or rdms::binary_results
+		  @param buffer_size number of bytes to collect before sending them */
+		copy_writer( const handle& h, const std::string& table, rdms::result_format format = rdms::text_results,
+			     int buffer_size = 262144 ) :
+			handle_( h ),
+			copy_( 0 ),
+			binary_( rdms::binary_results == format )
+		{
+			if ( handle_.valid() ) {
+				copy_ = new rdms::copy_in( *handle_, table, format, buffer_size );
+			}
+		}
+
+		//! abandons the load if finish() hasn't been called
+		~copy_writer() {
+			delete copy_;
+		}
+
+		//! add row to the load
+		/*! @return false if the copy has failed */
+		bool write( const row_type& row ) {
+			if ( ! this->ok() ) {
+				return false;
+			}
+			std::string& out = copy_->buffer();
+			if ( binary_ ) {
+				detail::write_uint16( out, length );
+			}
+			detail::encode_columns( out, row, binary_, true );
+			if ( ! binary_ ) {
+				out += '\n';
+			}
+			return copy_->row_done();
+		}
+
+		//! send the last of the rows and end the copy
+		/*! @return true if every row was loaded */
+		bool finish() {
+			return copy_ && copy_->finish();
+		}
+
+		//! number of rows loaded, once finish() has succeeded
+		unsigned long rows() const {
+			return copy_ ? copy_->rows() : 0;
+		}
+
+		//! has everything gone well so far
+		bool ok() const {
+			return copy_ && copy_->ok();
+		}
+
+		//! return the tmplsql::handle that copy_writer is using
+		handle&
+		get_handle(){
+			return handle_;
+		}
+	private:
+		copy_writer( const copy_writer& );
+		copy_writer& operator=( const copy_writer& );
+
+		handle handle_;
+		rdms::copy_in *copy_;
+		bool binary_;
+	};
+
+}
+
+#endif // _TMPLSQL_COPY_WRITER_H_
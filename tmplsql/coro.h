@@ -0,0 +1,282 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_CORO_H_
+#define _TMPLSQL_CORO_H_
+
+#include "tmplsql/async.h"
+
+// the rest of the library sticks to C++98; this is only of use to C++20 callers
+#if __cplusplus >= 202002L && defined( __cpp_impl_coroutine )
+
+#include <coroutine>
+#include <string>
+#include <deque>
+
+namespace tmplsql {
+
+	//! carries on the coroutines waiting on queries on threads of the caller's choosing.
+	/*!
+	  Without one, a coroutine that co_awaits a query carries on on the engine's own thread, see async_callback.
+	  Given one, the engine just hands the coroutine to post() once the query has completed.
+	*/
+	class co_scheduler {
+	public:
+		//! carry on waiting on some other thread than this one.  Called on the engine's thread, so must be quick
+		virtual void post( std::coroutine_handle<> waiting ) = 0;
+		//! dtor
+		virtual ~co_scheduler() { }
+	};
+
+	//! a co_scheduler whose coroutines are carried on by whichever thread drains it.
+	/*! <pre><code>
+	  tmplsql::co_queue ready;
+	  serve_requests( engine, ready );	// a coroutine that passes ready to each co_await
+	  for (;;) {
+	  	ready.run_one();
+	  }
+	  </code></pre>
+	*/
+	class co_queue : public co_scheduler {
+	public:
+		void post( std::coroutine_handle<> waiting ) {
+			monitor_.lock();
+			ready_.push_back( waiting );
+			monitor_.notify();
+			monitor_.unlock();
+		}
+
+		//! wait for a coroutine to be ready, then carry it on until its next co_await
+		void run_one() {
+			monitor_.lock();
+			while ( ready_.empty() ) {
+				monitor_.wait();
+			}
+			std::coroutine_handle<> waiting = ready_.front();
+			ready_.pop_front();
+			monitor_.unlock();
+			waiting.resume();
+		}
+
+		//! carry on every coroutine that's ready, without waiting on those that aren't
+		/*! @return the number carried on */
+		int run_ready() {
+			int ret_val = 0;
+			for (;;) {
+				monitor_.lock();
+				if ( ready_.empty() ) {
+					monitor_.unlock();
+					return ret_val;
+				}
+				std::coroutine_handle<> waiting = ready_.front();
+				ready_.pop_front();
+				monitor_.unlock();
+				waiting.resume();
+				++ret_val;
+			}
+		}
+	private:
+		IceUtil::Monitor<IceUtil::Mutex> monitor_;
+		std::deque< std::coroutine_handle<> > ready_;
+	};
+
+	namespace detail {
+
+		// carries on the coroutine waiting on a query once the engine has completed it, here on the engine's
+		// thread or by handing it to scheduler
+		class resume_callback : public async_callback {
+		public:
+			resume_callback( std::coroutine_handle<> waiting, co_scheduler *scheduler ) :
+				waiting_( waiting ),
+				scheduler_( scheduler )
+			{ }
+
+			void completed( const async_result_ptr& result ) {
+				result_ = result;
+				if ( scheduler_ ) {
+					scheduler_->post( waiting_ );
+				} else {
+					waiting_.resume();
+				}
+			}
+
+			async_result_ptr result_;
+		private:
+			std::coroutine_handle<> waiting_;
+			co_scheduler *scheduler_;
+		};
+
+		//! what co_await gives for a query run by an async_engine.  Finish turns the async_result in to it.
+		/*!
+		  The statement is taken from the handle, and submitted, when the awaiter is co_awaited.  Once the query
+		  has completed the coroutine is handed to scheduler, or if there isn't one carries on on the engine's thread.
+		*/
+		template<typename Finish>
+		class query_awaiter {
+		public:
+			query_awaiter( async_engine& engine, co_scheduler *scheduler, rdms& sql, rdms::result_format format,
+				       Finish finish ) :
+				engine_( engine ),
+				scheduler_( scheduler ),
+				sql_( sql ),
+				format_( format ),
+				finish_( finish ),
+				resume_( 0 )
+			{ }
+
+			bool await_ready() const noexcept {
+				return false;
+			}
+
+			void await_suspend( std::coroutine_handle<> waiting ) {
+				resume_ = new resume_callback( waiting, scheduler_ );
+				callback_ = resume_;
+				// the query may complete, and the coroutine carry on and destroy us, before submit() returns,
+				// so nothing here may be touched after it
+				async_callback_ptr callback( callback_ );
+				engine_.submit( sql_, format_, callback );
+			}
+
+			typename Finish::result_type await_resume() {
+				return finish_( resume_->result_ );
+			}
+		private:
+			async_engine& engine_;
+			co_scheduler *scheduler_;
+			rdms& sql_;
+			rdms::result_format format_;
+			Finish finish_;
+			resume_callback *resume_;
+			async_callback_ptr callback_;
+		};
+
+		// the rows
+		struct finish_select {
+			typedef rdms::result_set result_type;
+			result_type operator()( const async_result_ptr& result ) const {
+				return result->wait();
+			}
+		};
+
+		// whether the statement succeeded
+		struct finish_exec {
+			typedef bool result_type;
+			result_type operator()( const async_result_ptr& result ) const {
+				return result->ok();
+			}
+		};
+
+		// the first column of the first row, or an empty string
+		struct finish_single_value {
+			typedef std::string result_type;
+			result_type operator()( const async_result_ptr& result ) const {
+				rdms::result_set rows = result->wait();
+				if ( ! result->ok() || ! rows.size() || rows.num_fields() < 1 ) {
+					return std::string();
+				}
+				return rows.begin()[0];
+			}
+		};
+
+		// hands the rows to the query, and gives its first row
+		template<typename Query>
+		struct finish_begin {
+			typedef typename Query::iterator result_type;
+			Query *query;
+			result_type operator()( const async_result_ptr& result ) const {
+				query->use_rows( result->wait() );
+				return query->begin();
+			}
+		};
+
+	} // namespace detail
+
+	//! co_await the rows of the statement built up in sql, as rdms::select() would return them.
+	/*!
+	  The statement and any bound values are handed to engine, and the coroutine suspended until the rows are in,
+	  so no thread waits on the server.  The coroutine is then handed to scheduler to carry on.  The statement runs on
+	  one of the engine's connections, not sql's, so it is outside any transaction sql is in.
+	  <pre><code>
+	  tmplsql::handle sql;
+	  *sql << "select name from users where id = " << tmplsql::param( id );
+	  tmplsql::rdms::result_set rows = co_await tmplsql::co_select( engine, ready, *sql );
+	  </code></pre>
+	*/
+	inline detail::query_awaiter<detail::finish_select>
+	co_select( async_engine& engine, co_scheduler& scheduler, rdms& sql, rdms::result_format format = rdms::text_results ) {
+		return detail::query_awaiter<detail::finish_select>( engine, &scheduler, sql, format, detail::finish_select() );
+	}
+
+	//! co_await the rows of the statement built up in sql, carrying on on the engine's thread.
+	/*!
+	  Everything the coroutine does up to its next co_await then holds up every other query the engine has in flight,
+	  and anything in it that waits on the engine, such as a handle's blocking calls when the engine has the pool's
+	  last connections, async_result::wait(), or stopping or destroying the engine, may never return.  Only of use
+	  where the coroutine just hands what it got on to another thread, otherwise give it a co_scheduler.
+	*/
+	inline detail::query_awaiter<detail::finish_select>
+	co_select( async_engine& engine, rdms& sql, rdms::result_format format = rdms::text_results ) {
+		return detail::query_awaiter<detail::finish_select>( engine, 0, sql, format, detail::finish_select() );
+	}
+
+	//! co_await the statement built up in sql being run, as rdms::exec() would.  Gives true if it succeeded.  See co_select()
+	inline detail::query_awaiter<detail::finish_exec>
+	co_exec( async_engine& engine, co_scheduler& scheduler, rdms& sql ) {
+		return detail::query_awaiter<detail::finish_exec>( engine, &scheduler, sql, rdms::text_results, detail::finish_exec() );
+	}
+
+	//! as co_exec() above, carrying on on the engine's thread.  See co_select() for what that means
+	inline detail::query_awaiter<detail::finish_exec>
+	co_exec( async_engine& engine, rdms& sql ) {
+		return detail::query_awaiter<detail::finish_exec>( engine, 0, sql, rdms::text_results, detail::finish_exec() );
+	}
+
+	//! co_await the single value the statement built up in sql selects, as rdms::single_value() would.  See co_select()
+	inline detail::query_awaiter<detail::finish_single_value>
+	co_single_value( async_engine& engine, co_scheduler& scheduler, rdms& sql ) {
+		return detail::query_awaiter<detail::finish_single_value>( engine, &scheduler, sql, rdms::text_results,
+									   detail::finish_single_value() );
+	}
+
+	//! as co_single_value() above, carrying on on the engine's thread.  See co_select() for what that means
+	inline detail::query_awaiter<detail::finish_single_value>
+	co_single_value( async_engine& engine, rdms& sql ) {
+		return detail::query_awaiter<detail::finish_single_value>( engine, 0, sql, rdms::text_results,
+									   detail::finish_single_value() );
+	}
+
+	//! co_await the first row of q, as q.begin() would give it.  See co_select()
+	/*! <pre><code>
+	  for ( my_query::iterator it = co_await tmplsql::co_begin( engine, ready, q ); it != q.end(); ++it ) {
+	  ...
+	  }
+	  </code></pre>
+	*/
+	template<typename Query>
+	inline detail::query_awaiter< detail::finish_begin<Query> >
+	co_begin( async_engine& engine, co_scheduler& scheduler, Query& q ) {
+		detail::finish_begin<Query> finish;
+		finish.query = &q;
+		return detail::query_awaiter< detail::finish_begin<Query> >( engine, &scheduler, *q.select_statement(),
+									     rdms::text_results, finish );
+	}
+
+	//! as co_begin() above, carrying on on the engine's thread.  See co_select() for what that means
+	template<typename Query>
+	inline detail::query_awaiter< detail::finish_begin<Query> >
+	co_begin( async_engine& engine, Query& q ) {
+		detail::finish_begin<Query> finish;
+		finish.query = &q;
+		return detail::query_awaiter< detail::finish_begin<Query> >( engine, 0, *q.select_statement(),
+									     rdms::text_results, finish );
+	}
+
+}
+
+#endif // __cplusplus >= 202002L
+
+#endif // _TMPLSQL_CORO_H_
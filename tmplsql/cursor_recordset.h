@@ -0,0 +1,99 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_CURSOR_RECORDSET_H_
+#define _TMPLSQL_CURSOR_RECORDSET_H_
+
+#include "tmplsql/stream_recordset.h"
+
+namespace tmplsql {
+
+	//! a recordset that reads its rows through a server side cursor, fetch_size rows at a time.
+	/*!
+	  Used just like recordset, but for walking over whole tables: at most two batches of rows are held at once, the one
+	  being iterated over and the one after it, which is fetched while the current one is being worked on.
+	  See rdms::cursor for what happens to the handle's transaction.
+
+	  Like stream_recordset it can be iterated over just once, and nothing else may be done with the handle until the
+	  cursor_recordset is destroyed.
+	  <pre><code>
+	  tmplsql::handle sql;
+	  *sql << "select id, name from users";
+	  tmplsql::cursor_recordset<int,std::string> rs( sql, 5000 );
+	  for ( tmplsql::cursor_recordset<int,std::string>::iterator it = rs.begin(); it != rs.end(); ++it ) {
+	          std::cout << it.get<0>() << " " << it.get<1>() << std::endl;
+	  }
+	  </code></pre>
+	*/
+	template <  class T0,
+		    class T1 = boost::tuples::null_type, class T2 = boost::tuples::null_type, class T3 = boost::tuples::null_type,
+		    class T4 = boost::tuples::null_type, class T5 = boost::tuples::null_type, class T6 = boost::tuples::null_type,
+		    class T7 = boost::tuples::null_type, class T8 = boost::tuples::null_type, class T9 = boost::tuples::null_type >
+	class cursor_recordset {
+		typedef boost::tuple<T0,T1, T2, T3, T4, T5, T6, T7, T8, T9 > tuple;
+	public:
+		//! number of types we were passed
+		static const int length =  boost::tuples::length< tuple >::value;
+
+		//! iterator over the rows, see detail::chunk_iterator
+		typedef detail::chunk_iterator< rdms::cursor, tuple > iterator;
+
+		//! ctor.  Is passed an sql handle holding the query, which is declared as a cursor by begin()
+		/*! @param h handle holding the query
+		  @param fetch_size number of rows to fetch at a time
+		  @param format form to have the results sent in, see recordset */
+		cursor_recordset( const handle& h, int fetch_size = 1000, rdms::result_format format = rdms::text_results ) :
+			fetch_size_( fetch_size ),
+			format_( format ),
+			cursor_( 0 ),
+			handle_( h )
+		{ }
+
+		//! closes the cursor
+		~cursor_recordset() {
+			delete cursor_;
+		}
+
+		//! declare the cursor if it hasn't been yet, and return the first row not yet read
+		iterator begin() {
+			if ( ! cursor_ ) {
+				if ( ! handle_.valid() ) {
+					return iterator();
+				}
+				cursor_ = new rdms::cursor( *handle_, fetch_size_, format_ );
+			}
+			return iterator( cursor_ );
+		}
+
+		//! end of results
+		iterator end() {
+			return iterator();
+		}
+
+		//! has the query succeeded so far.  An error part way through the rows ends them early
+		bool ok() const {
+			return cursor_ && cursor_->ok();
+		}
+
+		//! return the tmplsql::handle that cursor_recordset is using
+		handle&
+		get_handle(){
+			return handle_;
+		}
+	private:
+		cursor_recordset( const cursor_recordset& );
+		cursor_recordset& operator=( const cursor_recordset& );
+
+		int fetch_size_;
+		rdms::result_format format_;
+		rdms::cursor *cursor_;
+		handle handle_;
+	};
+
+}
+
+#endif // _TMPLSQL_CURSOR_RECORDSET_H_
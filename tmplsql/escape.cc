@@ -0,0 +1,183 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+
+#include "tmplsql/escape.h"
+
+#include "config.h"
+
+#include "postgresql/libpq-fe.h"
+#include <string.h>
+#include <strings.h>
+#if __cplusplus >= 201103L
+#  include <atomic>
+#else
+#  include <signal.h>
+#endif
+
+#if defined( __AVX2__ )
+#  include <immintrin.h>
+#elif defined( __SSE2__ )
+#  include <emmintrin.h>
+#endif
+
+using namespace tmplsql;
+
+// The settings the connection free escape_string() follows, as last reported by any server.  Every thread that
+// connects or runs a statement updates them, so they're kept in a single word that is read and written whole, so that
+// no thread sees the standard_conforming_strings of one server with the client_encoding of another.  Zero is what
+// libpq assumes before it has heard from a server
+enum {
+	standard_strings_flag = 1,
+	unsafe_encoding_flag = 2
+};
+#if __cplusplus >= 201103L
+static std::atomic<int> escape_flags( 0 );
+
+static inline int
+load_escape_flags() {
+	return escape_flags.load( std::memory_order_relaxed );
+}
+
+static inline void
+store_escape_flags( int flags ) {
+	escape_flags.store( flags, std::memory_order_relaxed );
+}
+#else
+static volatile sig_atomic_t escape_flags = 0;
+
+static inline int
+load_escape_flags() {
+	return escape_flags;
+}
+
+static inline void
+store_escape_flags( int flags ) {
+	escape_flags = flags;
+}
+#endif
+
+// the client encodings in which the second byte of a character may be a quote or backslash
+static const char *unsafe_encodings[] = { "SJIS", "SHIFT_JIS_2004", "BIG5", "GBK", "UHC", "GB18030", "JOHAB", 0 };
+
+// can text in client_encoding be escaped a byte at a time
+static bool
+byte_safe_encoding( const char *client_encoding ) {
+	for ( const char **enc = unsafe_encodings; client_encoding && *enc; ++enc ) {
+		if ( ! strcasecmp( client_encoding, *enc ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// does conn have standard_conforming_strings on
+static bool
+standard_strings_on( PGconn *conn ) {
+	const char *standard = PQparameterStatus( conn, "standard_conforming_strings" );
+	return standard && ! strcmp( standard, "on" );
+}
+
+void
+detail::set_escape_settings( bool standard, const char *client_encoding ){
+	store_escape_flags( ( standard ? standard_strings_flag : 0 )
+			    | ( byte_safe_encoding( client_encoding ) ? 0 : unsafe_encoding_flag ) );
+}
+
+void
+detail::note_escape_settings( PGconn *conn ){
+	set_escape_settings( standard_strings_on( conn ), PQparameterStatus( conn, "client_encoding" ) );
+}
+
+bool
+detail::escape_byte_safe(){
+	return ! ( load_escape_flags() & unsafe_encoding_flag );
+}
+
+size_t
+detail::escape_scalar( char *to, const char *from, size_t length, bool backslashes ){
+	char *out = to;
+	for ( const char *end = from + length; from != end && *from; ++from ) {
+		if ( '\'' == *from || ( backslashes && '\\' == *from ) ) {
+			*out++ = *from;
+		}
+		*out++ = *from;
+	}
+	*out = '\0';
+	return out - to;
+}
+
+size_t
+detail::escape_vector( char *to, const char *from, size_t length, bool backslashes ){
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+	char *out = to;
+	const char *end = from + length;
+	// when backslashes are left alone, look for a second quote instead, which finds nothing more
+	const char second = backslashes ? '\\' : '\'';
+#  if defined( __AVX2__ )
+	typedef __m256i vector;
+	const vector quotes = _mm256_set1_epi8( '\'' );
+	const vector seconds = _mm256_set1_epi8( second );
+	const vector nuls = _mm256_setzero_si256();
+#  else
+	typedef __m128i vector;
+	const vector quotes = _mm_set1_epi8( '\'' );
+	const vector seconds = _mm_set1_epi8( second );
+	const vector nuls = _mm_setzero_si128();
+#  endif
+	while ( static_cast<size_t>( end - from ) >= sizeof( vector ) ) {
+#  if defined( __AVX2__ )
+		vector chunk = _mm256_loadu_si256( reinterpret_cast<const vector*>( from ) );
+		unsigned int found = _mm256_movemask_epi8( _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( chunk, quotes ),
+											    _mm256_cmpeq_epi8( chunk, seconds ) ),
+								_mm256_cmpeq_epi8( chunk, nuls ) ) );
+#  else
+		vector chunk = _mm_loadu_si128( reinterpret_cast<const vector*>( from ) );
+		unsigned int found = _mm_movemask_epi8( _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( chunk, quotes ),
+									       _mm_cmpeq_epi8( chunk, seconds ) ),
+							  _mm_cmpeq_epi8( chunk, nuls ) ) );
+#  endif
+		if ( ! found ) {
+			// nothing to escape, the whole chunk goes as it is
+			memcpy( out, from, sizeof( vector ) );
+			out += sizeof( vector );
+			from += sizeof( vector );
+			continue;
+		}
+		int clean = __builtin_ctz( found );
+		memcpy( out, from, clean );
+		out += clean;
+		from += clean;
+		if ( ! *from ) {
+			*out = '\0';
+			return out - to;
+		}
+		*out++ = *from;
+		*out++ = *from++;
+	}
+	return ( out - to ) + escape_scalar( out, from, end - from, backslashes );
+#else
+	return escape_scalar( to, from, length, backslashes );
+#endif
+}
+
+size_t
+tmplsql::escape_string( char *to, const char *from, size_t length ){
+	int flags = load_escape_flags();
+	if ( flags & unsafe_encoding_flag ) {
+		return PQescapeString( to, from, length );
+	}
+	return detail::escape_vector( to, from, length, ! ( flags & standard_strings_flag ) );
+}
+
+size_t
+tmplsql::escape_string( PGconn *conn, char *to, const char *from, size_t length ){
+	if ( ! byte_safe_encoding( PQparameterStatus( conn, "client_encoding" ) ) ) {
+		return PQescapeStringConn( conn, to, from, length, 0 );
+	}
+	return detail::escape_vector( to, from, length, ! standard_strings_on( conn ) );
+}
@@ -0,0 +1,65 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_ESCAPE_H_
+#define _TMPLSQL_ESCAPE_H_
+
+#include <stddef.h>
+#include "postgresql/libpq-fe.h"
+
+namespace tmplsql {
+
+	//! escape text for use between single quotes in a statement
+	/*!
+	  Quotes are doubled, as are backslashes unless the server has standard_conforming_strings on.  Like
+	  PQescapeString, escaping stops at a nul, and the settings followed are the last a server was seen to
+	  report, see detail::note_escape_settings().  Text going to a known connection should use the overload taking
+	  it, which can't be misled by another connection's settings.  In the encodings where a multibyte character can hold a quote or backslash byte, such as SJIS and
+	  BIG5, the work is handed to PQescapeString.  Otherwise the clean runs of text between the bytes that need
+	  escaping are copied a vector at a time.
+	  @param to where to write, must have room for length * 2 + 1 characters
+	  @param from the text to escape
+	  @param length number of characters in from
+	  @return number of characters written to to, not counting the nul which is added
+	*/
+	size_t escape_string( char *to, const char *from, size_t length );
+
+	//! escape text for use between single quotes in a statement run on conn
+	/*!
+	  As escape_string(), but following the standard_conforming_strings and client_encoding conn has at the time of
+	  the call, as PQescapeStringConn does.  libpq keeps these up to date as the server reports them, so a SET run
+	  part way through a session is followed from the next call on.
+	*/
+	size_t escape_string( PGconn *conn, char *to, const char *from, size_t length );
+
+	namespace detail {
+
+		//! escape_string() with the settings given, a byte at a time
+		/*! @param backslashes are backslashes doubled as well as quotes */
+		size_t escape_scalar( char *to, const char *from, size_t length, bool backslashes );
+
+		//! escape_string() with the settings given, using SSE2 or AVX2 when built for them.
+		/*! Writes exactly what escape_scalar() does */
+		size_t escape_vector( char *to, const char *from, size_t length, bool backslashes );
+
+		//! record the settings for escape_string() to follow
+		/*! @param standard_strings the server's standard_conforming_strings is on
+		  @param client_encoding name of the client encoding */
+		void set_escape_settings( bool standard_strings, const char *client_encoding );
+
+		//! record the settings conn has now for escape_string() to follow
+		/*! Called whenever a connection is made or reset, and after the statements run on it */
+		void note_escape_settings( PGconn *conn );
+
+		//! can the text be escaped a byte at a time in the client encoding last set
+		bool escape_byte_safe();
+
+	} // namespace detail
+
+} // namespace tmplsql
+
+#endif // _TMPLSQL_ESCAPE_H_
@@ -84,6 +84,8 @@ namespace tmplsql {
 	   assert( f.get() == 42 );
 	   <pre><code>
 	   the goal of the field<T> class is to provide a small wrapper around the field information and a value of type<T>.
+	   The value is held in the field itself until the field is first copied, when it moves to the heap to be shared, so
+	   a field that is never copied, such as one read from a query that can't be written back, allocates nothing.
 	*/
 	template < class T >
 	class field : public base_field {
@@ -93,24 +95,47 @@ namespace tmplsql {
 	private:
 		friend class row_saver_base;
 
-		value_type *value_;
+		//! a value shared between copies of a field, and how many there are
+		struct shared_value {
+			shared_value( const value_type& v ) : value( v ), count( 1 ) { }
+			value_type value;
+			size_t count;
+		};
 
-		void inc_ref_count(){
-			++*count_;
+		//! the value, until the field is copied
+		mutable value_type local_;
+		//! the value once the field has been copied, or 0
+		mutable shared_value *shared_;
+
+		//! move the value to the heap, so that it can be shared with a copy
+		shared_value* share() const {
+			if ( ! shared_ ) {
+				shared_ = new shared_value( local_ );
+				local_ = value_type();
+			}
+			return shared_;
 		}
 
 		void dec_ref_count(){
-			if (  0 == --*count_ ) {
-				delete value_;
-				delete count_;
-			} else  if ( rs_ && (*count_) == 1 ) {
+			if ( ! shared_ ) {
+				return;
+			}
+			if (  0 == --shared_->count ) {
+				delete shared_;
+			} else  if ( rs_ && shared_->count == 1 ) {
 				rs_->remove_ref( key_ );
 				rs_=0;
 			}
 		}
 	protected:
-		//! count of how many instances are sharing value_
-		size_t *count_;
+		//! count of how many instances are sharing the value
+		size_t ref_count() const {
+			return shared_ ? shared_->count : 1;
+		}
+		//! the value, wherever it is held
+		value_type& value() const {
+			return shared_ ? shared_->value : local_;
+		}
 		//! the row_saver to remove our reference to.
 		row_saver_base *rs_;
 		//! a unique value to send to row_saver_base::unregister
@@ -123,8 +148,8 @@ namespace tmplsql {
 		 */
 		field( fields::field_name_t name, fields::table_name_t table ) : 
 			base_field ( name,table ),
-			value_( new value_type() ),
-			count_( new unsigned int(1) ),
+			local_(),
+			shared_( 0 ),
 			rs_( 0 ),
 			key_(0)
 		{ 
@@ -133,19 +158,33 @@ namespace tmplsql {
 		}
 		//! returns true if it is safe to delete object
 		virtual bool delete_ok(){
-			return ( *count_ == 1 );
+			return ( this->ref_count() == 1 );
 		}
 
 		//! copy constructor.
 		field( const field& f ) :
 			base_field ( f ),
-			value_( f.value_ ),
-			count_( f.count_ ),
+			local_(),
+			shared_( f.share() ),
 			rs_( f.rs_ ),
 			key_( f.key_ )
 			
 		{
-			inc_ref_count();
+			++shared_->count;
+		}
+
+		//! assignment, after which the field shares f's value as a copy would
+		field& operator=( const field& f ) {
+			if ( this != &f ) {
+				shared_value *shared = f.share();
+				++shared->count;
+				this->dec_ref_count();
+				base_field::operator=( f );
+				shared_ = shared;
+				rs_ = f.rs_;
+				key_ = f.key_;
+			}
+			return *this;
 		}
 
 		//! initialize the fields value.
@@ -153,13 +192,13 @@ namespace tmplsql {
 		  field to be modifield 
 		  @param value value to set field to */
 		virtual bool initialize( const T& value ) {
-			*value_ = value;
+			this->value() = value;
 			return true;
 		}
 		//! retrieve the value of the field
 		/*! @return field's value */
 		T get() const {
-			return *value_;
+			return this->value();
 		}
 		//! conversion operator
 		/*!  this is somewhat controversial, however I feel it makes sense to be able to do:
@@ -170,16 +209,16 @@ namespace tmplsql {
 		  </pre></code>
 		*/
 		operator T() const {
-			return *value_;
+			return this->value();
 		}
 
 		//! return true if the field's value is equal to value
 		bool operator== ( const T& value ) const {
-			return (*value_) == value;
+			return this->value() == value;
 		}
 		//! return true if the field's value is not equal to value
 		bool operator!= ( const T& value ) const {
-			return *value_ != value;
+			return this->value() != value;
 		}
 		//! destructor
 		virtual ~field() {
@@ -250,7 +289,7 @@ namespace tmplsql {
 		}
 		//! dtor
 		virtual ~updateable_field(){
-			if ( 1 == *(field<T>::count_) ) {
+			if ( 1 == this->ref_count() ) {
 				delete is_modified_;
 			}
 		}
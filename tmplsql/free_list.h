@@ -0,0 +1,214 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_FREE_LIST_H_
+#define _TMPLSQL_FREE_LIST_H_
+
+#include <vector>
+#include <unistd.h>
+
+namespace tmplsql {
+
+	namespace detail {
+
+		//! A fixed capacity, lock-free LIFO stack of pointers.
+		/*!
+		  All slots are allocated up front and never freed while the stack exists, so a thread that
+		  reads a slot another thread has just popped only ever sees stale data, never freed memory.
+		  Each head is a 64 bit word holding a slot index in the low half and an ABA tag in the high half,
+		  and is updated with the gcc __sync builtins.
+		*/
+		template <class T>
+		class lock_free_stack {
+			struct slot {
+				T *value;
+				volatile unsigned int next;
+			};
+			enum { index_mask = 0xffffffffU };
+
+			// pop a slot index off of head.  Returns -1 if head is empty
+			int pop_index( volatile unsigned long long& head ){
+				for (;;) {
+					unsigned long long old_head = head;
+					unsigned int index = static_cast<unsigned int>( old_head & index_mask );
+					if ( ! index ){
+						return -1;
+					}
+					unsigned long long new_head = ( ( ( old_head >> 32 ) + 1 ) << 32 ) | slots_[ index - 1 ].next;
+					if ( __sync_bool_compare_and_swap( &head, old_head, new_head ) ){
+						return index - 1;
+					}
+				}
+			}
+
+			// push slot index onto head
+			void push_index( volatile unsigned long long& head, int index ){
+				for (;;) {
+					unsigned long long old_head = head;
+					slots_[ index ].next = static_cast<unsigned int>( old_head & index_mask );
+					unsigned long long new_head = ( ( ( old_head >> 32 ) + 1 ) << 32 ) | ( index + 1 );
+					if ( __sync_bool_compare_and_swap( &head, old_head, new_head ) ){
+						return;
+					}
+				}
+			}
+
+			lock_free_stack( const lock_free_stack& );
+			lock_free_stack& operator=( const lock_free_stack& );
+		public:
+			//! @param capacity maximum number of pointers the stack will hold
+			lock_free_stack( unsigned int capacity ) :
+				slots_( new slot[ capacity ] ),
+				used_head_( 0 ),
+				free_head_( 0 ),
+				size_( 0 )
+			{
+				for ( unsigned int i = 0; i < capacity; ++i ){
+					slots_[i].value = 0;
+					push_index( free_head_, i );
+				}
+			}
+
+			//! push value onto the stack.
+			/*! @return false if the stack was already full, in which case the caller still owns value */
+			bool push( T *value ){
+				int index = pop_index( free_head_ );
+				if ( index < 0 ){
+					return false;
+				}
+				slots_[ index ].value = value;
+				push_index( used_head_, index );
+				__sync_fetch_and_add( &size_, 1 );
+				return true;
+			}
+
+			//! pop the most recently pushed value, or 0 if the stack is empty
+			T* pop(){
+				int index = pop_index( used_head_ );
+				if ( index < 0 ){
+					return 0;
+				}
+				T *ret_val = slots_[ index ].value;
+				push_index( free_head_, index );
+				__sync_fetch_and_sub( &size_, 1 );
+				return ret_val;
+			}
+
+			//! number of values on the stack.  Only a snapshot if other threads are using the stack.
+			unsigned int size() const {
+				// a pop can be counted before the push it raced with, so size_ may briefly dip below 0
+				int ret_val = size_;
+				return ret_val > 0 ? ret_val : 0;
+			}
+
+			~lock_free_stack(){
+				delete [] slots_;
+			}
+		private:
+			slot *slots_;
+			// the two heads and the count are kept on separate cache lines from each other and from neighbouring shards,
+			// so that counting a push or pop doesn't bounce the line a head is being swapped on.
+			char pad0_[64];
+			volatile unsigned long long used_head_;
+			char pad1_[64];
+			volatile unsigned long long free_head_;
+			char pad2_[64];
+			volatile int size_;
+			char pad3_[64];
+		};
+
+
+		//! A set of lock_free_stack shards that threads are spread across.
+		/*!
+		  Each thread is given a home shard the first time it touches the list, handed out round robin,
+		  so under load different threads mostly hit different cache lines.  When the home shard runs dry
+		  pop() steals from the other shards, and when it is full push() spills over into them.
+		  The combined capacity of all shards is exactly the capacity given to the constructor.
+		*/
+		template <class T>
+		class sharded_free_list {
+			sharded_free_list( const sharded_free_list& );
+			sharded_free_list& operator=( const sharded_free_list& );
+
+			unsigned int home_shard(){
+				static __thread int home = -1;
+				if ( home < 0 ){
+					static volatile unsigned int next_home = 0;
+					home = __sync_fetch_and_add( &next_home, 1 );
+				}
+				return home % shards_.size();
+			}
+		public:
+			//! @param capacity total number of pointers to hold.
+			//! @param num_shards number of shards to split them over.  0 means one per online cpu.
+			sharded_free_list( unsigned int capacity, unsigned int num_shards = 0 ) {
+				if ( ! num_shards ){
+					long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+					num_shards = cpus > 0 ? cpus : 1;
+				}
+				// never split the list so finely that shards can hold nothing
+				if ( num_shards > capacity ){
+					num_shards = capacity ? capacity : 1;
+				}
+				for ( unsigned int i = 0; i < num_shards; ++i ){
+					shards_.push_back( new lock_free_stack<T>( capacity / num_shards + ( i < capacity % num_shards ) ) );
+				}
+			}
+
+			//! store value, preferring the calling thread's home shard.
+			/*! @return false if every shard is full, in which case the caller still owns value */
+			bool push( T *value ){
+				unsigned int home = home_shard();
+				for ( unsigned int i = 0; i < shards_.size(); ++i ){
+					if ( shards_[ ( home + i ) % shards_.size() ]->push( value ) ){
+						return true;
+					}
+				}
+				return false;
+			}
+
+			//! take a value, preferring the calling thread's home shard and stealing from the others if it is empty.
+			/*! @return 0 if every shard is empty */
+			T* pop(){
+				unsigned int home = home_shard();
+				for ( unsigned int i = 0; i < shards_.size(); ++i ){
+					T *ret_val = shards_[ ( home + i ) % shards_.size() ]->pop();
+					if ( ret_val ){
+						return ret_val;
+					}
+				}
+				return 0;
+			}
+
+			//! number of values held across all shards.  Only a snapshot if other threads are using the list.
+			unsigned int size() const {
+				unsigned int ret_val = 0;
+				for ( unsigned int i = 0; i < shards_.size(); ++i ){
+					ret_val += shards_[i]->size();
+				}
+				return ret_val;
+			}
+
+			//! number of shards
+			unsigned int num_shards() const {
+				return shards_.size();
+			}
+
+			~sharded_free_list(){
+				for ( unsigned int i = 0; i < shards_.size(); ++i ){
+					delete shards_[i];
+				}
+			}
+		private:
+			std::vector< lock_free_stack<T>* > shards_;
+		};
+
+	} // namespace detail
+
+} // namespace tmplsql
+
+#endif // _TMPLSQL_FREE_LIST_H_
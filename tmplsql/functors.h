@@ -13,6 +13,7 @@
 #include <boost/tuple/tuple.hpp>
 #include <boost/type_traits.hpp>
 #include <list>
+#include "tmplsql/sql_writer.h"
 #include "tmplsql/row_saver.h"
 
 namespace tmplsql {
@@ -97,7 +98,8 @@ namespace tmplsql {
 		inline size_t
 		stream_modified_field_updates( const boost::tuples::cons<H, T>& x, std::ostream &stmt, commas& comma ) {
 			if ( x.get_head() && x.get_head()->is_modified() ){
- 				stmt << comma  << x.get_head()->name() << "=" << quote( x.get_head()->get() );
+ 				stmt << comma  << x.get_head()->name() << "=";
+				write_literal( stmt, x.get_head()->get() );
 				return  1+stream_modified_field_updates( x.get_tail(),stmt,comma );				
  			} else {
 				return stream_modified_field_updates( x.get_tail(),stmt,comma );
@@ -7,7 +7,6 @@
 
 #include "tmplsql/handle.h"
 #include "tmplsql/rdms.h"
-#include <cassert>
 
 using namespace tmplsql;
 
@@ -15,26 +14,34 @@ handle::handle() :
 	handle_( rdms::handle() ),
 	count_( new unsigned int(1) )
 {
-	assert ( handle_ );
+
+}
+
+handle::handle( const std::string& pool_name ) :
+	handle_( rdms::handle( pool_name ) ),
+	count_( new unsigned int(1) )
+{
+
 }
 
 handle::handle(const handle& h) :
 	handle_ ( h.handle_ ),
 	count_( h.count_ )
 {
-	++*count_;
+	if ( count_ ) {
+		++*count_;
+	}
 }
 
 handle&
 handle::operator=( const handle& h ) {
 	if ( this != &h ) {
-		if ( handle_ && 0 == --*count_ ) {
-			handle_->release();
-			delete count_;
-		}
+		this->release();
 		handle_ = h.handle_;
 		count_ = h.count_;
-		++*count_;
+		if ( count_ ) {
+			++*count_;
+		}
         }
         return *this;
 }
@@ -54,18 +61,18 @@ handle::operator->() const {
 
 void
 handle::release(){
-	if ( handle_ && 0 == --(*count_) ) {
+	if ( count_ && 0 == --(*count_) ) {
 		delete count_;
-		handle_->release();
+		if ( handle_ ) {
+			handle_->release();
+		}
 	}
 	handle_=0;
+	count_=0;
 }
 
 handle::~handle() {
-	if ( handle_ && 0 == --(*count_) ) {
-		delete count_;
-		handle_->release();
-	}
+	this->release();
 }
 
 bool
@@ -10,6 +10,7 @@
 #define _TMPLSQL_HANDLE_H_
 
 #include "tmplsql/rdms.h"
+#include <string>
 
 
 namespace tmplsql {
@@ -25,8 +26,12 @@ namespace tmplsql {
 	*/
 	class handle {
 	public:
-		//! ctor
+		//! ctor.  If the pool is at rdms::pool_options::max_connections and no connection comes free
+		//! in time, the handle is left invalid; check with valid() before use.
 		handle();
+		//! ctor.  Draws the connection from the pool set up by rdms::initialize under pool_name.
+		//! The handle is left invalid if there is no such pool, or as for handle().
+		explicit handle( const std::string& pool_name );
 		//! copy ctor
 		handle( const handle &h );
 		//! assignment operator
@@ -9,24 +9,228 @@
 #define _TMPLSQL_LEXICAL_CAST_H_
 
 
+#include <boost/type_traits.hpp>
 #include <sstream>
 #include <typeinfo>
+#include <limits>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <iostream>
 
+// std::to_chars and std::from_chars, which are quicker than the fallbacks, and don't depend on the locale
+#if __cplusplus >= 201703L && defined( __has_include )
+#  if __has_include( <charconv> )
+#    include <charconv>
+#    define TMPLSQL_INTEGER_TO_CHARS 1
+#    if defined( __cpp_lib_to_chars )
+#      define TMPLSQL_FLOAT_TO_CHARS 1
+#    endif
+#  endif
+#endif
+
 namespace tmplsql {
 
+	namespace detail {
+
+		//! is c whitespace, as std::ws would skip
+		inline bool cast_space( char c ) {
+			return ' ' == c || ( '\t' <= c && c <= '\r' );
+		}
+
+		//! reads numbers of type T from text, the types that are read this way are specialized below
+		template<typename T>
+		struct number_parser {
+			enum { integral = false, floating = false };
+		};
+
+		//! integers, read a digit at a time when std::from_chars isn't there
+		template<typename T>
+		struct integer_parser {
+			enum { integral = true, floating = false };
+			//! read a T from the start of [begin,end)
+			/*! @return the end of the number, or 0 if there is none or it doesn't fit in a T */
+			static const char* parse( const char *begin, const char *end, T& value ) {
+#ifdef TMPLSQL_INTEGER_TO_CHARS
+				std::from_chars_result read = std::from_chars( begin, end, value );
+				return read.ec == std::errc() ? read.ptr : 0;
+#else
+				bool negative = ( begin != end && '-' == *begin );
+				if ( negative ) {
+					if ( ! std::numeric_limits<T>::is_signed ) {
+						return 0;
+					}
+					++begin;
+				}
+				if ( begin == end || *begin < '0' || *begin > '9' ) {
+					return 0;
+				}
+				T result = 0;
+				for ( ; begin != end && *begin >= '0' && *begin <= '9'; ++begin ) {
+					int digit = *begin - '0';
+					// negative numbers are built up negative, so that the most negative value fits
+					if ( negative ) {
+						if ( result < ( std::numeric_limits<T>::min() + digit ) / 10 ) {
+							return 0;
+						}
+						result = result * 10 - digit;
+					} else {
+						if ( result > ( std::numeric_limits<T>::max() - digit ) / 10 ) {
+							return 0;
+						}
+						result = result * 10 + digit;
+					}
+				}
+				value = result;
+				return begin;
+#endif
+			}
+		};
+
+		//! floating point, which falls back to strtod and friends, and so to the C locale's decimal point
+		template<typename T>
+		struct float_parser {
+			enum { integral = false, floating = true };
+			//! read a T from the start of [begin,end), which must be followed by a nul
+			/*! @return the end of the number, or 0 if there is none or it doesn't fit in a T */
+			static const char* parse( const char *begin, const char *end, T& value ) {
+#ifdef TMPLSQL_FLOAT_TO_CHARS
+				std::from_chars_result read = std::from_chars( begin, end, value );
+				return read.ec == std::errc() ? read.ptr : 0;
+#else
+				char *stop = 0;
+				errno = 0;
+				long double result = strtold( begin, &stop );
+				bool finite = ( result - result == 0 );
+				if ( stop == begin || ERANGE == errno ||
+				     ( finite && ( result > std::numeric_limits<T>::max() || result < -std::numeric_limits<T>::max() ) ) ) {
+					return 0;
+				}
+				value = static_cast<T>( result );
+				return stop;
+#endif
+			}
+		};
+
+		template<> struct number_parser<short> : public integer_parser<short> { };
+		template<> struct number_parser<unsigned short> : public integer_parser<unsigned short> { };
+		template<> struct number_parser<int> : public integer_parser<int> { };
+		template<> struct number_parser<unsigned int> : public integer_parser<unsigned int> { };
+		template<> struct number_parser<long> : public integer_parser<long> { };
+		template<> struct number_parser<unsigned long> : public integer_parser<unsigned long> { };
+		template<> struct number_parser<long long> : public integer_parser<long long> { };
+		template<> struct number_parser<unsigned long long> : public integer_parser<unsigned long long> { };
+		template<> struct number_parser<float> : public float_parser<float> { };
+		template<> struct number_parser<double> : public float_parser<double> { };
+		template<> struct number_parser<long double> : public float_parser<long double> { };
+
+		//! is T one of the numbers number_parser reads
+		template<typename T>
+		struct parsed_number {
+			enum { value = number_parser<T>::integral || number_parser<T>::floating };
+		};
+
+		//! read the whole of text as a number
+		/*! Whitespace either side and a leading '+' are allowed, as std::stringstream allows them */
+		template<typename T>
+		inline bool parse_number( const char *text, T& result ) {
+			if ( ! text ) {
+				return false;
+			}
+			while ( cast_space( *text ) ) {
+				++text;
+			}
+			// from_chars wants no '+', but that mustn't let "+-1" through
+			if ( '+' == *text && '-' != text[1] ) {
+				++text;
+			}
+			const char *end = text + strlen( text );
+			while ( end != text && cast_space( end[-1] ) ) {
+				--end;
+			}
+			T value;
+			if ( number_parser<T>::parse( text, end, value ) != end || end == text ) {
+				return false;
+			}
+			result = value;
+			return true;
+		}
+
+		//! lexical_cast, through a std::stringstream
+		template<typename Target, typename Source,
+			 bool Number = parsed_number<Target>::value && ( boost::is_same<Source, const char*>::value || boost::is_same<Source, char*>::value ) >
+		struct caster {
+			static Target cast( Source arg ) {
+				std::stringstream interpreter;
+				Target result;
+				if( ! ( interpreter << arg) || !(interpreter >> result) || ! ( interpreter >> std::ws ).eof() ) {
+					return 0;
+				}
+				return result;
+			}
+		};
+
+		//! lexical_cast, text to number
+		template<typename Target, typename Source>
+		struct caster<Target, Source, true> {
+			static Target cast( Source arg ) {
+				Target result = 0;
+				parse_number( arg, result );
+				return result;
+			}
+		};
+
+		//! lexical_cast( const char*, Target& ), through a std::stringstream
+		template<typename Target, bool Number = parsed_number<Target>::value>
+		struct text_caster {
+			static bool cast( const char *text, Target& result ) {
+				std::stringstream interpreter;
+				Target value;
+				if ( ! text || ! ( interpreter << text ) || ! ( interpreter >> value ) || ! ( interpreter >> std::ws ).eof() ) {
+					return false;
+				}
+				result = value;
+				return true;
+			}
+		};
+
+		//! lexical_cast( const char*, Target& ) for numbers
+		template<typename Target>
+		struct text_caster<Target, true> {
+			static bool cast( const char *text, Target& result ) {
+				return parse_number( text, result );
+			}
+		};
+
+	} // namespace detail
+
 	//! converts data type Source to type Target
-	/*! the lexical cast functions attempt to convert data from the Source type to the Target type using std::stringstream */
+	/*! the lexical cast functions attempt to convert data from the Source type to the Target type using std::stringstream.
+	  Text is converted to numbers without it, and without regard to the locale.  0 is returned if arg can't be converted,
+	  see lexical_cast( const char*, Target& ) to tell that from a 0 that was converted. */
 	template<typename Target, typename Source>
 	inline Target lexical_cast(Source arg)   {
-		std::stringstream interpreter;
-		Target result;
-		if( ! ( interpreter << arg) || !(interpreter >> result) || ! ( interpreter >> std::ws ).eof() ) {
-			return 0;
-		}
-		return result;
+		return detail::caster<Target, Source>::cast( arg );
+	}
+
+	//! converts text to a number, reporting if it can't be done
+	/*!
+	  Integer and floating point types are read with std::from_chars when the standard library has it, and by hand
+	  otherwise.  Whitespace either side of the number is allowed, anything else is not, and the number has to fit in
+	  a Target.  Other types of Target go through a std::stringstream as lexical_cast( Source ) does.
+	  <pre><code>
+	  long id;
+	  if ( ! tmplsql::lexical_cast( row[0], id ) ) {
+	          std::cerr << "not an id: " << row[0] << std::endl;
+	  }
+	  </code></pre>
+	  @param text the text to convert
+	  @param result where the converted value is written, it is left alone if text can't be converted
+	  @return false if text is null or can't be converted
+	*/
+	template<typename Target>
+	inline bool lexical_cast( const char *text, Target& result ) {
+		return detail::text_caster<Target>::cast( text, result );
 	}
 
 	//! specialization for const char*
@@ -0,0 +1,104 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_PARAM_H_
+#define _TMPLSQL_PARAM_H_
+
+#include "tmplsql/rdms.h"
+#include "tmplsql/quote.h"
+#include "tmplsql/sql_writer.h"
+
+#include <string>
+#include <sstream>
+#include <iostream>
+
+namespace tmplsql {
+
+	namespace detail {
+
+		//! the text form of a value, as streaming it would give
+		template<typename T, bool Number = boost::is_arithmetic<T>::value >
+		struct param_writer {
+			static std::string text( const T& value ) {
+				std::ostringstream str;
+				// enough digits that a double makes the round trip intact
+				str.precision( 17 );
+				str << value;
+				return str.str();
+			}
+		};
+
+		//! numbers and bool, see sql_value()
+		template<typename T>
+		struct param_writer<T, true> {
+			static std::string text( T value ) {
+				char text[ sql_text_size ];
+				return std::string( text, sql_text<T>::write( text, value ) );
+			}
+		};
+
+		//! the text form of a value, as the server will parse it
+		template<typename T>
+		inline std::string param_text( const T& value ) {
+			return param_writer<T>::text( value );
+		}
+
+		//! specialization for timestamp.  One too far off to be written is sent as empty text, which the server rejects
+		inline std::string param_text( const timestamp& value ) {
+			char text[ sql_text_size ];
+			char *end = timestamp_text( text, value );
+			return end ? std::string( text, end ) : std::string();
+		}
+
+		//! specialization for std::string, which is already text
+		inline std::string param_text( const std::string& value ) {
+			return value;
+		}
+
+		//! specialization for const char*
+		inline std::string param_text( const char* value ) {
+			return value ? value : "";
+		}
+
+		//! holds a value being streamed by param()
+		template<typename T>
+		struct bound_value {
+			bound_value( const T& v ) : value( v ) { }
+			const T& value;
+		};
+
+	} // namespace detail
+
+	//! stream a value in to a statement as a parameter.
+	/*!
+	  When streamed in to a rdms handle the value is bound with rdms::bind(), so that a placeholder such as $1 goes in to
+	  the statement and the value is sent alongside it.  Streamed anywhere else, such as in to the std::stringstream that
+	  builds a subselect, the value is quoted in to the text as usual.
+	  <pre><code>
+	  tmplsql::handle sql;
+	  *sql << "select name from users where id = " << tmplsql::param( id );
+	  </code></pre>
+	*/
+	template<typename T>
+	inline detail::bound_value<T> param( const T& value ) {
+		return detail::bound_value<T>( value );
+	}
+
+} // namespace tmplsql
+
+//! write the value held by tmplsql::param() to str
+template<typename T>
+inline std::ostream& operator<<( std::ostream& str, const tmplsql::detail::bound_value<T>& b ) {
+	if ( tmplsql::rdms *sql = dynamic_cast<tmplsql::rdms*>( &str ) ) {
+		sql->bind( tmplsql::detail::param_text( b.value ) );
+	} else {
+		tmplsql::detail::write_literal( str, b.value );
+	}
+	return str;
+}
+
+#endif // _TMPLSQL_PARAM_H_
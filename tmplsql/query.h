@@ -17,6 +17,7 @@
 #include "tmplsql/operators.h"
 #include "tmplsql/commas.h"
 #include "tmplsql/row_saver.h"
+#include "tmplsql/param.h"
 #include <boost/tuple/tuple.hpp>
 #include <bitset>
 
@@ -29,6 +30,30 @@ namespace tmplsql {
 
 	namespace detail {
 		template< class T0, class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8, class T9 > class rs_holder;
+
+		//! is any of the fields in the tuple a primary key, so that the rows read can be written back
+		template< class Tuple >
+		struct has_primary_key {
+			enum { value = false };
+		};
+
+		//! check the head, then the rest of the tuple
+		template< class H, class T >
+		struct has_primary_key< boost::tuples::cons<H, T> > {
+			enum { value = boost::is_convertible<typename H::field_type, fields::primary>::value || has_primary_key<T>::value };
+		};
+
+		//! what query::iterator::get() returns, a reference to the field held by a row_saver when the query is updatable
+		template< class Field, bool Updatable >
+		struct query_field {
+			typedef Field& type;
+		};
+
+		//! a read only query returns the field itself, which holds its value inline
+		template< class Field >
+		struct query_field<Field, false> {
+			typedef Field type;
+		};
 	} // namespace detail
 
 
@@ -62,6 +87,10 @@ namespace tmplsql {
 		friend class detail::rs_holder<T0,T1,T2,T3,T4,T5,T6,T7,T8,T9>;
 		
 		typedef typename boost::tuple< T0,T1,T2,T3,T4,T5,T6,T7,T8,T9 > tuple_type;
+
+		//! can rows be written back, decided by whether any of the fields is a primary key
+		enum { updatable = detail::has_primary_key< boost::tuples::cons<typename tuple_type::head_type, typename tuple_type::tail_type> >::value };
+		typedef boost::integral_constant<bool, updatable> updatable_type;
 		typedef rs_holder<T0,T1,T2,T3,T4,T5,T6,T7,T8,T9> rs_holder_t;
 		typedef ::detail::hash_map<size_t,::tmplsql::detail::rs_holder<T0,T1,T2,T3,T4,T5,T6,T7,T8,T9>* > rsh_map_t;
 		rsh_map_t rsh_map;
@@ -140,7 +169,9 @@ namespace tmplsql {
 			pk_( 0 ),
 			needs_select_(true),
 			limit_(0),
-			rs_( handle() )
+			parallel_(1),
+			rs_( handle() ),
+			has_filter_value_( false )
 		{
 			// set our primary_key linked list.  If there are no primary fields, then pk_ will be 0, and the query will
 			// not be considered updatable.
@@ -161,14 +192,33 @@ namespace tmplsql {
 				query_(0) 
 			{ }
 			/*!
-			  get the field referenced by position Index
+			  get the field referenced by position Index.
+			  When none of the query's fields is a primary key, the query can't write rows back, and the field is returned
+			  by value, decoded straight from the row without any allocation.  Otherwise a reference to the field held by the
+			  row's row_saver is returned, and changes made to it are written back to the row.
 			  @return an initialized instance of the class stored at position Index.
 			*/
 			template<int Index>
+			typename detail::query_field<typename boost::tuples::element<Index, tuple_type >::type, updatable>::type
+			get() {
+				return this->template get_field<Index>( updatable_type() );
+			}
+		private:
+			// the field from the row's row_saver
+			template<int Index>
 			typename boost::add_reference<
 			typename boost::tuples::element<Index, tuple_type >::type
 			>::type
-			get();
+			get_field( const boost::true_type& );
+
+			// the field initialized with the value read from the row
+			template<int Index>
+			typename boost::tuples::element<Index, tuple_type >::type
+			get_field( const boost::false_type& ) {
+				typename boost::tuples::element<Index, tuple_type >::type ret_val;
+				ret_val.initialize( detail::decode< typename boost::tuples::element<Index, tuple_type >::type::value_type >( *this, Index ) );
+				return ret_val;
+			}
 		private:
 			iterator( const typename recordset_t::iterator& it,query<T0,T1,T2,T3,T4,T5,T6,T7,T8,T9> *q ) :
 				recordset_t::iterator( it ),
@@ -189,22 +239,52 @@ namespace tmplsql {
 			return iterator( rs_.end(),this );
 		}
 
+		//! the value types of the query's fields, read a column at a time, see columns()
+		typedef typename recordset_t::columns_type columns_type;
+
+		//! run the query, reading every row at once in to one vector for each field, see recordset::columns()
+		/*! The columns hold the fields' values rather than the fields, and so can't be written back */
+		columns_type columns(){
+			if ( needs_select_ ) {
+				this->select();
+			}
+			return rs_.columns();
+		}
+
+		//! stream the query in to the handle it runs on, without running it, so that it can be run elsewhere.
+		/*! Once the rows have been fetched, pass them to use_rows().  See tmplsql::co_begin() */
+		handle& select_statement(){
+			handle& ret_val = rs_.get_handle();
+			ret_val->abandon_statement();
+			this->stream_query( *ret_val );
+			return ret_val;
+		}
+
+		//! iterate over rows fetched for select_statement(), until the query is changed
+		void use_rows( const rdms::result_set& rows ){
+			rs_.assign( rows );
+			needs_select_ = false;
+		}
+
 		//! filter the rows selected by applying operator op to the value held by T
-		/*! return true if successfull, false otherwise */
+		/*! The value is bound to the query as a parameter rather than being quoted in to it, so the query is
+		  the same statement whatever the value, and can be run from the prepared statement cache.
+		  return true if successfull, false otherwise */
 		template<typename T>
 		bool set_filter( const T& f, const comp_operator &op = eq_operator() ) {
 			this->reset_query();
 			std::stringstream str;
 			str << f.table() << "." << f.name()
-			    << op.before_value() 
-			    << quote( f.get() )
-			    << op.after_value();
+			    << op.before_value();
 			where_ = str.str();
+			filter_value_ = detail::param_text( f.get() );
+			has_filter_value_ = true;
+			where_after_ = op.after_value();
 			return true;
 		}
 
 		//! filter the rows selected using the field located at Index in query.
-		/*! operator op is applied to the value val.
+		/*! operator op is applied to the value val, which is bound as a parameter as for set_filter( const T& ).
 		  return true if successfull, false otherwise */		
 		template<int Index>
 		bool
@@ -212,10 +292,11 @@ namespace tmplsql {
 			this->reset_query();
 			std::stringstream str;
 			str <<  boost::tuples::get<Index>(tup).table() << "." <<  boost::tuples::get<Index>(tup).name()
-			    << op.before_value() 
-			    << val
-			    << op.after_value();
+			    << op.before_value();
 			where_ = str.str();
+			filter_value_ = detail::param_text( val );
+			has_filter_value_ = true;
+			where_after_ = op.after_value();
 			return true;
 		}
 		//! filter the rows selected by performing a subselect.
@@ -228,6 +309,8 @@ namespace tmplsql {
 			    << q.sub_select_query()
 			    << op.after_value();
 			where_ = str.str();
+			has_filter_value_ = false;
+			where_after_.clear();
 			return true;
 		}
 
@@ -240,6 +323,18 @@ namespace tmplsql {
 			return true;
 		}
 
+		//! read the rows over several connections at once
+		/*! The table is split in to ranges of pages, each read on its own connection from the same snapshot, and the
+		  rows put back together, see rdms::select_parallel().  The rows come back in no particular order.  Queries
+		  with a join or a limit, and queries run in a transaction, are read on the one connection as usual.
+		  @param workers most connections to read with, including the query's own
+		  @return true on success, false otherwise */
+		bool set_parallel( unsigned int workers ){
+			this->reset_query();
+			parallel_ = workers;
+			return true;
+		}
+
 		//! set field to use an inner join
 		/*! fields in query located at Field1 and Field2 are compared using operator op */
 		template<int Field1,int Field2>
@@ -303,41 +398,77 @@ namespace tmplsql {
 			if ( ! join_condition_.empty() ){
 				str << join_condition_;
 			} else {
-				if ( pk_ ){
-					comma.reset();
-					primary_key *pk = pk_;
-					while ( pk->next ) { pk = pk->next; }
-					str << comma << pk->table;
-					
-				} else {
-					str << boost::tuples::get<0>(tup).table();
-				}
+				str << this->scan_table();
 			}
 
+			// values go in as parameters when str is the handle the query is run on, and are quoted in to the text
+			// when it's a subselect being built up.  As parameters the statement is the same whatever the values, so it
+			// is worth keeping prepared
+			if ( ( has_filter_value_ && ! where_.empty() ) || limit_ ) {
+				if ( rdms *sql = dynamic_cast<rdms*>( &str ) ) {
+					sql->cache_statement();
+				}
+			}
 			if ( ! where_.empty() ){ 
 				str <<  " where " << where_;
+				if ( has_filter_value_ ) {
+					str << param( filter_value_ );
+				}
+				str << where_after_;
+			}
+			if ( this->parallel_scan() ) {
+				if ( rdms *sql = dynamic_cast<rdms*>( &str ) ) {
+					str << ( where_.empty() ? " where " : " and " );
+					sql->page_range( this->scan_table() );
+				}
 			}
  			
  			if ( limit_ ){
- 				str << " limit " << limit_;
+ 				str << " limit " << param( limit_ );
  			}
 			return true;
  		}
 
 		void select(){
 			if ( this->stream_query( *(rs_.get_handle()) ) ){
-				rs_.refresh();
+				if ( this->parallel_scan() ) {
+					rs_.assign( rs_.get_handle()->select_parallel( parallel_ ) );
+				} else {
+					rs_.refresh();
+				}
 				needs_select_ =	true;
 			}
 		}
 
+		// the table rows are read from, when not joining
+		fields::table_name_t scan_table() const {
+			if ( pk_ ){
+				primary_key *pk = pk_;
+				while ( pk->next ) { pk = pk->next; }
+				return pk->table;
+			}
+			return boost::tuples::get<0>(tup).table();
+		}
+
+		// should the rows be read by rdms::select_parallel()
+		bool parallel_scan() const {
+			return parallel_ > 1 && join_condition_.empty() && ! limit_;
+		}
+
 		// the first in our linked list of primary keys.  Is set to 0 initialy.
 		primary_key *pk_;
 		
 		bool needs_select_;
 		unsigned int limit_;
+		unsigned int parallel_;
 		recordset_t rs_;
+		// the where clause, up to the filter value
 		std::string where_;
+		// the filter value, in text form
+		std::string filter_value_;
+		bool has_filter_value_;
+		// the rest of the where clause after the filter value
+		std::string where_after_;
 		std::string join_condition_;
 		tuple_type tup;
 	};
@@ -413,7 +544,8 @@ namespace tmplsql {
 				rs ( 0 )
 			{
 				self *row_saver_hld = this;
-				for ( typename query<T0,T1,T2,T3,T4,T5,T6,T7,T8,T9>::primary_key *pk = it->query_->pk_; pk->next; pk = pk->next ){
+				// a query without a primary key has no rows to save, and so just the one holder
+				for ( typename query<T0,T1,T2,T3,T4,T5,T6,T7,T8,T9>::primary_key *pk = it->query_->pk_; pk && pk->next; pk = pk->next ){
 					row_saver_hld->next = new self();
 					row_saver_hld = row_saver_hld->next;
 				}
@@ -446,11 +578,8 @@ namespace tmplsql {
 	typename boost::tuples::element<Index, typename query<T0,T1,T2,T3,T4,T5,T6,T7,T8,T9>::tuple_type >::type
 	 >::type
 	query<T0,T1,T2,T3,T4,T5,T6,T7,T8,T9>::iterator::
-	get(){
+	get_field( const boost::true_type& ){
 
-// 		// first check and see if our query is updatable or not.
-// 		// we do this by seeing if we have any primary keys or not.				
-// 		if ( query_->pk_ ){
 		// our row_saver holder
 		::tmplsql::detail::rs_holder<T0,T1,T2,T3,T4,T5,T6,T7,T8,T9> *row_saver_hld = 0;
 			
@@ -469,20 +598,9 @@ namespace tmplsql {
 		}
 
 		// now that we have our row_saver holder, retrieve the field from it
-		//::tmplsql::row_saver<T0,T1,T2,T3,T4,T5,T6,T7,T8,T9> *row_svr = row_saver_hld->get_rs( Index,this );
-		// make sure we actually got a row_saver, then set our return value to the field it gives us.
 		// note that we pass a pointer to the iterator to the row_saver, which handles
 		// initialization of the field if it needs to.
 		return 	row_saver_hld->get_rs( Index,this )->template get<Index>( this );
-		// } else {
-// 			typename boost::tuples::element<Index, tuple_type >::type ret_val;
-// 			// we are not updateable, so just initialize the field with the value
-// 			ret_val.initialize
-// 				( lexical_cast< typename boost::tuples::element<Index,tuple_type >::type::value_type >( (*this)[Index] ) );
-// 			return ret_val;	
-// 		}
-		
-
 	}
 	
 
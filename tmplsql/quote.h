@@ -11,8 +11,8 @@
 
 #include <string>
 #include <iostream>
-
-extern "C" size_t PQescapeString(char *to, const char *from, size_t length);
+#include <string.h>
+#include "tmplsql/escape.h"
 
 namespace tmplsql {
 	
@@ -21,6 +21,10 @@ namespace tmplsql {
 	  Safely quote a value for use in a sql statement.  This is done as a template so that numeric values can not be quoted, but strings may.
 		  
 	  The actual characters that are quoted may differ based on what RDMS is in use and it's quoting conventions.
+	  Not knowing which connection the value is for, quote() follows the standard_conforming_strings and client_encoding
+	  the last server to answer any thread reported, see escape_string().  That is only safe while every server
+	  and connection is set up alike.  Prefer streaming tmplsql::quoted() in to the rdms handle the statement is for,
+	  which escapes as that connection is set up.
 
 	  @param arg value to quote
 	  @param enclose should quoted value be enclosed in single quotes
@@ -32,41 +36,72 @@ namespace tmplsql {
 		return arg;
 	}
 
-	//! specialization of quote to safely quote std::string
-	inline std::string quote( const std::string& arg,bool enclose = true ) {
-		char *to = new char[ ( arg.length() * 2 ) + 1 ];
-		PQescapeString ( to, arg.c_str(), arg.length()  );
-		std::string ret_val;
-		if ( enclose ) {
-			ret_val = "'";
-		}
-		ret_val += to;
+	//! quote length characters of arg, escaping them straight in to the string returned, the only allocation made
+	inline std::string quote( const char *arg, size_t length, bool enclose = true ) {
+		std::string ret_val( length * 2 + 3, '\0' );
+		size_t size = escape_string( &ret_val[ enclose ], arg, length );
 		if ( enclose ) {
-			ret_val += "'";
+			ret_val[ 0 ] = '\'';
+			ret_val[ ++size ] = '\'';
+			++size;
 		}
-
-		delete [] to;
+		ret_val.resize( size );
 		return ret_val;
 	}
 
+	//! specialization of quote to safely quote std::string
+	inline std::string quote( const std::string& arg,bool enclose = true ) {
+		return quote( arg.data(), arg.length(), enclose );
+	}
+
 	//! specialization of quote to safely quote const char*
 	inline std::string quote( const char* arg,bool enclose = true ) {
-		char *to = new char[ ( strlen( arg ) * 2 ) + 1 ];
-		PQescapeString ( to, arg,strlen( arg )  );
-		std::string ret_val;
-		if ( enclose ) {
-			ret_val = "'";
-		}
-		ret_val += to;
-		if ( enclose ) {
-			ret_val += "'";
-		}
-		delete [] to;
-		return ret_val;
+		return quote( arg, strlen( arg ), enclose );
 	}
 
-}
+	namespace detail {
+
+		//! text held by quoted()
+		struct quoted_text {
+			quoted_text( const char *t, size_t l ) : text( t ), length( l ) { }
+			const char *text;
+			size_t length;
+		};
+
+	} // namespace detail
+
+	//! stream a value quoted, as quote() would but without building a string to hold it.
+	/*!
+	  Text is escaped straight in to a statement being built by a rdms handle, following that handle's connection's
+	  settings, and through a small buffer on the stack in to any other stream, following the last settings a server
+	  reported, as quote() does.  Anything but text is streamed as it is.
+	  <pre><code>
+	  *sql << "select id from users where name = " << tmplsql::quoted( name );
+	  </code></pre>
+	*/
+	template<typename T>
+	inline const T& quoted( const T& arg ) {
+		return arg;
+	}
 
+	//! specialization of quoted for std::string
+	inline detail::quoted_text quoted( const std::string& arg ) {
+		return detail::quoted_text( arg.data(), arg.length() );
+	}
+
+	//! specialization of quoted for const char*
+	inline detail::quoted_text quoted( const char *arg ) {
+		return detail::quoted_text( arg, strlen( arg ) );
+	}
+
+	//! specialization of quoted for char*
+	inline detail::quoted_text quoted( char *arg ) {
+		return detail::quoted_text( arg, strlen( arg ) );
+	}
+
+}
 
+//! write the text held by tmplsql::quoted() to str, quoted
+std::ostream& operator<<( std::ostream& str, const tmplsql::detail::quoted_text& q );
 
 #endif // _TMPLSQL_QUOTE_H_
@@ -9,65 +9,150 @@
 #include "tmplsql/handle.h"
 #include "tmplsql/rdms.h"
 #include "tmplsql/quote.h"
+#include "tmplsql/escape.h"
+#include "tmplsql/connection_pool.h"
 
 #include "config.h"
 
 #include <sstream>
-#include <queue>
 #include <map>
+#include <vector>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <iostream>
+#include <errno.h>
+#include <poll.h>
+#include <algorithm>
+#include <unistd.h>
+#include <time.h>
 
 using namespace tmplsql;
 
-typedef std::queue<class tmplsql::rdms*> queue_type;
-static queue_type bench_warmers;
-static queue_type::size_type max_spare_handles = 0;
 
-
-#include <IceUtil/RecMutex.h>
-static IceUtil::RecMutex sql_queue_mutex;
-
-
-static std::string conn_string;
-
-
-bool
-rdms::initialize( const connection_string& con, int num_spare_connections ) {
-	conn_string.clear();
-	max_spare_handles = num_spare_connections;
+static std::string
+make_conninfo( const rdms::connection_string& con ) {
+	std::string ret_val;
 	if ( ! con.login.empty() ) {
-		conn_string += " user=";
-		conn_string += con.login;
+		ret_val += " user=";
+		ret_val += con.login;
 	}
 	if ( ! con.password.empty() ) {
-		conn_string += " password=";
-		conn_string += con.password;
+		ret_val += " password=";
+		ret_val += con.password;
 	}
 	if ( ! con.host.empty() ) {
-		conn_string += " host=";
-		conn_string += con.host;
+		ret_val += " host=";
+		ret_val += con.host;
 	}
 	if ( ! con.port.empty() ) {
-		conn_string += " port=";
-		conn_string += con.port;
+		ret_val += " port=";
+		ret_val += con.port;
 	}
 	if ( ! con.dbname.empty() ) {
-		conn_string += " dbname=";
-		conn_string += con.dbname;
+		ret_val += " dbname=";
+		ret_val += con.dbname;
+	}
+	return ret_val;
+}
+
+// the pool called "", used by everything that doesn't name one.  Looked up once so the common case never touches the registry
+static connection_pool*
+default_pool() {
+	static connection_pool *pool = connection_pool::find( std::string() );
+	return pool;
+}
+
+
+bool
+rdms::initialize( const connection_string& con, int num_spare_connections ) {
+	return rdms::initialize( con, pool_options( num_spare_connections ) );
+}
+
+bool
+rdms::initialize( const connection_string& con, const pool_options& options ) {
+	return default_pool()->configure( make_conninfo( con ), options );
+}
+
+bool
+rdms::initialize( const std::string& pool_name, const connection_string& con, const pool_options& options ) {
+	return connection_pool::find_or_create( pool_name )->configure( make_conninfo( con ), options );
+}
+
+bool
+rdms::route_reads( const std::string& pool_name, const std::vector<std::string>& replica_pools, balance_policy policy ) {
+	connection_pool *pool = connection_pool::find( pool_name );
+	if ( ! pool ) {
+		return false;
+	}
+	std::vector<connection_pool*> replicas;
+	for ( unsigned int i = 0; i < replica_pools.size(); ++i ) {
+		connection_pool *replica = connection_pool::find( replica_pools[i] );
+		if ( ! replica || replica == pool ) {
+			return false;
+		}
+		replicas.push_back( replica );
 	}
+	pool->route_reads( replicas, policy );
 	return true;
 }
 
+void
+rdms::shutdown() {
+	std::vector<connection_pool*> pools = connection_pool::all();
+	for ( unsigned int i = 0; i < pools.size(); ++i ) {
+		pools[i]->shutdown();
+	}
+}
+
 bool
-rdms::clear_cache(){
-	sql_queue_mutex.lock();
-	while (  bench_warmers.size() ) {
-		delete bench_warmers.front();
-		bench_warmers.pop();
+rdms::warm_up( const std::string& pool_name ) {
+	connection_pool *pool = connection_pool::find( pool_name );
+	return pool && pool->warm_up();
+}
+
+void
+rdms::check_idle( const std::string& pool_name ) {
+	if ( connection_pool *pool = connection_pool::find( pool_name ) ) {
+		pool->check_idle();
+	}
+}
+
+rdms::pool_statistics
+rdms::statistics( const std::string& pool_name ) {
+	connection_pool *pool = connection_pool::find( pool_name );
+	return pool ? pool->statistics() : pool_statistics();
+}
+
+bool
+rdms::alive() {
+	if ( PQstatus( conn ) != CONNECTION_OK ) {
+		return false;
+	}
+	// a connection that's sitting idle has nothing to say unless the server has dropped it, in which
+	// case reading the socket picks up the error or hang up and marks the connection as bad.
+	// That lets us find dead connections without the cost of a round trip
+	pollfd fd;
+	fd.fd = PQsocket( conn );
+	fd.events = POLLIN;
+	fd.revents = 0;
+	if ( poll( &fd, 1, 0 ) > 0 ) {
+		PQconsumeInput( conn );
+		while ( PGnotify *notify = PQnotifies( conn ) ) {
+			PQfreemem( notify );
+		}
 	}
+	return PQstatus( conn ) == CONNECTION_OK;
+}
 
-	sql_queue_mutex.unlock();
+bool
+rdms::clear_cache(){
+	std::vector<connection_pool*> pools = connection_pool::all();
+	for ( unsigned int i = 0; i < pools.size(); ++i ) {
+		pools[i]->clear();
+	}
 	return true;
 }
 
@@ -76,19 +161,27 @@ rdms::exec() {
 	bool ret_val=false;
 	//	std::cout << buffer_.curval() << std::endl;
 
+	if ( batch_ ) {
+		// held back, to be sent along with the rest of the batch
+		return batch_->queue();
+	}
 	if ( ( ! in_trans_ ) || ( ! trans_error_ ) ) {
-		PGresult *res = PQexec( conn,  buffer_.curval().c_str() ) ; //buffer_.curval().c_str() );
+		// from here on reads have to see what we've written, so keep them on this connection
+		wrote_ = true;
+		PGresult *res = this->run( buffer_.c_str(), params_, text_results, cache_statement_ );
+		// the statement may have been a SET that changes how text has to be quoted
+		detail::note_escape_settings( conn );
 		if ( PQresultStatus(res) == PGRES_COMMAND_OK ) {
 			ret_val=true;
 		} else {
-			this->log_error(buffer_.curval(),res);
+			this->log_error(buffer_.c_str(),res);
 			if ( in_trans_ ) {
 				trans_error_ = true;
 			}
 		}
 		PQclear(res);
 	}
-	buffer_.abandon();
+	this->abandon_statement();
 	return ret_val;
 }
 
@@ -186,68 +279,158 @@ rdms::epoch_date(const std::string& field){
 void
 rdms::abandon_statement(){
 	buffer_.abandon();
+	params_.clear();
+	range_param_ = -1;
+	cache_statement_ = false;
+}
+
+rdms&
+rdms::bind( const std::string& value ){
+	params_.push_back( value );
+	(*this) << '$' << params_.size();
+	return *this;
+}
+
+rdms&
+rdms::cache_statement(){
+	cache_statement_ = true;
+	return *this;
 }
 
 std::string
 rdms::single_value() {
 	std::string ret_val;
 
-	PGresult *res = PQexec( conn,  buffer_.curval().c_str() );
+	PGresult *res = this->exec_read( buffer_.c_str(), params_, text_results, cache_statement_ );
 	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) &&  PQnfields(res)  ) {
 		ret_val = PQgetvalue(res, 0, 0);
 	} else {
-		this->log_error(buffer_.curval(),res);
+		this->log_error(buffer_.c_str(),res);
 		if ( in_trans_ ){
 			trans_error_ = true;
 		}
 	}
-	buffer_.abandon();
+	this->abandon_statement();
 	PQclear(res);
 	return ret_val;
 }
 
+// does stmt hold word, in any case, with no letter, digit or underscore either side of it
+static bool
+has_word( const char *stmt, const char *word ) {
+	size_t length = strlen( word );
+	for ( const char *p = stmt; *p; ++p ) {
+		if ( ! strncasecmp( p, word, length )
+		     && ( p == stmt || ! ( isalnum( static_cast<unsigned char>( p[-1] ) ) || '_' == p[-1] ) )
+		     && ! ( isalnum( static_cast<unsigned char>( p[ length ] ) ) || '_' == p[ length ] ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
 std::string
 rdms::insert( const std::string& sequence ){
-		
-	if ( this->exec() && ( ! sequence.empty() ) ) {
+	if ( sequence.empty() ) {
+		this->exec();
+		return std::string();
+	}
+	// a statement with a RETURNING clause of its own can't have another, and one that inserts the rows of a select
+	// could send back any number of them just for the one value.  Those read currval with a select of their own
+	const char *stmt = buffer_.c_str();
+	if ( has_word( stmt, "returning" ) || has_word( stmt, "select" ) ) {
+		if ( ! this->exec() ) {
+			return std::string();
+		}
 		(*this) << "select currval(" << quote( sequence ) << ")";
 		return this->single_value();
-	} else {
-		return std::string();
 	}
+	// currval is evaluated as each row is returned, after its defaults, so the last row has the sequence's final value
+	result_set rows;
+	if ( this->returning( "currval(" + quote( sequence ) + ")", rows ) && rows.size() ) {
+		PGresult *res = rows.res_;
+		return PQgetvalue( res, PQntuples( res ) - 1, 0 );
+	}
+	return std::string();
+}
+
+bool
+rdms::returning( const std::string& columns, result_set& rows, result_format format ){
+	bool ret_val=false;
+
+	if ( ( ! in_trans_ ) || ( ! trans_error_ ) ) {
+		// a write, so like exec() it stays on this connection, as do the reads that follow it
+		wrote_ = true;
+		// a trailing semicolon would leave the clause out on its own
+		buffer_.trim_end();
+		(*this) << " RETURNING " << columns;
+		PGresult *res = this->run( buffer_.c_str(), params_, format, cache_statement_ );
+		if ( PQresultStatus(res) == PGRES_TUPLES_OK ) {
+			ret_val=true;
+		} else {
+			this->log_error(buffer_.c_str(),res);
+			if ( in_trans_ ) {
+				trans_error_ = true;
+			}
+		}
+		rows = result_set( res );
+	}
+	this->abandon_statement();
+	return ret_val;
 }
 
 rdms::~rdms() {
 	PQfinish(conn);
+	pool_->closed();
 }
 
-rdms::rdms() :
+rdms::rdms( connection_pool *pool ) :
 	// seems silly/dangerous to to do this, as output_buffer 
 	// isn't defined yet, but is needed to keep gcc 3.x happy
 	std::ostream( &buffer_ ),
+	pool_( pool ),
 	conn(0),
 	in_trans_(false),
-	trans_error_( false )
+	trans_error_( false ),
+	wrote_( false ),
+	batch_( 0 ),
+	range_param_( -1 ),
+	cache_statement_( false ),
+	next_statement_( 0 )
 {
 	this->rdbuf( &buffer_ );
 	connected_=connect();
+	last_used_ = created_;
+}
+
+rdms::rdms( connection_pool *pool, PGconn *established ) :
+	std::ostream( &buffer_ ),
+	pool_( pool ),
+	conn( established ),
+	in_trans_(false),
+	trans_error_( false ),
+	wrote_( false ),
+	batch_( 0 ),
+	range_param_( -1 ),
+	cache_statement_( false ),
+	connected_( true ),
+	created_( time( NULL ) ),
+	last_used_( created_ ),
+	next_statement_( 0 )
+{
+	this->rdbuf( &buffer_ );
+	detail::note_escape_settings( conn );
 }
 
 rdms*
 rdms::handle() {
-	rdms* ret_val = 0;
-	sql_queue_mutex.lock();
-	if ( bench_warmers.empty() ) {
-		ret_val = new rdms;
-	} else {
-		ret_val = bench_warmers.front();
-		bench_warmers.pop();
-	}
-	sql_queue_mutex.unlock();
-	// do a ping to make sure the handle is still good
-	ret_val->ping();
+	return default_pool()->checkout();
+}
 
-	return ret_val;
+rdms*
+rdms::handle( const std::string& pool_name ) {
+	connection_pool *pool = connection_pool::find( pool_name );
+	return pool ? pool->checkout() : 0;
 }
 
 void
@@ -256,33 +439,182 @@ rdms::release(){
 		this->abort_trans();
 	}
 	this->abandon_statement();
-	sql_queue_mutex.lock();
+	last_used_ = time( NULL );
+	wrote_ = false;
+	pool_->checkin( this );
+}
 
-	if ( bench_warmers.size() && bench_warmers.size() >= max_spare_handles ) {
-		delete bench_warmers.front();
-		bench_warmers.pop();
+// Run a statement that only reads.  If the pool routes reads and nothing has been written through this handle since it
+// was checked out, it runs on a replica, otherwise, or if no replica connection can be had, it runs here.  A replica
+// pool that is at max_connections isn't waited on, the read just runs here instead
+PGresult*
+rdms::exec_read( const char *stmt, const std::vector<std::string>& params, result_format format, bool query_shape ) {
+	connection_pool *replicas = ( in_trans_ || wrote_ ) ? 0 : pool_->read_pool();
+	if ( replicas ) {
+		rdms *replica = replicas->try_checkout();
+		if ( replica && PQstatus( replica->conn ) == CONNECTION_OK ) {
+			PGresult *res = replica->run( stmt, params, format, query_shape );
+			replica->release();
+			return res;
+		} else if ( replica ) {
+			replica->release();
+		}
 	}
+	return this->run( stmt, params, format, query_shape );
+}
 
-	if ( max_spare_handles ) {
-		bench_warmers.push( this );
-	} else {
-		delete this;
+// does stmt hold just the one statement, which is all that can be prepared.  Any semicolon that isn't trailing
+// is taken to separate statements, so one inside a quoted string just costs the statement its place in the cache
+static bool
+single_statement( const char *stmt ) {
+	const char *semicolon = strchr( stmt, ';' );
+	return ! semicolon || strspn( semicolon, " \t\r\n;" ) == strlen( semicolon );
+}
+
+// is stmt one of the statements the server will prepare, rather than something like a create table or a begin
+// that would fail the prepare, and with it any transaction that is open
+static bool
+preparable( const char *stmt ) {
+	static const char *prepared_kinds[] = { "select", "insert", "update", "delete", "values", "with", 0 };
+	stmt += strspn( stmt, " \t\r\n(" );
+	for ( const char **kind = prepared_kinds; *kind; ++kind ) {
+		size_t length = strlen( *kind );
+		if ( ! strncasecmp( stmt, *kind, length ) && ! isalnum( static_cast<unsigned char>( stmt[ length ] ) )
+		     && '_' != stmt[ length ] ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// send stmt as it is, along with the values for its placeholders if it has any
+static PGresult*
+exec_direct( PGconn *conn, const char *stmt, const std::vector<std::string>& params, const char * const *values,
+	     int format ) {
+	if ( params.empty() && ! format ) {
+		return PQexec( conn, stmt );
 	}
+	return PQexecParams( conn, stmt, params.size(), 0, values, 0, 0, format );
+}
+
+// did res fail because a table the prepared statement reads has been altered since it was prepared, changing the
+// columns it gives back.  The server reports this as feature_not_supported
+static bool
+plan_changed( const PGresult *res ) {
+	const char *state = PQresultErrorField( res, PG_DIAG_SQLSTATE );
+	return PQresultStatus( res ) == PGRES_FATAL_ERROR && state && ! strcmp( state, "0A000" );
+}
 
-	sql_queue_mutex.unlock();
+void
+rdms::deallocate( const std::string& name ) {
+	if ( PQTRANS_INERROR == PQtransactionStatus( conn ) ) {
+		// the server would refuse the DEALLOCATE and leave the statement behind, so it waits for the transaction to end
+		stale_statements_.push_back( name );
+		return;
+	}
+	PQclear( PQexec( conn, ( "DEALLOCATE " + name ).c_str() ) );
 }
 
+PGresult*
+rdms::run( const char *stmt, const std::vector<std::string>& params, result_format format, bool query_shape ) {
+	if ( batch_ ) {
+		// along with everything the batch has queued ahead of it, in the one round trip
+		return batch_->read( stmt, params, format );
+	}
+
+	std::vector<const char*> values( params.size() );
+	for ( unsigned int i = 0; i < params.size(); ++i ) {
+		values[i] = params[i].c_str();
+	}
+	const char * const *value_ptrs = values.empty() ? 0 : &values[0];
+
+	if ( ! stale_statements_.empty() && PQTRANS_INERROR != PQtransactionStatus( conn ) ) {
+		std::vector<std::string> stale;
+		stale.swap( stale_statements_ );
+		for ( unsigned int i = 0; i < stale.size(); ++i ) {
+			this->deallocate( stale[i] );
+		}
+	}
+
+	const rdms::pool_options& options = pool_->options();
+	unsigned int limit = options.statement_cache_size;
+	if ( ! limit && query_shape ) {
+		limit = options.query_cache_size;
+	}
+	if ( ! limit || ! single_statement( stmt ) || ! preparable( stmt ) ) {
+		return exec_direct( conn, stmt, params, value_ptrs, format );
+	}
+	// the pool may have been reconfigured with a smaller cache since we last looked
+	while ( statements_.size() > limit ) {
+		std::string evicted = statements_.evict();
+		if ( ! evicted.empty() ) {
+			this->deallocate( evicted );
+		}
+	}
+	std::string *name = statements_.find( stmt );
+	if ( name && ! name->empty() ) {
+		++statements_.hits;
+		PGresult *res = PQexecPrepared( conn, name->c_str(), params.size(), value_ptrs, 0, 0, format );
+		if ( ! plan_changed( res ) || PQTRANS_IDLE != PQtransactionStatus( conn ) ) {
+			return res;
+		}
+		// outside of a transaction the failure has cost nothing, so the old plan is dropped and the statement is
+		// prepared again.  In one, it has aborted the transaction, and that happens once the transaction is over
+		PQclear( res );
+		this->deallocate( *name );
+		name->clear();
+	} else {
+		++statements_.misses;
+	}
+	if ( ! name ) {
+		// a statement that's only ever run the once isn't worth the extra round trip to prepare, nor the room in the
+		// cache, so it's only let in the second time it's run.  One with parameters is a shape that's bound to come
+		// round again, so that is let in and prepared straight away
+		if ( params.empty() && ! statements_.seen_before( stmt, limit ) ) {
+			return exec_direct( conn, stmt, params, value_ptrs, format );
+		}
+		name = &statements_.insert( stmt );
+		// make room, least recently used first
+		while ( statements_.size() > limit ) {
+			std::string evicted = statements_.evict();
+			if ( ! evicted.empty() ) {
+				this->deallocate( evicted );
+			}
+		}
+	}
+	char prepared[32];
+	snprintf( prepared, sizeof( prepared ), "tmplsql_%lu", next_statement_++ );
+	PGresult *res = PQprepare( conn, prepared, stmt, 0, 0 );
+	if ( PQresultStatus( res ) == PGRES_COMMAND_OK ) {
+		PQclear( res );
+		*name = prepared;
+		return PQexecPrepared( conn, name->c_str(), params.size(), value_ptrs, 0, 0, format );
+	}
+	if ( in_trans_ ) {
+		// the failed prepare has aborted the transaction, running the statement can only fail the same way
+		return res;
+	}
+	PQclear( res );
+	return exec_direct( conn, stmt, params, value_ptrs, format );
+}
 
 bool
 rdms::connect() {
 	in_trans_ = false; 
-	conn = PQconnectdb( conn_string.c_str() );
-	if ( PQstatus(conn) == CONNECTION_OK) {
-		connected_=true;
+	// PQfinish is a no-op on 0, and the old connection must be closed rather than leaked when we reconnect
+	PQfinish( conn );
+	// statements prepared on the old connection went with it
+	statements_.clear();
+	stale_statements_.clear();
+	conn = PQconnectdb( pool_->conninfo().c_str() );
+	created_ = time( NULL );
+	connected_ = ( PQstatus(conn) == CONNECTION_OK );
+	if ( connected_ ) {
+		detail::note_escape_settings( conn );
 	} else {
 #ifdef DEBUG
 		std::cerr << "Unable to connect to sql database using conection string: " 
-					  << "    '" << conn_string << "'\n"
+					  << "    '" << pool_->conninfo() << "'\n"
 					  << "Error msg: \n"
 					  << "    " << PQerrorMessage( conn ) 
 					  << std::endl;
@@ -299,28 +631,122 @@ rdms::sql_stmt_buffer::sql_stmt_buffer(){
 
 std::string
 rdms::sql_stmt_buffer::flush(){
-	std::string ret_val = buffer_;
-	buffer_="";
+	std::string ret_val = this->curval();
+	this->abandon();
 	return ret_val;
 }
 
 std::string
-rdms::sql_stmt_buffer::curval(){
-	return buffer_;
+rdms::sql_stmt_buffer::curval() const {
+	return std::string( pbase(), pptr() );
+}
+
+const char*
+rdms::sql_stmt_buffer::c_str(){
+	if ( storage_.empty() ) {
+		return "";
+	}
+	// reserve() always leaves room for this
+	*pptr() = '\0';
+	return pbase();
+}
+
+void
+rdms::sql_stmt_buffer::trim_end(){
+	while ( pptr() > pbase() && strchr( " \t\r\n;", pptr()[-1] ) ) {
+		pbump( -1 );
+	}
+}
+
+std::streamsize
+rdms::sql_stmt_buffer::size() const {
+	return pptr() - pbase();
 }
 
 void
 rdms::sql_stmt_buffer::abandon(){
-	buffer_="";
+	// the memory is kept for the next statement, unless some huge statement has left a lot of it
+	if ( storage_.size() > 1024 * 1024 ) {
+		std::vector<char>().swap( storage_ );
+		setp( 0, 0 );
+	} else {
+		setp( pbase(), epptr() );
+	}
 }
 
+void
+rdms::sql_stmt_buffer::reserve( std::streamsize wanted ){
+	if ( epptr() - pptr() >= wanted ) {
+		return;
+	}
+	std::streamsize used = this->size();
+	std::vector<char>::size_type capacity = std::max<std::vector<char>::size_type>( storage_.size() * 2, 256 );
+	while ( capacity < static_cast<std::vector<char>::size_type>( used + wanted + 1 ) ) {
+		capacity *= 2;
+	}
+	storage_.resize( capacity );
+	setp( &storage_[0], &storage_[0] + capacity - 1 );
+	pbump( used );
+}
 
 int
 rdms::sql_stmt_buffer::overflow(int c) {
-	buffer_ += static_cast<char>(c);
+	if ( traits_type::eq_int_type( c, traits_type::eof() ) ) {
+		return traits_type::not_eof( c );
+	}
+	this->reserve( 1 );
+	*pptr() = traits_type::to_char_type( c );
+	pbump( 1 );
 	return c;
 }
 
+std::streamsize
+rdms::sql_stmt_buffer::xsputn( const char *s, std::streamsize n ) {
+	this->reserve( n );
+	memcpy( pptr(), s, n );
+	pbump( n );
+	return n;
+}
+
+void
+rdms::sql_stmt_buffer::write_quoted( PGconn *conn, const char *text, size_t length ) {
+	this->reserve( length * 2 + 3 );
+	*pptr() = '\'';
+	size_t written = escape_string( conn, pptr() + 1, text, length );
+	pptr()[ written + 1 ] = '\'';
+	pbump( written + 2 );
+}
+
+rdms&
+rdms::write_quoted( const char *text, size_t length ) {
+	// escaped as the connection is set up now, rather than as it was when it was made
+	buffer_.write_quoted( conn, text, length );
+	return *this;
+}
+
+std::ostream&
+operator<<( std::ostream& str, const tmplsql::detail::quoted_text& q ) {
+	if ( rdms *sql = dynamic_cast<rdms*>( &str ) ) {
+		sql->write_quoted( q.text, q.length );
+	} else if ( detail::escape_byte_safe() ) {
+		// escaping a byte at a time, the text can be taken in pieces small enough to escape on the stack
+		char escaped[ 1024 ];
+		str << '\'';
+		for ( size_t done = 0; done < q.length; ) {
+			size_t piece = std::min<size_t>( q.length - done, ( sizeof( escaped ) - 1 ) / 2 );
+			str.write( escaped, escape_string( escaped, q.text + done, piece ) );
+			if ( memchr( q.text + done, '\0', piece ) ) {
+				break;
+			}
+			done += piece;
+		}
+		str << '\'';
+	} else {
+		str << quote( q.text, q.length );
+	}
+	return str;
+}
+
 std::string
 rdms::error_msg(){
 	std::string ret_val = last_error_;
@@ -328,10 +754,21 @@ rdms::error_msg(){
 	return ret_val;	
 }
 
+unsigned long
+rdms::statement_cache_hits() const {
+	return statements_.hits;
+}
+
+unsigned long
+rdms::statement_cache_misses() const {
+	return statements_.misses;
+}
+
 void
-rdms::log_error( const std::string& sqlstmt,const PGresult *res ){
+rdms::log_error( const char *sqlstmt,const PGresult *res ){
 	last_error_ = "Statement: \n";
-	last_error_ += sqlstmt + "\n";
+	last_error_ += sqlstmt;
+	last_error_ += "\n";
 	last_error_ += PQresultErrorMessage(res);
 #ifdef DEBUG
 	std::cerr << "sql statement\n" 
@@ -342,31 +779,123 @@ rdms::log_error( const std::string& sqlstmt,const PGresult *res ){
 }
 
 
+////////////////////////////////// statement cache //////////////////////////////////
+
+rdms::statement_cache::statement_cache() :
+	hits( 0 ),
+	misses( 0 )
+{
+
+}
+
+std::string*
+rdms::statement_cache::find( const std::string& stmt ) {
+	statements_type::iterator it = statements_.find( stmt );
+	if ( statements_.end() == it ) {
+		return 0;
+	}
+	lru_.splice( lru_.begin(), lru_, it->second.second );
+	return &it->second.first;
+}
+
+bool
+rdms::statement_cache::seen_before( const std::string& stmt, unsigned int limit ) {
+	probation_type::iterator it = probation_.find( stmt );
+	if ( probation_.end() != it ) {
+		probation_order_.erase( it->second );
+		probation_.erase( it );
+		return true;
+	}
+	it = probation_.insert( probation_type::value_type( stmt, probation_order_.end() ) ).first;
+	probation_order_.push_front( &it->first );
+	it->second = probation_order_.begin();
+	while ( probation_.size() > limit ) {
+		probation_.erase( *probation_order_.back() );
+		probation_order_.pop_back();
+	}
+	return false;
+}
+
+std::string&
+rdms::statement_cache::insert( const std::string& stmt ) {
+	statements_type::iterator it = statements_.insert( statements_type::value_type( stmt, statements_type::mapped_type() ) ).first;
+	lru_.push_front( &it->first );
+	it->second.second = lru_.begin();
+	return it->second.first;
+}
+
+std::string
+rdms::statement_cache::evict() {
+	std::string ret_val;
+	if ( lru_.size() ) {
+		statements_type::iterator it = statements_.find( *lru_.back() );
+		ret_val = it->second.first;
+		lru_.pop_back();
+		statements_.erase( it );
+	}
+	return ret_val;
+}
+
+unsigned int
+rdms::statement_cache::size() const {
+	return statements_.size();
+}
+
+void
+rdms::statement_cache::clear() {
+	statements_.clear();
+	lru_.clear();
+	probation_.clear();
+	probation_order_.clear();
+}
+
+
 ////////////////////////////////// result set //////////////////////////////////
 
+#ifdef DEBUG
+bool text_ref::check_lifetime = true;
+#else
+bool text_ref::check_lifetime = false;
+#endif
+
 rdms::result_set::result_set( PGresult *res ) :
 	res_(res),
-	count_( new unsigned int(1) ),
+	life_( new detail::result_life ),
+	more_( 0 ),
 	num_rows_( PQntuples(res_) ),
 	num_fields_( PQnfields(res_) )
 {
 
 }
 
+rdms::result_set::result_set( const std::vector<PGresult*>& parts ) :
+	res_( parts[0] ),
+	life_( new detail::result_life ),
+	more_( parts.size() > 1 ? new std::vector<PGresult*>( parts.begin() + 1, parts.end() ) : 0 ),
+	num_rows_( 0 ),
+	num_fields_( PQnfields(res_) )
+{
+	for ( unsigned int i = 0; i < parts.size(); ++i ) {
+		num_rows_ += PQntuples( parts[i] );
+	}
+}
+
 
 rdms::result_set::result_set( const result_set& rs ) :
 	res_(rs.res_),
-	count_( rs.count_ ),
+	life_( rs.life_ ),
+	more_( rs.more_ ),
 	num_rows_( rs.num_rows_ ),
 	num_fields_( rs.num_fields_ )
 {
-	++*count_;
+	++life_->results;
 }
 
 
 rdms::result_set::result_set() :
 	res_( 0 ),
-	count_( new unsigned int(1) ),
+	life_( new detail::result_life ),
+	more_( 0 ),
 	num_rows_(-1),
 	num_fields_(-1)
 {
@@ -386,13 +915,11 @@ rdms::result_set::num_rows(){
 rdms::result_set
 rdms::result_set::operator=( const result_set& rs ){
 	if ( this != &rs ) {
-		if ( 0 == --*count_ ) {
-			PQclear(res_);	
-			delete count_;
-		}
+		++rs.life_->results;
+		this->release();
 		res_ = rs.res_;
-		count_ = rs.count_;
-		++*count_;
+		life_ = rs.life_;
+		more_ = rs.more_;
 		num_rows_= rs.num_rows_;
 		num_fields_ = rs.num_fields_;
         }
@@ -400,10 +927,25 @@ rdms::result_set::operator=( const result_set& rs ){
 }
 
 rdms::result_set::~result_set(){
-	if (count_ && 0 == --(*count_) ) {
-		delete count_;
+	this->release();
+}
+
+void
+rdms::result_set::release(){
+	if ( life_ && 0 == --life_->results ) {
 		PQclear(res_);
+		if ( more_ ) {
+			for ( unsigned int i = 0; i < more_->size(); ++i ) {
+				PQclear( (*more_)[i] );
+			}
+			delete more_;
+		}
+		// text_refs still pointing in to the results hold on to life_, so as to tell they're gone
+		if ( ! life_->views ) {
+			delete life_;
+		}
 	}
+	life_ = 0;
 }
 
 const
@@ -416,18 +958,30 @@ rdms::result_set::size() {
 	}
 }
 
+unsigned int
+rdms::result_set::parts() const {
+	return more_ ? 1 + more_->size() : 1;
+}
+
+PGresult*
+rdms::result_set::part( unsigned int index ) const {
+	return index ? (*more_)[ index - 1 ] : res_;
+}
+
 rdms::result_set::rows_iterator
 rdms::result_set::begin(){
 	if  ( num_rows_ != -1 ) {
-		return rows_iterator( res_,0,num_fields_ );
+		rows_iterator ret_val( res_,0,num_fields_,life_,more_ );
+		ret_val.skip_parts();
+		return ret_val;
 	} else {
-		return rows_iterator( res_,num_rows_,num_fields_ );
+		return rows_iterator( res_,num_rows_,num_fields_,life_ );
 	}
 }
 
 rdms::result_set::rows_iterator
 rdms::result_set::end(){
-	return rows_iterator( res_,num_rows_,num_fields_ );
+	return rows_iterator( res_,num_rows_,num_fields_,life_ );
 }
 
 
@@ -437,15 +991,25 @@ rdms::result_set::end(){
 
 rdms::result_set::rows_iterator::rows_iterator() :
 	x_index_( -1 ),
-	y_index_( -1 )
+	res_( 0 ),
+	life_( 0 ),
+	y_index_( -1 ),
+	row_( -1 ),
+	more_( 0 ),
+	next_part_( 0 )
 {
 
 }
 
-rdms::result_set::rows_iterator::rows_iterator( PGresult *res, int x_index, int y_index) :
+rdms::result_set::rows_iterator::rows_iterator( PGresult *res, int x_index, int y_index, detail::result_life *life,
+						  const std::vector<PGresult*> *more ) :
 	x_index_( x_index ),
 	res_(res),
-	y_index_( y_index )
+	life_( life ),
+	y_index_( y_index ),
+	row_( x_index ),
+	more_( more ),
+	next_part_( 0 )
 {
 
 }
@@ -453,7 +1017,11 @@ rdms::result_set::rows_iterator::rows_iterator( PGresult *res, int x_index, int
 rdms::result_set::rows_iterator::rows_iterator( const rows_iterator& ri )  :
 	x_index_( ri.x_index_ ),
 	res_( ri.res_ ),
-	y_index_( ri.y_index_ ) 
+	life_( ri.life_ ),
+	y_index_( ri.y_index_ ),
+	row_( ri.row_ ),
+	more_( ri.more_ ),
+	next_part_( ri.next_part_ )
 {
 
 
@@ -464,6 +1032,10 @@ rdms::result_set::rows_iterator::operator=( const rows_iterator& ri ){
 	x_index_ = ri.x_index_;
 	y_index_ = ri.y_index_;
 	res_ = ri.res_;
+	life_ = ri.life_;
+	row_ = ri.row_;
+	more_ = ri.more_;
+	next_part_ = ri.next_part_;
 	return ri;
 }
 
@@ -482,31 +1054,61 @@ rdms::result_set::rows_iterator::operator==( const rows_iterator& ri ) const {
 rdms::result_set::rows_iterator
 rdms::result_set::rows_iterator::operator++(int) {
 	rows_iterator tmp(*this);
-	++x_index_;
+	++(*this);
 	return tmp;
 }
 
 rdms::result_set::rows_iterator
 rdms::result_set::rows_iterator::operator++() {
 	++x_index_;
+	++row_;
+	this->skip_parts();
 	return *this;
 }
 
+void
+rdms::result_set::rows_iterator::skip_parts() {
+	while ( more_ && next_part_ < more_->size() && row_ >= PQntuples( res_ ) ) {
+		res_ = (*more_)[ next_part_++ ];
+		row_ = 0;
+	}
+}
+
 const char*
 rdms::result_set::rows_iterator::operator[] ( int index ) const {
-	return PQgetvalue(res_, x_index_, index );
+	return PQgetvalue(res_, row_, index );
+}
+
+int
+rdms::result_set::rows_iterator::length( int index ) const {
+	return PQgetlength( res_, row_, index );
+}
+
+bool
+rdms::result_set::rows_iterator::is_null( int index ) const {
+	return PQgetisnull( res_, row_, index );
+}
+
+bool
+rdms::result_set::rows_iterator::binary( int index ) const {
+	return 1 == PQfformat( res_, index );
+}
+
+Oid
+rdms::result_set::rows_iterator::type( int index ) const {
+	return PQftype( res_, index );
 }
 
 
 rdms::result_set::fields_iterator
 rdms::result_set::rows_iterator::begin(){
-	return fields_iterator( res_, x_index_,0 );
+	return fields_iterator( res_, row_,0 );
 }
 
 
 rdms::result_set::fields_iterator
 rdms::result_set::rows_iterator::end(){
-	return fields_iterator( res_, x_index_,y_index_ );
+	return fields_iterator( res_, row_,y_index_ );
 }
 
 ///////////////////////////// fields iterator /////////////////////////////////////////
@@ -576,19 +1178,1082 @@ rdms::result_set::fields_iterator::operator*() const{
 }
 
 rdms::result_set
-rdms::select(){
-	PGresult *res = PQexec( conn,  buffer_.curval().c_str() );
+rdms::select( result_format format ){
+	PGresult *res = this->exec_read( buffer_.c_str(), params_, format, cache_statement_ );
 	if ( PQresultStatus(res) != PGRES_TUPLES_OK ) {
-		this->log_error(buffer_.curval(),res);
+		this->log_error(buffer_.c_str(),res);
 		if ( in_trans_ ) {
 			trans_error_ = true;
 		}
 	}
-	buffer_.abandon();
+	this->abandon_statement();
 	return result_set( res );
 }
 
 
+///////////////////////////// pipeline /////////////////////////////////////////
+
+rdms::pipeline::pipeline( rdms& sql ) :
+	sql_( sql )
+{
+
+}
+
+void
+rdms::pipeline::add() {
+	if ( queued_.empty() ) {
+		// starting a new batch
+		results_.clear();
+	}
+	statement stmt;
+	stmt.text = sql_.buffer_.curval();
+	stmt.params = sql_.params_;
+	queued_.push_back( stmt );
+	sql_.abandon_statement();
+}
+
+unsigned int
+rdms::pipeline::size() const {
+	return queued_.empty() ? results_.size() : queued_.size();
+}
+
+bool
+rdms::pipeline::ok( unsigned int index ) const {
+	if ( index >= results_.size() ) {
+		return false;
+	}
+	ExecStatusType status = PQresultStatus( results_[ index ].res_ );
+	return PGRES_COMMAND_OK == status || PGRES_TUPLES_OK == status;
+}
+
+rdms::result_set
+rdms::pipeline::rows( unsigned int index ) const {
+	return index < results_.size() ? results_[ index ] : result_set();
+}
+
+std::string
+rdms::pipeline::error_msg( unsigned int index ) const {
+	if ( index >= results_.size() || this->ok( index ) ) {
+		return std::string();
+	}
+	std::string ret_val = PQresultErrorMessage( results_[ index ].res_ );
+	if ( ret_val.empty() ) {
+		ret_val = "not run, as an earlier statement failed";
+	}
+	return ret_val;
+}
+
+#ifdef HAVE_PQENTERPIPELINEMODE
+// take conn out of pipeline mode.  If a batch wasn't all sent, or its results weren't all read, whatever did go out
+// is ended with a sync if it hasn't been already, and everything up to the sync is read and thrown away first.
+// Returns false if the connection couldn't be got back out of pipeline mode
+static bool
+leave_pipeline( PGconn *conn, bool synced, bool drained ) {
+	if ( ! drained ) {
+		PQsetnonblocking( conn, 0 );
+		synced = synced || PQpipelineSync( conn );
+		if ( synced && 0 == PQflush( conn ) ) {
+			// a null ends each statement's results, so two in a row mean there's nothing more coming
+			bool ended = false;
+			while ( PQstatus( conn ) == CONNECTION_OK ) {
+				PGresult *res = PQgetResult( conn );
+				if ( ! res ) {
+					if ( ended ) {
+						break;
+					}
+					ended = true;
+					continue;
+				}
+				ended = false;
+				ExecStatusType status = PQresultStatus( res );
+				PQclear( res );
+				if ( PGRES_PIPELINE_SYNC == status ) {
+					break;
+				}
+			}
+		}
+	}
+	return PQexitPipelineMode( conn ) && PQstatus( conn ) == CONNECTION_OK;
+}
+#endif
+
+bool
+rdms::pipeline::run() {
+	sql_.flush_batch();
+	results_.clear();
+	if ( queued_.empty() ) {
+		return true;
+	}
+	PGconn *conn = sql_.conn;
+	sql_.wrote_ = true;
+
+	// a failed transaction won't run anything, so there's no sense sending it
+	bool failed = sql_.in_trans_ && sql_.trans_error_;
+
+#ifdef HAVE_PQENTERPIPELINEMODE
+	bool entered = ! failed && PQenterPipelineMode( conn );
+	bool sent = entered;
+	bool synced = false;
+	if ( sent ) {
+		PQsetnonblocking( conn, 1 );
+		for ( unsigned int i = 0; sent && i < queued_.size(); ++i ) {
+			const std::vector<std::string>& params = queued_[i].params;
+			std::vector<const char*> values( params.size() );
+			for ( unsigned int p = 0; p < params.size(); ++p ) {
+				values[p] = params[p].c_str();
+			}
+			sent = PQsendQueryParams( conn, queued_[i].text.c_str(), params.size(), 0,
+						  values.empty() ? 0 : &values[0], 0, 0, queued_[i].format );
+		}
+		synced = sent && PQpipelineSync( conn );
+		sent = synced;
+		// push everything out, reading as we go so that the server is never left unable to send us results
+		// while we're unable to send it statements
+		while ( sent ) {
+			int unflushed = PQflush( conn );
+			if ( unflushed <= 0 ) {
+				sent = ( 0 == unflushed );
+				break;
+			}
+			pollfd fd;
+			fd.fd = PQsocket( conn );
+			fd.events = POLLIN | POLLOUT;
+			fd.revents = 0;
+			if ( poll( &fd, 1, -1 ) < 0 && errno != EINTR ) {
+				sent = false;
+			} else if ( ( fd.revents & POLLIN ) && ! PQconsumeInput( conn ) ) {
+				sent = false;
+			}
+		}
+		PQsetnonblocking( conn, 0 );
+	}
+	for ( unsigned int i = 0; i < queued_.size(); ++i ) {
+		PGresult *res = sent ? PQgetResult( conn ) : 0;
+		if ( res ) {
+			// each statement's results end with a null
+			while ( PGresult *extra = PQgetResult( conn ) ) {
+				PQclear( extra );
+			}
+		} else {
+			// with the connection's error, unless we never tried
+			res = PQmakeEmptyPGresult( failed ? 0 : conn, PGRES_FATAL_ERROR );
+		}
+		results_.push_back( result_set( res ) );
+	}
+	if ( sent ) {
+		// and the whole batch with the sync
+		while ( PGresult *res = PQgetResult( conn ) ) {
+			ExecStatusType status = PQresultStatus( res );
+			PQclear( res );
+			if ( PGRES_PIPELINE_SYNC == status ) {
+				break;
+			}
+		}
+	}
+	if ( entered && ! leave_pipeline( conn, synced, sent ) ) {
+		// whatever was sent is still owed to us, and would be read as the results of the next statement
+		sql_.connect();
+	}
+#else
+	// run them one by one, giving them the same all or nothing behaviour they'd have in a pipeline
+	bool implicit = ! sql_.in_trans_;
+	PGresult *begin = 0;
+	if ( implicit ) {
+		begin = PQexec( conn, "BEGIN TRANSACTION" );
+		failed = ( PQresultStatus( begin ) != PGRES_COMMAND_OK );
+		if ( ! begin ) {
+			begin = PQmakeEmptyPGresult( conn, PGRES_FATAL_ERROR );
+		}
+	}
+	for ( unsigned int i = 0; i < queued_.size(); ++i ) {
+		PGresult *res = 0;
+		if ( failed && begin ) {
+			// the first statement takes the blame for BEGIN failing
+			res = begin;
+			begin = 0;
+		} else if ( failed ) {
+			res = PQmakeEmptyPGresult( 0, PGRES_FATAL_ERROR );
+		} else {
+			res = sql_.run( queued_[i].text.c_str(), queued_[i].params, queued_[i].format );
+			ExecStatusType status = PQresultStatus( res );
+			failed = ( PGRES_COMMAND_OK != status && PGRES_TUPLES_OK != status );
+		}
+		results_.push_back( result_set( res ) );
+	}
+	PQclear( begin );
+	if ( implicit ) {
+		PQclear( PQexec( conn, failed ? "ABORT TRANSACTION" : "COMMIT TRANSACTION" ) );
+	}
+#endif // HAVE_PQENTERPIPELINEMODE
+
+	bool ret_val = true;
+	for ( unsigned int i = 0; i < results_.size(); ++i ) {
+		if ( ! this->ok( i ) ) {
+			if ( ret_val ) {
+				sql_.log_error( queued_[i].text.c_str(), results_[i].res_ );
+			}
+			ret_val = false;
+		}
+	}
+	if ( ! ret_val && sql_.in_trans_ ) {
+		sql_.trans_error_ = true;
+	}
+	queued_.clear();
+	return ret_val;
+}
+
+PGresult*
+rdms::pipeline::take( unsigned int index ) {
+	PGresult *ret_val = results_[ index ].res_;
+	// the result_set is left empty, and PQclear does nothing with 0
+	results_[ index ].res_ = 0;
+	return ret_val;
+}
+
+
+///////////////////////////// batch /////////////////////////////////////////
+
+void
+rdms::flush_batch() {
+	if ( batch_ ) {
+		batch_->flush();
+	}
+}
+
+rdms::batch::batch( rdms& sql ) :
+	sql_( sql ),
+	pipeline_( sql ),
+	active_( ! sql.in_trans_ && ! sql.batch_ ),
+	begun_( false )
+{
+	if ( active_ ) {
+		sql_.batch_ = this;
+		// reads must see the batch's writes, so they stay on this connection
+		sql_.wrote_ = true;
+	}
+}
+
+rdms::batch::~batch() {
+	this->abort();
+}
+
+bool
+rdms::batch::queue() {
+	if ( begun_ && sql_.trans_error_ ) {
+		// the transaction has already failed, so it would never run
+		sql_.abandon_statement();
+		ok_.push_back( false );
+		errors_.push_back( "not run, as an earlier statement failed" );
+		return false;
+	}
+	pipeline_.add();
+	return true;
+}
+
+void
+rdms::batch::flush() {
+	if ( ! begun_ || ! pipeline_.queued_.empty() ) {
+		this->send( ! begun_, false );
+	}
+}
+
+PGresult*
+rdms::batch::read( const char *stmt, const std::vector<std::string>& params, result_format format ) {
+	pipeline::statement read;
+	read.text = stmt;
+	read.params = params;
+	read.format = format;
+	pipeline_.queued_.push_back( read );
+	this->send( ! begun_, false, true );
+	return pipeline_.take( pipeline_.size() - 1 );
+}
+
+bool
+rdms::batch::send( bool begin, bool commit, bool reading ) {
+	std::vector<pipeline::statement>& queued = pipeline_.queued_;
+	unsigned int statements = queued.size() - ( reading ? 1 : 0 );
+	pipeline::statement control;
+	if ( begin ) {
+		control.text = "BEGIN TRANSACTION";
+		queued.insert( queued.begin(), control );
+	}
+	if ( commit ) {
+		control.text = "COMMIT TRANSACTION";
+		queued.push_back( control );
+	}
+	// from here on the handle is in a transaction, which also keeps the pipeline from wrapping the batch in one of its own
+	sql_.in_trans_ = true;
+	begun_ = true;
+	// the pipeline runs its statements through the handle, which mustn't send them back here
+	sql_.batch_ = 0;
+	bool ret_val = pipeline_.run();
+	sql_.batch_ = this;
+
+	unsigned int first = begin ? 1 : 0;
+	for ( unsigned int i = first; i < first + statements; ++i ) {
+		ok_.push_back( pipeline_.ok( i ) );
+		errors_.push_back( pipeline_.error_msg( i ) );
+	}
+	return ret_val;
+}
+
+bool
+rdms::batch::commit() {
+	if ( ! active_ ) {
+		// part of a transaction begun elsewhere, which is left to commit it
+		return ! sql_.trans_error_;
+	}
+	bool ret_val = false;
+	if ( begun_ && sql_.trans_error_ ) {
+		this->abort();
+		return false;
+	} else if ( ! begun_ && pipeline_.queued_.empty() ) {
+		ret_val = true;
+	} else {
+		ret_val = this->send( ! begun_, true );
+		if ( ret_val ) {
+			sql_.in_trans_ = sql_.trans_error_ = false;
+		} else {
+			// the statements after a failure, COMMIT included, are skipped, leaving the transaction open
+			sql_.abort_trans();
+		}
+	}
+	sql_.batch_ = 0;
+	active_ = false;
+	return ret_val;
+}
+
+void
+rdms::batch::abort() {
+	if ( ! active_ ) {
+		return;
+	}
+	for ( unsigned int i = 0; i < pipeline_.queued_.size(); ++i ) {
+		ok_.push_back( false );
+		errors_.push_back( "not run, as the batch was aborted" );
+	}
+	pipeline_.queued_.clear();
+	if ( begun_ ) {
+		sql_.abort_trans();
+	}
+	sql_.batch_ = 0;
+	active_ = false;
+}
+
+unsigned int
+rdms::batch::size() const {
+	return ok_.size() + pipeline_.queued_.size();
+}
+
+bool
+rdms::batch::ok( unsigned int index ) const {
+	return index < ok_.size() && ok_[ index ];
+}
+
+std::string
+rdms::batch::error_msg( unsigned int index ) const {
+	return index < errors_.size() ? errors_[ index ] : std::string();
+}
+
+
+///////////////////////////// parallel select /////////////////////////////////////
+
+// the highest tid there can be, so the last worker reads to the end of the table however it has grown
+static const char * const last_page = "(4294967295,0)";
+
+rdms&
+rdms::page_range( const std::string& table ){
+	range_table_ = table;
+	range_param_ = params_.size();
+	(*this) << table << ".ctid >= ";
+	this->bind( "(0,0)" );
+	(*this) << "::tid and " << table << ".ctid < ";
+	this->bind( last_page );
+	(*this) << "::tid";
+	return *this;
+}
+
+rdms::result_set
+rdms::select_parallel( unsigned int workers, result_format format ){
+	this->flush_batch();
+	if ( workers < 2 || range_param_ < 0 || in_trans_ ) {
+		return this->select( format );
+	}
+	std::string stmt = buffer_.curval();
+	std::vector<std::string> params( params_ );
+	std::string table = range_table_;
+	unsigned int range = range_param_;
+	this->abandon_statement();
+
+	// export a snapshot, and see how big the table is from it
+	std::string snapshot;
+	unsigned long pages = 0;
+	PGresult *res = PQexec( conn, "BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ READ ONLY" );
+	in_trans_ = ( PGRES_COMMAND_OK == PQresultStatus( res ) );
+	PQclear( res );
+	if ( in_trans_ ) {
+		const char *values[1] = { table.c_str() };
+		res = PQexecParams( conn, "select pg_export_snapshot(), pg_relation_size( $1::regclass ) / current_setting( 'block_size' )::bigint",
+				    1, 0, values, 0, 0, 0 );
+		if ( PGRES_TUPLES_OK == PQresultStatus( res ) && PQntuples( res ) && 2 == PQnfields( res ) ) {
+			snapshot = PQgetvalue( res, 0, 0 );
+			pages = strtoul( PQgetvalue( res, 0, 1 ), 0, 10 );
+		} else {
+			this->log_error( "pg_export_snapshot", res );
+		}
+		PQclear( res );
+	}
+
+	// and have the other workers read from it too.  There's no sense in having more workers than pages
+	std::vector<rdms*> workers_used( 1, this );
+	std::string import = "BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ READ ONLY; SET TRANSACTION SNAPSHOT " + quote( snapshot );
+	// Workers are only taken if they can be had straight away: waiting for one while holding this connection would
+	// deadlock a pool that every connection of was doing the same, so with fewer to be had fewer are used
+	while ( ! snapshot.empty() && workers_used.size() < workers && workers_used.size() < pages ) {
+		rdms *worker = pool_->try_checkout();
+		if ( ! worker ) {
+			break;
+		}
+		res = PQexec( worker->conn, import.c_str() );
+		bool joined = ( PGRES_COMMAND_OK == PQresultStatus( res ) );
+		PQclear( res );
+		// so that release() rolls it back, whether or not it got as far as the snapshot
+		worker->in_trans_ = true;
+		if ( ! joined ) {
+			worker->release();
+			break;
+		}
+		workers_used.push_back( worker );
+	}
+
+	std::vector<PGresult*> parts;
+	if ( workers_used.size() < 2 ) {
+		// it couldn't be split, so read it all from here
+		parts.push_back( this->run( stmt.c_str(), params, format ) );
+	} else {
+		unsigned int sent = 0;
+		for ( ; sent < workers_used.size(); ++sent ) {
+			char bound[32];
+			snprintf( bound, sizeof( bound ), "(%lu,0)", pages * sent / workers_used.size() );
+			params[ range ] = bound;
+			snprintf( bound, sizeof( bound ), "(%lu,0)", pages * ( sent + 1 ) / workers_used.size() );
+			params[ range + 1 ] = ( sent + 1 == workers_used.size() ) ? last_page : bound;
+			std::vector<const char*> values( params.size() );
+			for ( unsigned int i = 0; i < params.size(); ++i ) {
+				values[i] = params[i].c_str();
+			}
+			if ( ! PQsendQueryParams( workers_used[ sent ]->conn, stmt.c_str(), params.size(), 0, &values[0], 0, 0, format ) ) {
+				break;
+			}
+		}
+		// every worker is reading now, so collect what they've read
+		for ( unsigned int i = 0; i < workers_used.size(); ++i ) {
+			PGconn *c = workers_used[i]->conn;
+			res = ( i < sent ) ? PQgetResult( c ) : 0;
+			if ( ! res ) {
+				res = PQmakeEmptyPGresult( c, PGRES_FATAL_ERROR );
+			}
+			while ( PGresult *extra = ( i < sent ) ? PQgetResult( c ) : 0 ) {
+				PQclear( extra );
+			}
+			parts.push_back( res );
+		}
+	}
+	for ( unsigned int i = 1; i < workers_used.size(); ++i ) {
+		workers_used[i]->release();
+	}
+	this->abort_trans();
+
+	for ( unsigned int i = 0; i < parts.size(); ++i ) {
+		if ( PGRES_TUPLES_OK != PQresultStatus( parts[i] ) ) {
+			this->log_error( stmt.c_str(), parts[i] );
+			for ( unsigned int j = 0; j < parts.size(); ++j ) {
+				if ( j != i ) {
+					PQclear( parts[j] );
+				}
+			}
+			return result_set( parts[i] );
+		}
+	}
+	return result_set( parts );
+}
+
+
+///////////////////////////// result_stream /////////////////////////////////////
+
+rdms::result_stream::result_stream( rdms& sql, result_format format, int chunk_rows ) :
+	sql_( sql ),
+	statement_( sql.buffer_.curval() ),
+	done_( false ),
+	ok_( false )
+{
+	PGconn *conn = sql_.conn;
+	// abandoning the statement clears the values bound to it, so ours are a copy
+	std::vector<std::string> params( sql_.params_ );
+	std::vector<const char*> values( params.size() );
+	for ( unsigned int i = 0; i < params.size(); ++i ) {
+		values[i] = params[i].c_str();
+	}
+	sql_.abandon_statement();
+	sql_.flush_batch();
+
+	if ( ! ( sql_.in_trans_ && sql_.trans_error_ ) ) {
+		if ( values.empty() && text_results == format ) {
+			ok_ = PQsendQuery( conn, statement_.c_str() );
+		} else {
+			ok_ = PQsendQueryParams( conn, statement_.c_str(), values.size(), 0,
+						 values.empty() ? 0 : &values[0], 0, 0, format );
+		}
+	}
+	if ( ! ok_ ) {
+		done_ = true;
+		PGresult *res = PQmakeEmptyPGresult( conn, PGRES_FATAL_ERROR );
+		sql_.log_error( statement_.c_str(), res );
+		PQclear( res );
+		if ( sql_.in_trans_ ) {
+			sql_.trans_error_ = true;
+		}
+		return;
+	}
+#ifdef HAVE_PQSETCHUNKEDROWSMODE
+	if ( chunk_rows > 1 && PQsetChunkedRowsMode( conn, chunk_rows ) ) {
+		return;
+	}
+#else
+	// libpq before 17 can only hand rows over one at a time
+	(void) chunk_rows;
+#endif
+	PQsetSingleRowMode( conn );
+}
+
+bool
+rdms::result_stream::next( result_set& rows ) {
+	while ( ! done_ ) {
+		PGresult *res = PQgetResult( sql_.conn );
+		if ( ! res ) {
+			done_ = true;
+			break;
+		}
+		switch ( PQresultStatus( res ) ) {
+		case PGRES_SINGLE_TUPLE:
+#ifdef HAVE_PQSETCHUNKEDROWSMODE
+		case PGRES_TUPLES_CHUNK:
+#endif
+			rows = result_set( res );
+			return true;
+		case PGRES_TUPLES_OK:
+			// the end of the rows, which is empty unless the row mode couldn't be set
+			if ( PQntuples( res ) ) {
+				rows = result_set( res );
+				return true;
+			}
+			PQclear( res );
+			break;
+		case PGRES_COMMAND_OK:
+			PQclear( res );
+			break;
+		default:
+			sql_.log_error( statement_.c_str(), res );
+			PQclear( res );
+			ok_ = false;
+			if ( sql_.in_trans_ ) {
+				sql_.trans_error_ = true;
+			}
+			break;
+		}
+	}
+	return false;
+}
+
+bool
+rdms::result_stream::ok() const {
+	return ok_;
+}
+
+void
+rdms::result_stream::finish() {
+	if ( done_ ) {
+		return;
+	}
+	// outside a transaction there's nothing to lose by telling the server not to bother
+	// with the rest of the rows.  Inside one, cancelling would abort the whole transaction
+	if ( ! sql_.in_trans_ ) {
+		if ( PGcancel *cancel = PQgetCancel( sql_.conn ) ) {
+			char err[ 256 ];
+			PQcancel( cancel, err, sizeof( err ) );
+			PQfreeCancel( cancel );
+		}
+	}
+	while ( PGresult *res = PQgetResult( sql_.conn ) ) {
+		PQclear( res );
+	}
+	done_ = true;
+}
+
+rdms::result_stream::~result_stream() {
+	this->finish();
+}
+
+
+///////////////////////////// cursor /////////////////////////////////////////
+
+rdms::cursor::cursor( rdms& sql, int fetch_size, result_format format ) :
+	sql_( sql ),
+	format_( format ),
+	fetch_size_( fetch_size > 0 ? fetch_size : 1 ),
+	own_trans_( false ),
+	pending_( false ),
+	ok_( false )
+{
+	std::string query = sql_.buffer_.curval();
+	std::vector<std::string> params( sql_.params_ );
+	sql_.abandon_statement();
+	sql_.flush_batch();
+
+	char name[32];
+	snprintf( name, sizeof( name ), "tmplsql_cursor_%lu", sql_.next_statement_++ );
+	name_ = name;
+	std::ostringstream fetch;
+	fetch << "FETCH FORWARD " << fetch_size_ << " FROM " << name_;
+	fetch_ = fetch.str();
+
+	// a cursor only lives as long as the transaction it's declared in
+	if ( ! sql_.in_trans_ ) {
+		if ( ! sql_.begin_trans() ) {
+			return;
+		}
+		own_trans_ = true;
+	} else if ( sql_.trans_error_ ) {
+		return;
+	}
+	std::vector<const char*> values( params.size() );
+	for ( unsigned int i = 0; i < params.size(); ++i ) {
+		values[i] = params[i].c_str();
+	}
+	std::string declare = "DECLARE " + name_ + " NO SCROLL CURSOR FOR " + query;
+	// not through run(), there's no point preparing a statement that names a cursor that will only be declared once
+	PGresult *res = exec_direct( sql_.conn, declare.c_str(), params, values.empty() ? 0 : &values[0], 0 );
+	if ( PQresultStatus( res ) != PGRES_COMMAND_OK ) {
+		this->failed( declare, res );
+		return;
+	}
+	PQclear( res );
+	ok_ = true;
+	this->send_fetch();
+}
+
+void
+rdms::cursor::send_fetch() {
+	pending_ = PQsendQueryParams( sql_.conn, fetch_.c_str(), 0, 0, 0, 0, 0, format_ );
+	if ( ! pending_ ) {
+		this->failed( fetch_, PQmakeEmptyPGresult( sql_.conn, PGRES_FATAL_ERROR ) );
+	}
+}
+
+PGresult*
+rdms::cursor::receive() {
+	pending_ = false;
+	PGresult *res = PQgetResult( sql_.conn );
+	while ( PGresult *extra = PQgetResult( sql_.conn ) ) {
+		PQclear( extra );
+	}
+	return res;
+}
+
+void
+rdms::cursor::failed( const std::string& stmt, PGresult *res ) {
+	sql_.log_error( stmt.c_str(), res );
+	PQclear( res );
+	ok_ = false;
+	if ( sql_.in_trans_ ) {
+		sql_.trans_error_ = true;
+	}
+}
+
+bool
+rdms::cursor::next( result_set& rows ) {
+	if ( ! pending_ ) {
+		return false;
+	}
+	PGresult *res = this->receive();
+	if ( PQresultStatus( res ) != PGRES_TUPLES_OK ) {
+		this->failed( fetch_, res );
+		return false;
+	}
+	int num_rows = PQntuples( res );
+	// a short batch is the last one
+	if ( num_rows == fetch_size_ ) {
+		this->send_fetch();
+	}
+	rows = result_set( res );
+	return num_rows > 0;
+}
+
+bool
+rdms::cursor::ok() const {
+	return ok_;
+}
+
+rdms::cursor::~cursor() {
+	if ( pending_ ) {
+		PQclear( this->receive() );
+	}
+	if ( own_trans_ ) {
+		// which closes the cursor along with it
+		sql_.commit_trans();
+	} else if ( ok_ ) {
+		PQclear( PQexec( sql_.conn, ( "CLOSE " + name_ ).c_str() ) );
+	}
+}
+
+
+///////////////////////////// copy_in /////////////////////////////////////////
+
+rdms::copy_in::copy_in( rdms& sql, const std::string& table, result_format format, int buffer_size ) :
+	sql_( sql ),
+	statement_( "COPY " + table + " FROM STDIN" ),
+	format_( format ),
+	buffer_size_( buffer_size > 0 ? buffer_size : 1 ),
+	rows_( 0 ),
+	copying_( false ),
+	ok_( false )
+{
+	if ( binary_results == format_ ) {
+		statement_ += " WITH ( FORMAT binary )";
+	}
+	sql_.flush_batch();
+	buffer_.reserve( buffer_size_ + buffer_size_ / 4 );
+	if ( sql_.in_trans_ && sql_.trans_error_ ) {
+		return;
+	}
+	sql_.wrote_ = true;
+	PGresult *res = PQexec( sql_.conn, statement_.c_str() );
+	if ( PQresultStatus( res ) != PGRES_COPY_IN ) {
+		this->failed( res );
+		return;
+	}
+	PQclear( res );
+	copying_ = ok_ = true;
+	if ( binary_results == format_ ) {
+		// signature, flags and the length of the (empty) header extension
+		static const char header[] = "PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0";
+		buffer_.append( header, sizeof( header ) - 1 );
+	}
+}
+
+std::string&
+rdms::copy_in::buffer() {
+	return buffer_;
+}
+
+bool
+rdms::copy_in::flush() {
+	if ( ok_ && ! buffer_.empty() && PQputCopyData( sql_.conn, buffer_.data(), buffer_.size() ) != 1 ) {
+		this->failed( PQmakeEmptyPGresult( sql_.conn, PGRES_FATAL_ERROR ) );
+	}
+	buffer_.clear();
+	return ok_;
+}
+
+bool
+rdms::copy_in::row_done() {
+	if ( buffer_.size() < buffer_size_ ) {
+		return ok_;
+	}
+	return this->flush();
+}
+
+bool
+rdms::copy_in::finish() {
+	if ( ! copying_ ) {
+		return false;
+	}
+	if ( binary_results == format_ ) {
+		// the trailer, a row of -1 columns
+		buffer_.append( 2, '\377' );
+	}
+	this->flush();
+	copying_ = false;
+	// the server only tells us whether the rows were any good once they're all in
+	if ( PQputCopyEnd( sql_.conn, ok_ ? 0 : "client error" ) != 1 ) {
+		this->failed( PQmakeEmptyPGresult( sql_.conn, PGRES_FATAL_ERROR ) );
+	}
+	PGresult *res = PQgetResult( sql_.conn );
+	while ( PGresult *extra = PQgetResult( sql_.conn ) ) {
+		PQclear( extra );
+	}
+	if ( PQresultStatus( res ) != PGRES_COMMAND_OK ) {
+		if ( ok_ ) {
+			this->failed( res );
+		} else {
+			PQclear( res );
+		}
+		return false;
+	}
+	rows_ = strtoul( PQcmdTuples( res ), 0, 10 );
+	PQclear( res );
+	return ok_;
+}
+
+unsigned long
+rdms::copy_in::rows() const {
+	return rows_;
+}
+
+bool
+rdms::copy_in::ok() const {
+	return ok_;
+}
+
+void
+rdms::copy_in::failed( PGresult *res ) {
+	sql_.log_error( statement_.c_str(), res );
+	PQclear( res );
+	ok_ = false;
+	if ( sql_.in_trans_ ) {
+		sql_.trans_error_ = true;
+	}
+}
+
+rdms::copy_in::~copy_in() {
+	if ( copying_ ) {
+		copying_ = false;
+		PQputCopyEnd( sql_.conn, "copy abandoned" );
+		while ( PGresult *res = PQgetResult( sql_.conn ) ) {
+			PQclear( res );
+		}
+		if ( sql_.in_trans_ ) {
+			sql_.trans_error_ = true;
+		}
+	}
+}
+
+
+///////////////////////////// copy_out /////////////////////////////////////////
+
+// write the values bound to stmt in to it as quoted literals, in place of the $n placeholders they were bound to, for
+// statements such as COPY that can't take parameters.  Placeholders inside quoted text, quoted names and comments are
+// left alone.  Like a bound value, the literal has no type of its own, so the server infers it just the same.  The
+// values are escaped as conn, which the statement is to run on, is set up now
+static std::string
+inline_params( PGconn *conn, const std::string& stmt, const std::vector<std::string>& params ) {
+	std::string ret_val;
+	ret_val.reserve( stmt.size() );
+	std::string::size_type i = 0;
+	while ( i < stmt.size() ) {
+		char c = stmt[i];
+		std::string::size_type end = i + 1;
+		if ( '\'' == c ) {
+			// an E'' string may escape its quotes with backslashes, anything else only by doubling them
+			bool backslashes = i && ( 'E' == stmt[ i - 1 ] || 'e' == stmt[ i - 1 ] );
+			while ( end < stmt.size() && '\'' != stmt[ end ] ) {
+				end += ( backslashes && '\\' == stmt[ end ] ) ? 2 : 1;
+			}
+			end = std::min( end + 1, stmt.size() );
+		} else if ( '"' == c ) {
+			end = stmt.find( '"', end );
+			end = std::string::npos == end ? stmt.size() : end + 1;
+		} else if ( '-' == c && end < stmt.size() && '-' == stmt[ end ] ) {
+			end = stmt.find( '\n', end );
+			end = std::string::npos == end ? stmt.size() : end + 1;
+		} else if ( '/' == c && end < stmt.size() && '*' == stmt[ end ] ) {
+			end = stmt.find( "*/", end + 1 );
+			end = std::string::npos == end ? stmt.size() : end + 2;
+		} else if ( '$' == c && i && ( isalnum( static_cast<unsigned char>( stmt[ i - 1 ] ) ) || '_' == stmt[ i - 1 ] ) ) {
+			// part of a name, which may hold dollar signs
+		} else if ( '$' == c && end < stmt.size() && isdigit( static_cast<unsigned char>( stmt[ end ] ) ) ) {
+			unsigned int index = 0;
+			while ( end < stmt.size() && isdigit( static_cast<unsigned char>( stmt[ end ] ) ) ) {
+				index = index * 10 + ( stmt[ end++ ] - '0' );
+			}
+			if ( index && index <= params.size() ) {
+				const std::string& value = params[ index - 1 ];
+				std::string::size_type at = ret_val.size();
+				ret_val.resize( at + value.size() * 2 + 3 );
+				ret_val[ at ] = '\'';
+				size_t written = escape_string( conn, &ret_val[ at + 1 ], value.data(), value.size() );
+				ret_val[ at + written + 1 ] = '\'';
+				ret_val.resize( at + written + 2 );
+				i = end;
+				continue;
+			}
+		} else if ( '$' == c ) {
+			// a dollar quoted string runs from $tag$ to the next $tag$
+			std::string::size_type tag_end = end;
+			while ( tag_end < stmt.size() && ( isalnum( static_cast<unsigned char>( stmt[ tag_end ] ) ) || '_' == stmt[ tag_end ] ) ) {
+				++tag_end;
+			}
+			if ( tag_end < stmt.size() && '$' == stmt[ tag_end ] ) {
+				std::string tag = stmt.substr( i, tag_end - i + 1 );
+				end = stmt.find( tag, tag_end + 1 );
+				end = std::string::npos == end ? stmt.size() : end + tag.size();
+			}
+		}
+		ret_val.append( stmt, i, end - i );
+		i = end;
+	}
+	return ret_val;
+}
+
+rdms::copy_out::copy_out( rdms& sql, result_format format ) :
+	sql_( sql ),
+	statement_( "COPY ( " + inline_params( sql.conn, sql.buffer_.curval(), sql.params_ ) + " ) TO STDOUT" ),
+	chunk_( 0 ),
+	rows_( 0 ),
+	copying_( false ),
+	ok_( false )
+{
+	sql_.abandon_statement();
+	sql_.flush_batch();
+	if ( binary_results == format ) {
+		statement_ += " WITH ( FORMAT binary )";
+	}
+	if ( sql_.in_trans_ && sql_.trans_error_ ) {
+		return;
+	}
+	PGresult *res = PQexec( sql_.conn, statement_.c_str() );
+	if ( PQresultStatus( res ) != PGRES_COPY_OUT ) {
+		this->failed( res );
+		return;
+	}
+	PQclear( res );
+	copying_ = ok_ = true;
+}
+
+bool
+rdms::copy_out::next( const char*& data, int& length ) {
+	if ( chunk_ ) {
+		PQfreemem( chunk_ );
+		chunk_ = 0;
+	}
+	if ( ! copying_ ) {
+		return false;
+	}
+	length = PQgetCopyData( sql_.conn, &chunk_, 0 );
+	if ( length < 0 ) {
+		// -1 is the end of the data, -2 an error.  Either way the result has the rest of the story
+		chunk_ = 0;
+		this->finish();
+		return false;
+	}
+	data = chunk_;
+	return true;
+}
+
+bool
+rdms::copy_out::write_to( int fd ) {
+	const char *data;
+	int length;
+	bool written = true;
+	while ( this->next( data, length ) ) {
+		while ( written && length > 0 ) {
+			ssize_t n = ::write( fd, data, length );
+			if ( n < 0 && EINTR != errno ) {
+				written = false;
+			} else if ( n > 0 ) {
+				data += n;
+				length -= n;
+			}
+		}
+	}
+	return written && ok_;
+}
+
+unsigned long
+rdms::copy_out::rows() const {
+	return rows_;
+}
+
+bool
+rdms::copy_out::ok() const {
+	return ok_;
+}
+
+void
+rdms::copy_out::failed( PGresult *res ) {
+	sql_.log_error( statement_.c_str(), res );
+	PQclear( res );
+	ok_ = false;
+	if ( sql_.in_trans_ ) {
+		sql_.trans_error_ = true;
+	}
+}
+
+void
+rdms::copy_out::finish() {
+	copying_ = false;
+	PGresult *res = PQgetResult( sql_.conn );
+	while ( PGresult *extra = PQgetResult( sql_.conn ) ) {
+		PQclear( extra );
+	}
+	if ( PQresultStatus( res ) != PGRES_COMMAND_OK ) {
+		this->failed( res );
+		return;
+	}
+	rows_ = strtoul( PQcmdTuples( res ), 0, 10 );
+	PQclear( res );
+}
+
+rdms::copy_out::~copy_out() {
+	if ( chunk_ ) {
+		PQfreemem( chunk_ );
+	}
+	if ( ! copying_ ) {
+		return;
+	}
+	// as with result_stream, don't have the server send what won't be read, unless that would abort a transaction
+	if ( ! sql_.in_trans_ ) {
+		if ( PGcancel *cancel = PQgetCancel( sql_.conn ) ) {
+			char err[ 256 ];
+			PQcancel( cancel, err, sizeof( err ) );
+			PQfreeCancel( cancel );
+		}
+	}
+	char *rest;
+	while ( PQgetCopyData( sql_.conn, &rest, 0 ) >= 0 ) {
+		PQfreemem( rest );
+	}
+	while ( PGresult *res = PQgetResult( sql_.conn ) ) {
+		PQclear( res );
+	}
+}
+
+
+rdms::pool_options::pool_options(
+				 int spare_connections,
+				 int min_idle_connections,
+				 int connect_timeout,
+				 int max_connections,
+				 int checkout_timeout,
+				 int maintenance_interval,
+				 int max_lifetime,
+				 int idle_timeout,
+				 int statement_cache_size,
+				 int query_cache_size
+				 ):
+	spare_connections(spare_connections),
+	min_idle_connections(min_idle_connections),
+	connect_timeout(connect_timeout),
+	max_connections(max_connections),
+	checkout_timeout(checkout_timeout),
+	maintenance_interval(maintenance_interval),
+	max_lifetime(max_lifetime),
+	idle_timeout(idle_timeout),
+	statement_cache_size(statement_cache_size),
+	query_cache_size(query_cache_size)
+{ }
+
+rdms::pool_statistics::pool_statistics() :
+	open_connections(0),
+	idle_connections(0),
+	waiting(0),
+	waits(0),
+	timeouts(0),
+	total_wait_ms(0),
+	max_wait_ms(0)
+{ }
+
+
 rdms::connection_string::connection_string(
 					   std::string dbname,
 					   std::string login,
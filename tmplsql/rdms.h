@@ -9,7 +9,12 @@
 #define _TMPLSQL_H_FLAG_
 
 #include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <time.h>
 #include "tmplsql/handle.h"
+#include "tmplsql/text_ref.h"
 extern "C" { 
 #include "postgresql/libpq-fe.h"
 }
@@ -23,6 +28,13 @@ extern "C" {
 */
 namespace tmplsql {
 	class handle;
+	class connection_pool;
+	class async_engine;
+	class async_result;
+
+	namespace detail {
+		template<typename T> struct column_decoder;
+	}
 
 	//!  The base rdms class.
 	/*!
@@ -38,8 +50,9 @@ namespace tmplsql {
 	  This class is meant to be written in a database generic method, so that it is possible to easily switch 
 	  to different RDMS if nessecery, by only modifing this class.
 	  
-	  Thread safety:  If the library is configured with --enable-threads, all that does is insert locking around the 
-	  handle creation and release.  It DOES NOT make the connection handle itself be thread safe.  To do that would be outside
+	  Thread safety:  handle creation and release are safe to call from any thread, and do not take a lock; idle
+	  connections are kept in per thread group shards and stolen between them as needed.  It DOES NOT make the connection
+	  handle itself be thread safe.  To do that would be outside
 	  the scope of this library, as the library only maps onto the lowlevel c api of the database in question, which in most
 	  cases is not thread safe.  Therefore do not share a handle among muliple threads and expect things to work properly.
 
@@ -49,8 +62,21 @@ namespace tmplsql {
 	class rdms : public std::ostream {
 		//! Using the handle class is the only way to get an instance of this class.
 		friend class handle;
+		//! connections are opened, handed out and taken back by the pool they belong to
+		friend class connection_pool;
+		//! drives connections of its own without blocking
+		friend class async_engine;
 	public:
 		struct connection_string;
+		struct pool_options;
+
+		//! how route_reads() spreads reads across replicas
+		enum balance_policy {
+			//! each replica in turn
+			round_robin,
+			//! the replica with the fewest connections checked out
+			least_outstanding
+		};
 
 		//! initialize our rdms connections.
 		/*!
@@ -60,6 +86,62 @@ namespace tmplsql {
 		*/
 		static bool initialize( const connection_string& con,int num_spare_connections = 0 );
 
+		//! initialize our rdms connections, opening pool_options::min_idle_connections of them straight away.
+		/*!
+		  @param con connection information to use to connect to the rdms.
+		  @param options sizing of the connection pool
+		  @return false if any of the connections that were to be opened ahead of time could not be.
+		*/
+		static bool initialize( const connection_string& con, const pool_options& options );
+
+		//! initialize a named pool of connections, for talking to more than one server.
+		/*!
+		  The pools above set up the default pool, which is called "".  Handles are drawn from a named pool
+		  by passing its name to the handle constructor.  Initializing a pool that already exists reconfigures it.
+		  @param pool_name name to register the pool under
+		  @param con connection information to use to connect to the rdms.
+		  @param options sizing of the connection pool
+		  @return false if any of the connections that were to be opened ahead of time could not be.
+		*/
+		static bool initialize( const std::string& pool_name, const connection_string& con, const pool_options& options );
+
+		//! send reads made through handles from one pool to the pools for its replicas.
+		/*!
+		  Once set, select() and single_value() run on a connection checked out from one of the replica pools, picked
+		  according to policy, as long as the handle is not in a transaction and nothing has been exec()'d through it since
+		  it was checked out.  That way a handle always reads its own writes.  If no replica connection can be had the read
+		  runs on the handle's own connection.  Statements that write must therefore go through exec() or insert().
+		  @param pool_name the pool for the primary
+		  @param replica_pools names of the pools for the replicas, which must already be initialized.  An empty list turns routing off.
+		  @param policy how to choose between the replicas
+		  @return false if any of the pools named do not exist
+		*/
+		static bool route_reads( const std::string& pool_name, const std::vector<std::string>& replica_pools,
+					 balance_policy policy = round_robin );
+
+		//! top the pool back up to pool_options::min_idle_connections idle connections.
+		/*!
+		  The missing connections are all opened at once, so this takes about as long as a single connect.
+		  Call it after the database has come back from an outage to avoid the first requests each paying for a reconnect.
+		  @param pool_name pool to top up, defaults to the default pool
+		  @return false if any of the connections could not be opened.
+		*/
+		static bool warm_up( const std::string& pool_name = "" );
+
+		//! look over the idle connections.
+		/*!
+		  Connections the server has dropped are replaced, connections older than pool_options::max_lifetime are recycled,
+		  and connections idle for longer than pool_options::idle_timeout are closed, down to pool_options::min_idle_connections.
+		  The replacements are opened together, off of the request path.
+		  If pool_options::maintenance_interval is set this is called periodically by a background thread, otherwise
+		  it may be called by hand.
+		  @param pool_name pool to look over, defaults to the default pool
+		*/
+		static void check_idle( const std::string& pool_name = "" );
+
+		//! stop the maintenance threads of every pool and close all idle connections.
+		static void shutdown();
+
 		//! closes all rmds connections that are open but not in use.
 		/*!
 		  This method only closes connections that are in use.  To close all connections all handle methods must go out of scope.
@@ -129,15 +211,41 @@ namespace tmplsql {
 		*/
 		static std::string epoch_date(const std::string& field);
 
-		//! abandon stored sql statement set with streams operators
+		//! abandon stored sql statement set with streams operators, and any values bound to it
 		void abandon_statement();
 
+		//! bind a value to the statement being built.
+		/*!
+		  A placeholder for the value, $1 for the first value bound, $2 for the second and so on, is streamed in to the
+		  statement, and the value is sent to the server separately when it is run.  The value needs no quoting, and
+		  statements that differ only in the values bound to them are the same statement to the prepared statement cache,
+		  see pool_options::statement_cache_size.  Usually called by streaming in tmplsql::param().
+		  @param value the text form of the value
+		*/
+		rdms& bind( const std::string& value );
+
+		//! run the statement being built from the prepared statement cache even when it's turned off for everything else.
+		/*!
+		  The statement is prepared with pool_options::query_cache_size as the size of the cache when
+		  pool_options::statement_cache_size is 0.  query<> calls this for the statements it builds with values bound,
+		  which are the same few shapes over and over.
+		*/
+		rdms& cache_statement();
+
+		//! escape length characters of text straight in to the statement being built, enclosed in single quotes.
+		/*! The text is escaped following the settings the connection has at the time, so it is still quoted safely
+		  after a SET standard_conforming_strings part way through a session.  Usually called by streaming in
+		  tmplsql::quoted() */
+		rdms& write_quoted( const char *text, size_t length );
+
 		//! For sql inserts where the value of the sequence column from the new row is needed
 		//! I may have to remove this method eventually, as I'm not sure how the concept of sequences
 		//! maps between other rdms's.  I do know that Oracle, Sybase, and Postgresql support it.
 		/*!
-		 this has a slightly higher overhead than just calling exec(), so if you don't need the sequence value,
-		 just use exec()
+		 The sequence's value is read back with a RETURNING clause, so this is a single round trip just as exec() is.
+		 Statements that already have a RETURNING clause, or that insert the rows of a select, read it back with a
+		 select of its own afterwards, as that could be a great many rows otherwise.
+		 For anything beyond the one value, see returning().
 		 @param sequence name of the sequence to be checked
 		 @return value of sequence
 		*/
@@ -151,6 +259,13 @@ namespace tmplsql {
 		//! return description of last error that occured
 		std::string error_msg();
 
+		//! number of statements run from this connection's prepared statement cache
+		/*! see pool_options::statement_cache_size */
+		unsigned long statement_cache_hits() const;
+
+		//! number of statements run without a prepared statement, while the cache was turned on
+		unsigned long statement_cache_misses() const;
+
 		//! destructor
 		~rdms();
 
@@ -162,10 +277,16 @@ namespace tmplsql {
 		  copies are destroyed, however no such safeguards are done if the rdms handle
 		  is destroyed before the result_set is.  Therefore the handle that created
 		  this should not go out of scope while the result_set is still in use.
+		  Nor should the result_set while any text_ref read from it is.
+		  The rows may have been read in parts, as select_parallel() does, which are iterated over one after another.
 		*/ 
 		class result_set {
 			//! only the rdms class is allowed to create a valid instance of this class
 			friend class rdms;
+			//! which is filled in by the async_engine
+			friend class async_result;
+			//! which reads a column at a time, see recordset::columns()
+			template<typename T> friend struct detail::column_decoder;
 		public:
 			//! copy constructor.  The main constructor is private
 			//! as a result_set can only be created by the rdms class
@@ -256,6 +377,18 @@ namespace tmplsql {
 				//! as thats how the c interface to most (all?) rmds's 
 				//! handle returning values, and efficiency is paramont
 				const char* operator[] ( int index ) const;
+				//! length in bytes of the value in column index, which for binary results is the only way to know it
+				int length( int index ) const;
+				//! is the value in column index null
+				bool is_null( int index ) const;
+				//! was the value in column index sent in binary, see rdms::binary_results
+				bool binary( int index ) const;
+				//! the type of column index, as the rdms's own identifier for it
+				Oid type( int index ) const;
+				//! the value in column index, pointing in to the results rather than copied out of them, see text_ref
+				text_ref text( int index ) const {
+					return text_ref( PQgetvalue( res_, row_, index ), PQgetlength( res_, row_, index ), life_ );
+				}
 				//! return fields_iterator pointing to first column of current row
 				fields_iterator begin();
 				//! return fields_iterator pointing to last colum of current row
@@ -264,13 +397,23 @@ namespace tmplsql {
 				//! our x index is protected so it can be used by other iterators that inherit from rows_iterator
 				int x_index_;
 			private:
-				rows_iterator( PGresult *res , int x_index, int y_index );
+				rows_iterator( PGresult *res , int x_index, int y_index, detail::result_life *life,
+					       const std::vector<PGresult*> *more = 0 );
+				//! move on to the next part with any rows, if past the end of this one
+				void skip_parts();
 				PGresult *res_;
+				// the result_set's, for the text_refs handed out
+				detail::result_life *life_;
 
 				// we calc number only once so we can can
 				// avoid doing it each time
 				// we create do a new row
 				int y_index_;
+				// row within res_, which is x_index_ unless the rows were read in parts
+				int row_;
+				// the parts after the first, and which of them is next
+				const std::vector<PGresult*> *more_;
+				unsigned int next_part_;
 			};
 			//! return rows_iterator pointing to begining of results
 			rows_iterator begin();
@@ -281,16 +424,366 @@ namespace tmplsql {
 			~result_set();
 		private:
 			result_set( PGresult *res );
+			//! rows read in parts, which must all have the same columns.  They are kept as they are, not copied in to one
+			result_set( const std::vector<PGresult*>& parts );
+			//! let go of our share of the results, freeing them if it was the last
+			void release();
+			//! number of parts the rows were read in
+			unsigned int parts() const;
+			//! part index of the rows
+			PGresult* part( unsigned int index ) const;
 			PGresult *res_;
-			unsigned int *count_;
+			detail::result_life *life_;
+			// parts after the first in res_, 0 if there's only the one
+			std::vector<PGresult*> *more_;
 			int num_rows_;
 			int num_fields_;
 		};
+		//! the form values are sent back from the rdms in
+		enum result_format {
+			//! as text, to be parsed by the client
+			text_results = 0,
+			//! in the rdms's own binary form, see detail::decode().  Cheaper to convert to numbers, but only
+			//! understood for some column types.  The statement must be a single statement.
+			binary_results = 1
+		};
+
 		//! execute whatever sql statements have been pushed in to our streambuffer
 		//! and return the results as a result_set.  Gracefully handles situations
 		//! where the statement(s) were not selects, by not the result_set not containing
 		//! any rows.
-		result_set select();
+		result_set select( result_format format = text_results );
+
+		//! run an insert, update or delete as exec() would, getting back columns of the rows it wrote in the same round trip.
+		/*!
+		  " RETURNING " and columns are appended to the statement, so it must not have a RETURNING clause of its own.
+		  For the values typed, see tmplsql::returning.
+		  @param columns what to return, such as "id, created_at"
+		  @param rows set to the rows written, one for each
+		  @param format form to have the rows sent in
+		  @return true if the statement succeeded
+		*/
+		bool returning( const std::string& columns, result_set& rows, result_format format = text_results );
+
+		//! stream in a condition limiting a scan of table to the range of its pages that one worker of select_parallel() reads.
+		/*! The bounds are bound as values, covering the whole table until select_parallel() gives each worker its own.
+		  Usually streamed in by query<>, see query::set_parallel()
+		  @param table the table being scanned, as named in the statement */
+		rdms& page_range( const std::string& table );
+
+		//! run the select in the buffer on several connections at once, each reading part of a table, and give back all the rows together.
+		/*!
+		  The statement must have a page_range() condition on the table to be split up.  The table's pages are divided
+		  between this connection and up to workers - 1 others, taken from the handle's pool for the duration, and
+		  each reads its range of pages from a snapshot exported from this connection, so the rows are those a single
+		  select would have seen.  They come back in no particular order, each worker's rows as a part of the result_set
+		  rather than copied together.
+		  The other workers are only those the pool has idle, or can open without going over max_connections; this never
+		  waits for a connection to be released, and reads with fewer workers instead.
+		  Only PostgreSQL 14 and later read just the pages in the range, with a TID Range Scan.  Older servers read the
+		  whole table on every worker, and throw away the rows outside the range.
+		  In a transaction, or without a page_range() condition, this is the same as select().
+		  @param workers most connections to read with, this one included
+		  @param format form to have the rows sent in
+		*/
+		result_set select_parallel( unsigned int workers, result_format format = text_results );
+
+		//! the rows returned by a statement, fetched from the rdms a few at a time rather than all at once.
+		/*!
+		  The statement in the handle's buffer is sent as soon as the stream is created, and its rows are then read with
+		  next() as they arrive, so only the rows being looked at need be held in memory.  Use stream_recordset rather
+		  than using this directly.
+		  The handle can't be used for anything else until the stream is destroyed.  Destroying the stream before all the
+		  rows have been read cancels the statement, unless in a transaction, where the rest of the rows are read and thrown away.
+		*/
+		class result_stream {
+		public:
+			/*!
+			  @param sql handle holding the statement, which must outlive the stream.  The statement must be a single statement.
+			  @param format form to have the rows sent in
+			  @param chunk_rows number of rows to fetch at a time, where libpq is new enough to fetch more than one
+			*/
+			result_stream( rdms& sql, result_format format = text_results, int chunk_rows = 1000 );
+			//! fetch the next rows
+			/*! @return false once there are no more rows, or the statement failed */
+			bool next( result_set& rows );
+			//! did the statement succeed, as far as it has got
+			bool ok() const;
+			//! cancels the statement if it hasn't been read to the end
+			~result_stream();
+		private:
+			result_stream( const result_stream& );
+			result_stream& operator=( const result_stream& );
+			//! read and discard whatever results are left
+			void finish();
+			rdms& sql_;
+			std::string statement_;
+			bool done_;
+			bool ok_;
+		};
+
+		//! the rows returned by a query, read through a server side cursor a batch at a time.
+		/*!
+		  The query in the handle's buffer is declared as a cursor, in a transaction of its own if the handle isn't in one
+		  already, and its rows are FETCHed fetch_size at a time.  As each batch is handed out by next() the one after it is
+		  asked for, so the server is busy with that while the caller works through the current one.  Use cursor_recordset
+		  rather than using this directly.
+		  As with result_stream, the handle can't be used for anything else until the cursor is destroyed, which closes it,
+		  and commits the transaction if the cursor began it.
+		*/
+		class cursor {
+		public:
+			/*!
+			  @param sql handle holding the query, which must outlive the cursor
+			  @param fetch_size number of rows to fetch at a time
+			  @param format form to have the rows sent in
+			*/
+			cursor( rdms& sql, int fetch_size = 1000, result_format format = text_results );
+			//! fetch the next batch of rows
+			/*! @return false once there are no more rows, or the query failed */
+			bool next( result_set& rows );
+			//! did the query succeed, as far as it has got
+			bool ok() const;
+			//! closes the cursor
+			~cursor();
+		private:
+			cursor( const cursor& );
+			cursor& operator=( const cursor& );
+			//! ask for the next batch, without waiting for it
+			void send_fetch();
+			//! read the batch that was asked for
+			PGresult* receive();
+			//! note that stmt failed with res
+			void failed( const std::string& stmt, PGresult *res );
+			rdms& sql_;
+			std::string name_;
+			std::string fetch_;
+			result_format format_;
+			int fetch_size_;
+			bool own_trans_;
+			bool pending_;
+			bool ok_;
+		};
+
+		//! bulk loads rows in to a table with COPY FROM STDIN.
+		/*!
+		  Rows are appended to buffer() in the COPY format given, and sent to the rdms whenever the buffer
+		  grows past buffer_size.  Nothing is loaded until finish() succeeds; destroying the copy_in before
+		  then abandons the whole load.  Use copy_writer rather than using this directly.
+		  The handle can't be used for anything else while the copy is under way.
+		*/
+		class copy_in {
+		public:
+			/*!
+			  @param sql handle to load through, which must outlive the copy_in
+			  @param table name of the table, optionally followed by a parenthesized list of columns
+			  @param format text_results for COPY's text format, binary_results for its binary one
+			  @param buffer_size number of bytes to collect before sending them
+			*/
+			copy_in( rdms& sql, const std::string& table, result_format format = text_results, int buffer_size = 262144 );
+			//! where rows are to be written to, in full
+			std::string& buffer();
+			//! call after each row is written to buffer(), sends it on if it is full
+			bool row_done();
+			//! send what's left, and end the copy
+			/*! @return true if all the rows were loaded */
+			bool finish();
+			//! number of rows loaded, once finish() has succeeded
+			unsigned long rows() const;
+			//! has everything gone well so far
+			bool ok() const;
+			//! abandons the copy if finish() hasn't been called
+			~copy_in();
+		private:
+			copy_in( const copy_in& );
+			copy_in& operator=( const copy_in& );
+			bool flush();
+			void failed( PGresult *res );
+			rdms& sql_;
+			std::string statement_;
+			std::string buffer_;
+			result_format format_;
+			unsigned int buffer_size_;
+			unsigned long rows_;
+			bool copying_;
+			bool ok_;
+		};
+
+		//! reads the rows of a query with COPY TO STDOUT, a chunk at a time.
+		/*!
+		  The query in the handle's buffer is run as COPY ( query ) TO STDOUT.  COPY can't take parameters, so any values
+		  bound to the query, as by tmplsql::param() or query::set_filter(), are quoted in to it in place of their placeholders.
+		  Each chunk handed out by next() is a single row, in COPY's text or binary format, and is only good until
+		  the next call.  Use copy_reader to have binary rows decoded in to typed values, or write_to() to send the
+		  lot to a file.  The handle can't be used for anything else until the copy_out is destroyed, which cancels
+		  the query if the rows haven't all been read, as result_stream does.
+		*/
+		class copy_out {
+		public:
+			/*!
+			  @param sql handle holding the query, which must outlive the copy_out
+			  @param format text_results for COPY's text format, binary_results for its binary one
+			*/
+			copy_out( rdms& sql, result_format format = text_results );
+			//! fetch the next chunk
+			/*! @return false once there are no more, or the copy failed */
+			bool next( const char*& data, int& length );
+			//! write all the chunks that are left to the file descriptor fd
+			/*! @return true if they were all written */
+			bool write_to( int fd );
+			//! number of rows copied, once they have all been read
+			unsigned long rows() const;
+			//! has everything gone well so far
+			bool ok() const;
+			//! cancels the query if its rows haven't all been read
+			~copy_out();
+		private:
+			copy_out( const copy_out& );
+			copy_out& operator=( const copy_out& );
+			void failed( PGresult *res );
+			//! read the result that follows the last chunk
+			void finish();
+			rdms& sql_;
+			std::string statement_;
+			char *chunk_;
+			unsigned long rows_;
+			bool copying_;
+			bool ok_;
+		};
+
+		class batch;
+
+		//! batches statements up so they all go to the rdms in a single round trip.
+		/*!
+		  Statements are built up in the handle as usual, binding values with tmplsql::param() if wanted, then
+		  queued with add() rather than being run.  run() sends them all at once and waits for all of their results,
+		  which are then available in the order the statements were added.
+		  <pre><code>
+		  tmplsql::handle sql;
+		  tmplsql::rdms::pipeline batch( *sql );
+		  for ( int i = 0; i < 500; ++i ) {
+		      *sql << "insert into foo (bar) values (" << tmplsql::param( i ) << ")";
+		      batch.add();
+		  }
+		  if ( ! batch.run() ) {
+		      std::cerr << sql->error_msg();
+		  }
+		  </code></pre>
+		  Outside of a transaction the statements run as one, as though wrapped in BEGIN and COMMIT: if one fails,
+		  those before it are rolled back and those after it are not run.  Inside a transaction a failure marks the
+		  transaction as failed, as it would for exec().
+		  Each statement must be a single statement.  If libpq is too old to have pipeline mode, the statements are
+		  run one after the other with the same results, just without the savings.
+		*/
+		class pipeline {
+		public:
+			//! batch statements for sql, which must outlive the pipeline
+			pipeline( rdms& sql );
+			//! take the statement in the handle's buffer, and any values bound to it, and queue it to be run
+			void add();
+			//! send every statement queued and wait for the results
+			/*! @return true if they all succeeded.  The error from the first to fail is available from rdms::error_msg() */
+			bool run();
+			//! number of statements queued, or run by the last run()
+			unsigned int size() const;
+			//! did statement index succeed
+			bool ok( unsigned int index ) const;
+			//! rows returned by statement index
+			result_set rows( unsigned int index ) const;
+			//! why statement index failed, empty if it didn't
+			std::string error_msg( unsigned int index ) const;
+		private:
+			pipeline( const pipeline& );
+			pipeline& operator=( const pipeline& );
+
+			// statements as added, text, bound values and the form results are wanted in
+			struct statement {
+				statement() : format( text_results ) { }
+				std::string text;
+				std::vector<std::string> params;
+				result_format format;
+			};
+
+			// hand over the results of statement index, which the pipeline no longer frees
+			PGresult* take( unsigned int index );
+
+			friend class rdms::batch;
+
+			rdms& sql_;
+			std::vector<statement> queued_;
+			std::vector<result_set> results_;
+		};
+
+		//! a transaction whose statements are held back and sent together, along with the COMMIT.
+		/*!
+		  While the batch is alive, exec() queues the statement in the handle's buffer rather than running it, and
+		  returns true straight away.  Nothing is sent until a statement's results are wanted, as with select(),
+		  single_value() or insert(), when BEGIN, everything queued and that statement go out together, and its
+		  results are handed back once the lot have run.  Streaming the results, with result_stream, cursor or
+		  copy_out, sends what's queued first and so takes a round trip of its own.  commit() sends
+		  whatever is still queued along with the COMMIT, so a transaction of statements that return nothing
+		  is a single round trip where begin_trans(), exec() and commit_trans() would take one for each.
+		  <pre><code>
+		  tmplsql::handle sql;
+		  tmplsql::rdms::batch trans( *sql );
+		  *sql << "update accounts set balance = balance - " << tmplsql::param( amount ) << " where id = " << tmplsql::param( from );
+		  sql->exec();
+		  *sql << "update accounts set balance = balance + " << tmplsql::param( amount ) << " where id = " << tmplsql::param( to );
+		  sql->exec();
+		  if ( ! trans.commit() ) {
+		      for ( unsigned int i = 0; i < trans.size(); ++i ) {
+		          if ( ! trans.ok( i ) ) std::cerr << trans.error_msg( i );
+		      }
+		  }
+		  </code></pre>
+		  As errors only come back once the statements have been sent, they are reported per statement, in the order
+		  the statements were exec()'d, and a failure rolls back the whole transaction as it would with begin_trans().
+		  Within the batch, use commit() and abort() rather than commit_trans() and abort_trans().  A batch created
+		  while the handle is already in a transaction, or another batch, does nothing, and statements run as usual.
+		  Each statement must be a single statement, see pipeline.
+		*/
+		class batch {
+		public:
+			//! start batching the statements exec()'d through sql, which must outlive the batch
+			batch( rdms& sql );
+			//! abort()s, unless committed
+			~batch();
+			//! send everything still queued, and commit the transaction
+			/*! @return true if every statement, and the commit, succeeded */
+			bool commit();
+			//! throw away everything still queued, and roll back anything already sent
+			void abort();
+			//! number of statements exec()'d in the batch
+			unsigned int size() const;
+			//! did statement index succeed.  Statements still queued haven't
+			bool ok( unsigned int index ) const;
+			//! why statement index failed, empty if it didn't
+			std::string error_msg( unsigned int index ) const;
+		private:
+			friend class rdms;
+
+			batch( const batch& );
+			batch& operator=( const batch& );
+
+			// queue the statement in the handle's buffer
+			/* @return false if the transaction has already failed */
+			bool queue();
+			// send BEGIN, if it hasn't been, and everything queued, ahead of a statement whose results are wanted
+			void flush();
+			// send BEGIN, if it hasn't been, and everything queued along with stmt, whose results are returned
+			PGresult* read( const char *stmt, const std::vector<std::string>& params, result_format format );
+			// send what's queued, BEGIN and COMMIT as asked for, and record how the statements went.
+			// With reading, the last statement queued is a read, whose outcome isn't recorded
+			bool send( bool begin, bool commit, bool reading = false );
+
+			rdms& sql_;
+			pipeline pipeline_;
+			bool active_;
+			bool begun_;
+			// outcome of each statement sent, empty if it succeeded
+			std::vector<std::string> errors_;
+			std::vector<bool> ok_;
+		};
 
 		//! struct to hold connection details for the rdms.  Before anything may be done,
 		//! this must be passed to 
@@ -324,20 +817,143 @@ namespace tmplsql {
 			
 		};
 
+		//! settings for the pool of connections that handle() draws from.
+		struct pool_options {
+			/**
+			 * @param spare_connections Number of idle connections to leave open before pruning them.
+			 * @param min_idle_connections Number of idle connections that initialize() and warm_up() open ahead of time.
+			 * Can not be more than spare_connections.
+			 * @param connect_timeout seconds to wait for the connections opened by warm_up() before giving up on them.
+			 * @param max_connections hard limit on the number of connections open at once, checked out or idle.  0 means no limit.
+			 * @param checkout_timeout milliseconds handle() will wait for a connection once max_connections are open.  0 means wait forever.
+			 * @param maintenance_interval milliseconds between runs of check_idle() on a background thread.  0 means no thread.
+			 * @param max_lifetime seconds after which a connection is closed and replaced.  0 means never.
+			 * @param idle_timeout seconds an idle connection above min_idle_connections is kept before being closed.  0 means forever.
+			 * @param statement_cache_size number of prepared statements each connection keeps.  0 turns the cache off.
+			 * @param query_cache_size number of query<> statements each connection keeps prepared while statement_cache_size is 0.
+			 * 0 turns that off too.
+			 */
+			pool_options(
+				     int spare_connections=0,
+				     int min_idle_connections=0,
+				     int connect_timeout=10,
+				     int max_connections=0,
+				     int checkout_timeout=0,
+				     int maintenance_interval=0,
+				     int max_lifetime=0,
+				     int idle_timeout=0,
+				     int statement_cache_size=0,
+				     int query_cache_size=64
+				     );
+			//! Number of idle connections to leave open before pruning them.
+			int spare_connections;
+			//! Number of idle connections that initialize() and warm_up() open ahead of time.
+			int min_idle_connections;
+			//! seconds to wait for the connections opened by warm_up() before giving up on them.
+			int connect_timeout;
+			//! hard limit on the number of connections open at once, checked out or idle.  0 means no limit.
+			/*! Once the limit is reached, threads calling handle() queue up and are served first come first served
+			  as connections are released. */
+			int max_connections;
+			//! milliseconds handle() will wait for a connection once max_connections are open.  0 means wait forever.
+			int checkout_timeout;
+			//! milliseconds between runs of check_idle() on a background thread.  0 means no thread.
+			/*! With the thread running, handle() trusts the idle connections it hands out and no longer pings them. */
+			int maintenance_interval;
+			//! seconds after which a connection is closed and replaced.  0 means never.
+			int max_lifetime;
+			//! seconds an idle connection above min_idle_connections is kept before being closed.  0 means forever.
+			int idle_timeout;
+			//! number of prepared statements each connection keeps.  0 turns the cache off.
+			/*! Statements are keyed by their text.  The second time a statement is run on a connection it is prepared,
+			  and from then on runs from the prepared plan until it is pushed out by the cache filling up, least recently
+			  used first.  Statements run only once, such as those with values quoted in to them, therefore cost no more than
+			  they would without the cache, and as they wait on a list of their own until they come round again, a stream of
+			  them can't push out the statements that do.  Text holding more than one statement is never prepared, nor is any
+			  statement the server can't prepare, which is anything but a select, insert, update, delete, values or with.
+			  The cache belongs to the connection, so it lasts from one checkout to the next.  A statement whose plan the
+			  server throws out, because a table it reads has been altered, is prepared again when it's next run outside
+			  of a transaction. */
+			int statement_cache_size;
+			//! number of query<> statements each connection keeps prepared while statement_cache_size is 0.  0 turns that off too.
+			/*! Only the statements query<> builds with filter or limit values bound are cached, see rdms::cache_statement(),
+			  so that they aren't planned all over again for every value.  Set it to 0 for a server reached through a
+			  pooler such as pgbouncer in transaction mode, as it can't follow statements prepared on one of its
+			  connections to the next. */
+			int query_cache_size;
+		};
+
+		//! snapshot of how the connection pool is doing, as returned by statistics()
+		struct pool_statistics {
+			//! ctor, zeros everything
+			pool_statistics();
+			//! connections currently open, checked out or idle
+			int open_connections;
+			//! connections sitting idle in the pool
+			int idle_connections;
+			//! threads currently waiting in handle() for a connection
+			int waiting;
+			//! number of times handle() has had to wait for a connection
+			unsigned long waits;
+			//! number of those waits that ended in a timeout
+			unsigned long timeouts;
+			//! total time spent waiting, in milliseconds
+			double total_wait_ms;
+			//! longest single wait, in milliseconds
+			double max_wait_ms;
+		};
+
+		//! report on a connection pool, by default the default pool
+		static pool_statistics statistics( const std::string& pool_name = "" );
+
 		//! obtain a handle to the rdms
+		/*! @return the handle, or 0 if pool_options::max_connections were in use and none came free
+		  within pool_options::checkout_timeout */
 		static rdms* handle();
 
+		//! obtain a handle from a named pool
+		/*! @return the handle, or 0 if there is no such pool, or as for handle() */
+		static rdms* handle( const std::string& pool_name );
+
 		//! release the handle.
 		void release();
 	private:
-		rdms();
+		rdms( connection_pool *pool );
+
+		//! adopt a connection that has already been established
+		rdms( connection_pool *pool, PGconn *established );
+
+		//! pool the connection belongs to
+		connection_pool *pool_;
 
 		std::string last_error_;
 		//! log error message
-		void log_error( const std::string& sqlstmt,const PGresult *res );
+		void log_error( const char *sqlstmt,const PGresult *res );
 
 		bool connect();
 
+		//! check for a connection the server has dropped, without a round trip
+		bool alive();
+
+		//! run a statement that only reads, on a replica if reads are being routed
+		PGresult* exec_read( const char *stmt, const std::vector<std::string>& params, result_format format = text_results,
+				     bool query_shape = false );
+
+		//! run a statement with the values for its placeholders, from the prepared statement cache if it is turned on
+		/*! @param query_shape the statement was marked by cache_statement(), so is cached by pool_options::query_cache_size
+		  when statement_cache_size is 0 */
+		PGresult* run( const char *stmt, const std::vector<std::string>& params, result_format format = text_results,
+			       bool query_shape = false );
+
+		//! drop a statement prepared on the connection, once any failed transaction is over
+		void deallocate( const std::string& name );
+
+		//! statements to deallocate() that were dropped from the cache while a transaction had failed
+		std::vector<std::string> stale_statements_;
+
+		//! values bound to the statement in the buffer by bind()
+		std::vector<std::string> params_;
+
 		//! The postgres connection.
 		PGconn     *conn;
 
@@ -347,6 +963,24 @@ namespace tmplsql {
 		//! has an error occured during transaction
 		bool trans_error_;
 
+		//! has anything been exec()'d since the handle was checked out.  If so reads are not routed to replicas
+		bool wrote_;
+
+		//! batch holding back statements exec()'d, if one is alive
+		batch *batch_;
+
+		//! table named by the page_range() condition in the buffer
+		std::string range_table_;
+
+		//! index in params_ of the lower bound bound by page_range(), -1 if there is none
+		int range_param_;
+
+		//! has cache_statement() been called for the statement in the buffer
+		bool cache_statement_;
+
+		//! send anything a batch is holding back, ahead of a statement that doesn't go through run()
+		void flush_batch();
+
 		//! Constructor
 		/*! The sql::sql constructor, notice that this is the only one, 
 		  and it takes no arguments, as all configuration comes from our
@@ -355,20 +989,87 @@ namespace tmplsql {
 		//! are we connected to the RDMS?
 		bool connected_;
 
+		//! when the connection was opened
+		time_t created_;
+
+		//! when the handle was last returned to the pool
+		time_t last_used_;
+
+		//! LRU cache of statement text to the name it was prepared under on this connection
+		class statement_cache {
+		public:
+			statement_cache();
+			//! look up stmt, marking it as most recently used.
+			/*! @return where the name it was prepared under is kept, which is empty if it hasn't been prepared yet,
+			  or 0 if stmt isn't in the cache */
+			std::string* find( const std::string& stmt );
+			//! note a sighting of a statement that isn't in the cache.
+			/*! Statements are only let in to the cache the second time they're seen, so that a run of one off statements
+			  can't push out those that are run over and over.  Until then they wait on a probation list of their own,
+			  at most limit long, which drops the oldest first.
+			  @return true if stmt had been seen before, in which case it's taken off the probation list */
+			bool seen_before( const std::string& stmt, unsigned int limit );
+			//! add stmt to the cache as the most recently used statement
+			/*! @return where the name it is prepared under is to be kept */
+			std::string& insert( const std::string& stmt );
+			//! drop the least recently used statement
+			/*! @return the name it was prepared under, empty if it wasn't */
+			std::string evict();
+			//! number of statements held
+			unsigned int size() const;
+			//! forget everything, as when the connection is reset
+			void clear();
+			//! runs from a prepared statement
+			unsigned long hits;
+			//! runs without one
+			unsigned long misses;
+		private:
+			typedef std::map<std::string, std::pair<std::string, std::list<const std::string*>::iterator> > statements_type;
+			//! statement text -> prepared name and position in lru_
+			statements_type statements_;
+			//! keys of statements_, most recently used first
+			std::list<const std::string*> lru_;
+			typedef std::map<std::string, std::list<const std::string*>::iterator> probation_type;
+			//! statements seen once -> position in probation_order_
+			probation_type probation_;
+			//! keys of probation_, most recently seen first
+			std::list<const std::string*> probation_order_;
+		};
+
+		statement_cache statements_;
+
+		//! number used to name the next statement prepared on this connection
+		unsigned long next_statement_;
+
 		//! class to buffer our sql statements that have been inserted by rdms's inherited ostream
-		//! TODO support xsputn
+		/*! Writes go straight in to memory that is kept from one statement to the next, so once a connection has
+		  built a few statements, building another allocates nothing, and the statement is handed to libpq in place. */
 		class sql_stmt_buffer : public std::streambuf {
 		public:
 			sql_stmt_buffer();
 			//! flush buffer
 			std::string flush();
-			//! return contents of buffer
-			std::string curval();
+			//! return a copy of the contents of buffer
+			std::string curval() const;
+			//! the contents of the buffer, nul terminated.  Good until the buffer is next written to or abandoned
+			const char* c_str();
+			//! number of characters in the buffer
+			std::streamsize size() const;
+			//! drop any whitespace and semicolons from the end of the buffer, so that more can be added to the statement
+			void trim_end();
 			//! abandon contents of buffer
 			void abandon();
+			//! escape length characters of text in to the buffer, enclosed in single quotes, as conn has things set up
+			void write_quoted( PGconn *conn, const char *text, size_t length );
 		private:
+			sql_stmt_buffer( const sql_stmt_buffer& );
+			sql_stmt_buffer& operator=( const sql_stmt_buffer& );
+
 			int overflow(int c);
-			std::string buffer_;
+			std::streamsize xsputn( const char *s, std::streamsize n );
+			//! make room for wanted more characters, keeping one spare for the nul c_str() adds
+			void reserve( std::streamsize wanted );
+			std::vector<char> storage_;
 		};
 
 		sql_stmt_buffer buffer_;
@@ -377,5 +1078,7 @@ namespace tmplsql {
 }
 
 
-  
+// the operator<< overloads that write numbers in to statements, which need rdms to be complete
+#include "tmplsql/sql_writer.h"
+
 #endif // _SQL_H_FLAG_
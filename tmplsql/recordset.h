@@ -12,6 +12,8 @@
 #include "tmplsql/handle.h"
 #include <boost/tuple/tuple.hpp>
 #include "tmplsql/lexical_cast.h"
+#include "tmplsql/binary.h"
+#include "tmplsql/columns.h"
 #include <string>
 
 
@@ -36,10 +38,20 @@ namespace tmplsql {
 		//! we should have.  If not an assert is triggered.
 		static const int length =  boost::tuples::length< tuple >::value;
 
-		//! ctor.  Is passed an sql handle and executes the query stored in it. 
+		//! the rows read a column at a time, one tmplsql::column for each type, see columns()
+		typedef boost::tuple< typename detail::make_column<T0>::type, typename detail::make_column<T1>::type,
+				      typename detail::make_column<T2>::type, typename detail::make_column<T3>::type,
+				      typename detail::make_column<T4>::type, typename detail::make_column<T5>::type,
+				      typename detail::make_column<T6>::type, typename detail::make_column<T7>::type,
+				      typename detail::make_column<T8>::type, typename detail::make_column<T9>::type > columns_type;
 
-		recordset( const handle& h ) :
+		//! ctor.  Is passed an sql handle and executes the query stored in it. 
+		/*! @param h handle holding the query
+		  @param format form to have the results sent in.  rdms::binary_results saves parsing numbers out of text,
+		  see detail::decode() for the column types it understands. */
+		recordset( const handle& h, rdms::result_format format = rdms::text_results ) :
 			need_exec_( true ),
+			format_( format ),
 			handle_(h)
 		{ }
 
@@ -56,7 +68,7 @@ namespace tmplsql {
 			template<int Index>
 			typename boost::tuples::element<Index,tuple >::type
 			get(){
-				return lexical_cast< typename boost::tuples::element<Index,tuple >::type >( (*this)[Index] );
+				return detail::decode< typename boost::tuples::element<Index,tuple >::type >( *this, Index );
 			}
 		private:
 			iterator( const rdms::result_set::rows_iterator& ri ) :
@@ -83,6 +95,30 @@ namespace tmplsql {
 			return iterator( rs_.end() );
 		}
 
+		//! read every row at once, a column at a time, in to one vector for each column.
+		/*! Rather than converting a value at a time as the rows are iterated over, each column is converted in a
+		  single pass down the results, which suits summing or otherwise working through a column of many rows.
+		  @param cols where the columns are written, replacing whatever they held */
+		void columns( columns_type& cols ) {
+			if ( need_exec_ ){
+				this->exec();
+			}
+			detail::fill_columns( rs_, 0, cols );
+		}
+
+		//! see columns( columns_type& )
+		columns_type columns() {
+			columns_type ret_val;
+			this->columns( ret_val );
+			return ret_val;
+		}
+
+		//! iterate over rows that were fetched some other way, such as by an async_engine, rather than running the query
+		void assign( const rdms::result_set& rows ){
+			rs_ = rows;
+			need_exec_ = false;
+		}
+
 		//! return the tmplsql::handle that record_set is using
 		handle&
 		get_handle(){
@@ -90,9 +126,10 @@ namespace tmplsql {
 		}
 	private:
 		bool need_exec_;
+		rdms::result_format format_;
 		void exec(){
 			if ( handle_.valid() ){
-				rs_ = handle_->select();
+				rs_ = handle_->select( format_ );
 				need_exec_ = false;
 			}
 		}
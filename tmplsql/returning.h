@@ -0,0 +1,110 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_RETURNING_H_
+#define _TMPLSQL_RETURNING_H_
+
+#include "tmplsql/recordset.h"
+#include <boost/tuple/tuple.hpp>
+#include <vector>
+#include <string>
+
+namespace tmplsql {
+
+	namespace detail {
+
+		//! end of the columns
+		inline void decode_columns( const rdms::result_set::rows_iterator&, int, const boost::tuples::null_type& ) { }
+
+		//! decode each column of row, from index on, in to values
+		template<class H, class T>
+		inline void decode_columns( const rdms::result_set::rows_iterator& row, int index, boost::tuples::cons<H,T>& values ) {
+			values.get_head() = decode<H>( row, index );
+			decode_columns( row, index + 1, values.get_tail() );
+		}
+
+	} // namespace detail
+
+	//! runs the insert, update or delete held in a handle, reading back columns of the rows it wrote in the same round trip.
+	/*!
+	  Saves following an insert with a second query for the keys and defaults the server filled in.  The columns come
+	  back converted to T0 ... T9, one row for each row written, so an insert of many rows gets all of their keys at once.
+	  <pre><code>
+	  tmplsql::handle sql;
+	  *sql << "insert into users (name) values (" << tmplsql::param( name ) << ")";
+	  tmplsql::returning<int,std::string> ret( sql, "id, created_at" );
+	  tmplsql::returning<int,std::string>::row_type row;
+	  if ( ret.first( row ) ) {
+	          std::cout << row.get<0>() << " created " << row.get<1>() << std::endl;
+	  }
+
+	  *sql << "insert into users (name) select name from new_users";
+	  tmplsql::returning<int> ids( sql, "id" );
+	  for ( tmplsql::returning<int>::iterator it = ids.begin(); it != ids.end(); ++it ) {
+	          std::cout << it.get<0>() << std::endl;
+	  }
+	  </code></pre>
+	  See rdms::returning.
+	*/
+	template <  class T0,
+		    class T1 = boost::tuples::null_type, class T2 = boost::tuples::null_type, class T3 = boost::tuples::null_type,
+		    class T4 = boost::tuples::null_type, class T5 = boost::tuples::null_type, class T6 = boost::tuples::null_type,
+		    class T7 = boost::tuples::null_type, class T8 = boost::tuples::null_type, class T9 = boost::tuples::null_type >
+	class returning : public recordset<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> {
+		typedef recordset<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> base;
+	public:
+		//! a row as returned
+		typedef boost::tuple<T0,T1, T2, T3, T4, T5, T6, T7, T8, T9 > row_type;
+
+		//! ctor, runs the statement held in h
+		/*! @param h handle holding the statement
+		  @param columns what to return, such as "id, created_at"
+		  @param format form to have the rows sent in */
+		returning( const handle& h, const std::string& columns, rdms::result_format format = rdms::text_results ) :
+			base( h, format ),
+			ok_( false )
+		{
+			rdms::result_set rows;
+			if ( this->get_handle().valid() ) {
+				ok_ = this->get_handle()->returning( columns, rows, format );
+			}
+			this->assign( rows );
+		}
+
+		//! did the statement succeed
+		bool ok() const {
+			return ok_;
+		}
+
+		//! read the first row returned in to row
+		/*! @return false if no rows were written */
+		bool first( row_type& row ) {
+			typename base::iterator it = this->begin();
+			if ( it == this->end() ) {
+				return false;
+			}
+			detail::decode_columns( it, 0, row );
+			return true;
+		}
+
+		//! every row returned
+		std::vector<row_type> rows() {
+			std::vector<row_type> ret_val;
+			row_type row;
+			for ( typename base::iterator it = this->begin(); it != this->end(); ++it ) {
+				detail::decode_columns( it, 0, row );
+				ret_val.push_back( row );
+			}
+			return ret_val;
+		}
+	private:
+		bool ok_;
+	};
+
+}
+
+#endif // _TMPLSQL_RETURNING_H_
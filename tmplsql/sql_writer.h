@@ -0,0 +1,300 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_SQL_WRITER_H_
+#define _TMPLSQL_SQL_WRITER_H_
+
+#include "tmplsql/rdms.h"
+#include "tmplsql/quote.h"
+#include "tmplsql/lexical_cast.h"
+#include <boost/type_traits.hpp>
+#include <boost/utility/enable_if.hpp>
+#include <limits>
+#include <string>
+#include <iostream>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+namespace tmplsql {
+
+	//! a point in time, written in to a statement as a timestamp with time zone.
+	/*! <pre><code>
+	  *sql << "update users set last_seen = " << tmplsql::timestamp( time( NULL ) ) << " where id = " << id;
+	  </code></pre>
+	*/
+	struct timestamp {
+		//! @param s seconds since the epoch
+		//! @param us microseconds past s
+		explicit timestamp( time_t s, long us = 0 ) : seconds( s ), microseconds( us ) { }
+		//! seconds since the epoch
+		time_t seconds;
+		//! microseconds past seconds
+		long microseconds;
+	};
+
+	namespace detail {
+
+		//! room enough for anything sql_text writes
+		enum { sql_text_size = 48 };
+
+		//! copy the nul terminated text to out, returning the end of what was written
+		inline char* sql_copy( char *out, const char *text ) {
+			size_t length = strlen( text );
+			memcpy( out, text, length );
+			return out + length;
+		}
+
+		//! writes values of type T as SQL text, without regard to any locale.  Only numbers and bool are handled
+		template<typename T, bool Integral = boost::is_integral<T>::value, bool Float = boost::is_float<T>::value >
+		struct sql_text;
+
+		//! integers
+		template<typename T>
+		struct sql_text<T, true, false> {
+			//! write value to out, which must have room for sql_text_size characters
+			/*! Integers are written the same whether or not they go straight in to a statement
+			  @return the end of what was written */
+			static char* write( char *out, T value, bool /*literal*/ = false ) {
+#ifdef TMPLSQL_INTEGER_TO_CHARS
+				return std::to_chars( out, out + sql_text_size, value ).ptr;
+#else
+				char digits[ 24 ];
+				char *p = digits + sizeof( digits );
+				bool negative = value < 0;
+				do {
+					int digit = static_cast<int>( value % 10 );
+					*--p = static_cast<char>( '0' + ( negative ? -digit : digit ) );
+					value /= 10;
+				} while ( value );
+				if ( negative ) {
+					*--p = '-';
+				}
+				memcpy( out, p, digits + sizeof( digits ) - p );
+				return out + ( digits + sizeof( digits ) - p );
+#endif
+			}
+		};
+
+		//! bool, as SQL's own literals.  So streamed in to a statement a bool is true or false, not 1 or 0
+		template<>
+		struct sql_text<bool, true, false> {
+			static char* write( char *out, bool value, bool /*literal*/ = false ) {
+				return sql_copy( out, value ? "true" : "false" );
+			}
+		};
+
+		//! characters are written as themselves, as an ostream would
+		template<typename T>
+		struct sql_char {
+			static char* write( char *out, T value, bool /*literal*/ = false ) {
+				*out = static_cast<char>( value );
+				return out + 1;
+			}
+		};
+
+		//! char
+		template<>
+		struct sql_text<char, true, false> : public sql_char<char> { };
+
+		//! signed char
+		template<>
+		struct sql_text<signed char, true, false> : public sql_char<signed char> { };
+
+		//! unsigned char
+		template<>
+		struct sql_text<unsigned char, true, false> : public sql_char<unsigned char> { };
+
+		//! floating point, with enough digits that the value makes the round trip intact
+		template<typename T>
+		struct sql_text<T, false, true> {
+			static char* write( char *out, T value, bool literal = false ) {
+				// SQL has no bare literals for these, so in a statement they have to be quoted
+				if ( value != value ) {
+					return sql_copy( out, literal ? "'NaN'" : "NaN" );
+				} else if ( value == std::numeric_limits<T>::infinity() ) {
+					return sql_copy( out, literal ? "'Infinity'" : "Infinity" );
+				} else if ( value == -std::numeric_limits<T>::infinity() ) {
+					return sql_copy( out, literal ? "'-Infinity'" : "-Infinity" );
+				}
+#ifdef TMPLSQL_FLOAT_TO_CHARS
+				return std::to_chars( out, out + sql_text_size, value ).ptr;
+#else
+				// the fewest digits that read back as the same value, usually digits10
+				int length = snprintf( out, sql_text_size, "%.*g", std::numeric_limits<T>::digits10, static_cast<double>( value ) );
+				if ( static_cast<T>( strtod( out, NULL ) ) != value ) {
+					length = snprintf( out, sql_text_size, "%.*g", std::numeric_limits<T>::digits10 + 3, static_cast<double>( value ) );
+				}
+				// the decimal point is the locale's, but SQL's is always '.'
+				for ( int i = 0; i < length; ++i ) {
+					if ( ',' == out[i] ) {
+						out[i] = '.';
+					}
+				}
+				return out + length;
+#endif
+			}
+		};
+
+		//! write when to out as 'YYYY-MM-DD HH:MM:SS.ffffff+00', without the quotes
+		/*! Microseconds outside of a second are carried in to the seconds first.  Years after 9999 take as many
+		  digits as they need, and years before 1 AD are written as the server writes them, counting back from 1 BC
+		  with BC on the end.
+		  @return the end of what was written, or 0 if when is too far off to be broken down in to a date */
+		inline char* timestamp_text( char *out, const timestamp& when ) {
+			time_t seconds = when.seconds + when.microseconds / 1000000;
+			long microseconds = when.microseconds % 1000000;
+			if ( microseconds < 0 ) {
+				microseconds += 1000000;
+				--seconds;
+			}
+			struct tm parts;
+			if ( ! gmtime_r( &seconds, &parts ) ) {
+				return 0;
+			}
+			// there's no year 0, the year before 1 AD is 1 BC
+			long long year = parts.tm_year + 1900LL;
+			bool bc = year < 1;
+			if ( bc ) {
+				year = 1 - year;
+			}
+			char digits[ 24 ];
+			char *p = digits + sizeof( digits );
+			do {
+				*--p = static_cast<char>( '0' + year % 10 );
+				year /= 10;
+			} while ( year || digits + sizeof( digits ) - p < 4 );
+			memcpy( out, p, digits + sizeof( digits ) - p );
+			out += digits + sizeof( digits ) - p;
+			*out++ = '-';
+			int fields[5] = { parts.tm_mon + 1, parts.tm_mday, parts.tm_hour, parts.tm_min, parts.tm_sec };
+			const char separators[5] = { '-', ' ', ':', ':', 0 };
+			for ( int i = 0; i < 5; ++i ) {
+				out[0] = static_cast<char>( '0' + fields[i] / 10 );
+				out[1] = static_cast<char>( '0' + fields[i] % 10 );
+				out += 2;
+				if ( separators[i] ) {
+					*out++ = separators[i];
+				}
+			}
+			if ( microseconds ) {
+				*out++ = '.';
+				for ( int d = 5, v = microseconds; d >= 0; --d, v /= 10 ) {
+					out[d] = static_cast<char>( '0' + v % 10 );
+				}
+				out += 6;
+			}
+			out = sql_copy( out, "+00" );
+			return bc ? sql_copy( out, " BC" ) : out;
+		}
+
+		//! write value in to str, going through sql_text if it's a number or bool, otherwise as str would
+		template<typename T, bool Number = boost::is_arithmetic<T>::value >
+		struct sql_writer {
+			static void write( std::ostream& str, const T& value ) {
+				str << value;
+			}
+		};
+
+		//! numbers and bool
+		template<typename T>
+		struct sql_writer<T, true> {
+			static void write( std::ostream& str, T value ) {
+				char text[ sql_text_size ];
+				str.write( text, sql_text<T>::write( text, value, true ) - text );
+			}
+		};
+
+		//! holds a value being streamed by sql_value()
+		template<typename T>
+		struct sql_value_t {
+			sql_value_t( const T& v ) : value( v ) { }
+			const T& value;
+		};
+
+	} // namespace detail
+
+	//! stream a value in to a statement as SQL text.
+	/*!
+	  Numbers and bools are written without going through the stream's locale and formatting, so they're quicker,
+	  a double makes the round trip intact, and a bool comes out as true or false.  Anything else is streamed as usual.
+	  Numbers streamed straight in to a rdms handle are written this way anyway.
+	*/
+	template<typename T>
+	inline detail::sql_value_t<T> sql_value( const T& value ) {
+		return detail::sql_value_t<T>( value );
+	}
+
+} // namespace tmplsql
+
+//! write the value held by tmplsql::sql_value() to str
+template<typename T>
+inline std::ostream& operator<<( std::ostream& str, const tmplsql::detail::sql_value_t<T>& v ) {
+	tmplsql::detail::sql_writer<T>::write( str, v.value );
+	return str;
+}
+
+//! write a timestamp to str, quoted.  One too far off to be written sets failbit on str and writes nothing
+inline std::ostream& operator<<( std::ostream& str, const tmplsql::timestamp& when ) {
+	char text[ tmplsql::detail::sql_text_size ];
+	text[0] = '\'';
+	char *end = tmplsql::detail::timestamp_text( text + 1, when );
+	if ( ! end ) {
+		str.setstate( std::ios_base::failbit );
+		return str;
+	}
+	*end++ = '\'';
+	str.write( text, end - text );
+	return str;
+}
+
+//! numbers and bools streamed in to a statement are written by tmplsql::sql_value()
+template<typename T>
+inline typename boost::enable_if< boost::is_arithmetic<T>, tmplsql::rdms& >::type
+operator<<( tmplsql::rdms& sql, T value ) {
+	tmplsql::detail::sql_writer<T>::write( sql, value );
+	return sql;
+}
+
+//! text is copied in to the statement as it is, and the rdms handle handed back so the numbers after it go through sql_value() too
+inline tmplsql::rdms& operator<<( tmplsql::rdms& sql, const char *text ) {
+	if ( text ) {
+		sql.write( text, strlen( text ) );
+	} else {
+		sql.setstate( std::ios_base::badbit );
+	}
+	return sql;
+}
+
+//! see operator<<( tmplsql::rdms&, const char* )
+inline tmplsql::rdms& operator<<( tmplsql::rdms& sql, const std::string& text ) {
+	sql.write( text.data(), text.size() );
+	return sql;
+}
+
+namespace tmplsql {
+	namespace detail {
+
+		//! write a number or bool in to str as a literal, through sql_text
+		template<typename T>
+		inline typename boost::enable_if< boost::is_arithmetic<T> >::type
+		write_literal( std::ostream& str, T value ) {
+			sql_writer<T>::write( str, value );
+		}
+
+		//! write anything else in to str as a literal: text quoted, as tmplsql::quoted() does, the rest as str would
+		template<typename T>
+		inline typename boost::disable_if< boost::is_arithmetic<T> >::type
+		write_literal( std::ostream& str, const T& value ) {
+			str << quoted( value );
+		}
+
+	} // namespace detail
+} // namespace tmplsql
+
+#endif // _TMPLSQL_SQL_WRITER_H_
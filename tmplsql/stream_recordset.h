@@ -0,0 +1,182 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_STREAM_RECORDSET_H_
+#define _TMPLSQL_STREAM_RECORDSET_H_
+
+#include "tmplsql/handle.h"
+#include "tmplsql/binary.h"
+#include <boost/tuple/tuple.hpp>
+
+namespace tmplsql {
+
+	namespace detail {
+
+		//! iterator over rows that arrive a few at a time.
+		/*!
+		  Source must provide bool next( rdms::result_set& ), filling in the next batch of rows and returning false once
+		  there are none left.  Only the batch the iterator is on is kept, so the rows it has moved past can be freed.
+		  This is a single pass iterator: copies share the Source, and moving one on moves on what the others will see
+		  once they leave their current batch.
+		*/
+		template <class Source, class Tuple>
+		class chunk_iterator {
+		public:
+			//! ctor.  an iterator created by this method is at the end of the rows
+			chunk_iterator() :
+				source_( 0 )
+			{ }
+
+			//! ctor, positioned on the first row source has left
+			explicit chunk_iterator( Source *source ) :
+				source_( source )
+			{
+				this->fetch();
+			}
+
+			//! returns converted value of field at Index
+			template<int Index>
+			typename boost::tuples::element<Index,Tuple >::type
+			get(){
+				return detail::decode< typename boost::tuples::element<Index,Tuple >::type >( row_, Index );
+			}
+
+			//! raw value of field at index
+			const char* operator[] ( int index ) const {
+				return row_[ index ];
+			}
+
+			//! move to next row
+			chunk_iterator& operator++() {
+				++row_;
+				if ( row_ == chunk_.end() ) {
+					this->fetch();
+				}
+				return *this;
+			}
+
+			//! move to next row
+			chunk_iterator operator++(int) {
+				chunk_iterator ret_val( *this );
+				++*this;
+				return ret_val;
+			}
+
+			//! test for equality against another chunk_iterator
+			bool operator==( const chunk_iterator& it ) const {
+				return source_ == it.source_ && ( ! source_ || row_ == it.row_ );
+			}
+
+			//! test for inequality against another chunk_iterator
+			bool operator!=( const chunk_iterator& it ) const {
+				return ! ( *this == it );
+			}
+		private:
+			// move on to the next batch that has any rows in it, or to the end
+			void fetch() {
+				do {
+					if ( ! source_->next( chunk_ ) ) {
+						chunk_ = rdms::result_set();
+						source_ = 0;
+						return;
+					}
+					row_ = chunk_.begin();
+				} while ( row_ == chunk_.end() );
+			}
+
+			Source *source_;
+			rdms::result_set chunk_;
+			rdms::result_set::rows_iterator row_;
+		};
+
+	} // namespace detail
+
+	//! a recordset that reads its rows from the rdms as it goes, rather than all at once.
+	/*!
+	  Used just like recordset, but meant for results too large to hold in memory.  Rows are fetched one at a time, or
+	  a batch of chunk_rows at a time where libpq supports it, so only the rows the iterator is on are held.
+
+	  It can be iterated over just once: a second call to begin() carries on from where the first left off.
+	  Nothing else may be done with the handle until the stream_recordset is destroyed.  Destroying it before all the
+	  rows have been read cancels the query, see rdms::result_stream.
+	  <pre><code>
+	  tmplsql::handle sql;
+	  *sql << "select id, name from users";
+	  tmplsql::stream_recordset<int,std::string> rs( sql );
+	  for ( tmplsql::stream_recordset<int,std::string>::iterator it = rs.begin(); it != rs.end(); ++it ) {
+	          std::cout << it.get<0>() << " " << it.get<1>() << std::endl;
+	  }
+	  </code></pre>
+	*/
+	template <  class T0,
+		    class T1 = boost::tuples::null_type, class T2 = boost::tuples::null_type, class T3 = boost::tuples::null_type,
+		    class T4 = boost::tuples::null_type, class T5 = boost::tuples::null_type, class T6 = boost::tuples::null_type,
+		    class T7 = boost::tuples::null_type, class T8 = boost::tuples::null_type, class T9 = boost::tuples::null_type >
+	class stream_recordset {
+		typedef boost::tuple<T0,T1, T2, T3, T4, T5, T6, T7, T8, T9 > tuple;
+	public:
+		//! number of types we were passed
+		static const int length =  boost::tuples::length< tuple >::value;
+
+		//! iterator over the rows, see detail::chunk_iterator
+		typedef detail::chunk_iterator< rdms::result_stream, tuple > iterator;
+
+		//! ctor.  Is passed an sql handle holding the query, which is sent by begin()
+		/*! @param h handle holding the query
+		  @param format form to have the results sent in, see recordset
+		  @param chunk_rows number of rows to fetch at a time where libpq can, it fetches one at a time otherwise */
+		stream_recordset( const handle& h, rdms::result_format format = rdms::text_results, int chunk_rows = 1000 ) :
+			format_( format ),
+			chunk_rows_( chunk_rows ),
+			stream_( 0 ),
+			handle_( h )
+		{ }
+
+		//! cancels the query if its rows haven't all been read
+		~stream_recordset() {
+			delete stream_;
+		}
+
+		//! send the query if it hasn't been yet, and return the first row not yet read
+		iterator begin() {
+			if ( ! stream_ ) {
+				if ( ! handle_.valid() ) {
+					return iterator();
+				}
+				stream_ = new rdms::result_stream( *handle_, format_, chunk_rows_ );
+			}
+			return iterator( stream_ );
+		}
+
+		//! end of results
+		iterator end() {
+			return iterator();
+		}
+
+		//! has the query succeeded so far.  An error part way through the rows ends them early
+		bool ok() const {
+			return stream_ && stream_->ok();
+		}
+
+		//! return the tmplsql::handle that stream_recordset is using
+		handle&
+		get_handle(){
+			return handle_;
+		}
+	private:
+		stream_recordset( const stream_recordset& );
+		stream_recordset& operator=( const stream_recordset& );
+
+		rdms::result_format format_;
+		int chunk_rows_;
+		rdms::result_stream *stream_;
+		handle handle_;
+	};
+
+}
+
+#endif // _TMPLSQL_STREAM_RECORDSET_H_
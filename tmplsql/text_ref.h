@@ -0,0 +1,226 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * $Id$
+ * Copyright (C) 2002 Nathan Stitt
+ * See file COPYING for use and distribution permission.
+ */
+
+#ifndef _TMPLSQL_TEXT_REF_H_
+#define _TMPLSQL_TEXT_REF_H_
+
+#include <string>
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+
+#if __cplusplus >= 201703L && defined( __has_include )
+#  if __has_include( <string_view> )
+#    include <string_view>
+#    define TMPLSQL_STRING_VIEW 1
+#  endif
+#endif
+
+namespace tmplsql {
+
+	namespace detail {
+
+		//! how many copies of a rdms::result_set share its results, and how many text_refs point in to them
+		struct result_life {
+			result_life() : results( 1 ), views( 0 ) { }
+			//! copies of the result_set, the results are freed when this reaches 0
+			unsigned int results;
+			//! text_refs in to the results, which hold on to this so as to tell when the results are gone
+			unsigned int views;
+		};
+
+	} // namespace detail
+
+	//! the text of a value, pointing in to the results it was read from rather than copied out of them.
+	/*!
+	  Reading a column in to a text_ref rather than a std::string saves an allocation and a copy for each value, which
+	  adds up over a scan of many rows of text.  It is only good while the rdms::result_set it was read from, or a copy
+	  of it, is around.  With check_lifetime set, using a text_ref after that aborts with a message saying so.
+	  <pre><code>
+	  *sql << "select name from users";
+	  tmplsql::recordset<tmplsql::text_ref> rs( sql );
+	  for ( tmplsql::recordset<tmplsql::text_ref>::iterator it = rs.begin(); it != rs.end(); ++it ) {
+	          tmplsql::text_ref name = it.get<0>();
+	          lengths += name.size();
+	  }
+	  </code></pre>
+	  A binary result is referred to as it was sent, so text_ref is for the text types whichever form results are sent in.
+	*/
+	class text_ref {
+	public:
+		//! an empty text_ref
+		text_ref() :
+			data_( "" ),
+			size_( 0 ),
+			life_( 0 )
+		{ }
+
+		//! refer to size characters at data
+		/*! @param life the results data points in to, which are checked for if check_lifetime is set */
+		text_ref( const char *data, size_t size, detail::result_life *life = 0 ) :
+			data_( data ),
+			size_( size ),
+			life_( life )
+		{
+			if ( life_ ) {
+				++life_->views;
+			}
+		}
+
+		//! copy ctor
+		text_ref( const text_ref& t ) :
+			data_( t.data_ ),
+			size_( t.size_ ),
+			life_( t.life_ )
+		{
+			if ( life_ ) {
+				++life_->views;
+			}
+		}
+
+		//! assignment
+		text_ref& operator=( const text_ref& t ) {
+			if ( t.life_ ) {
+				++t.life_->views;
+			}
+			this->release();
+			life_ = t.life_;
+			data_ = t.data_;
+			size_ = t.size_;
+			return *this;
+		}
+
+		//! dtor
+		~text_ref() {
+			this->release();
+		}
+
+		//! the text, which is not nul terminated if the text_ref was made from part of a string
+		const char* data() const {
+			this->check();
+			return data_;
+		}
+
+		//! number of characters
+		size_t size() const {
+			return size_;
+		}
+
+		//! number of characters
+		size_t length() const {
+			return size_;
+		}
+
+		//! is the text empty
+		bool empty() const {
+			return ! size_;
+		}
+
+		//! start of the text
+		const char* begin() const {
+			return this->data();
+		}
+
+		//! end of the text
+		const char* end() const {
+			return this->data() + size_;
+		}
+
+		//! the character at index
+		char operator[]( size_t index ) const {
+			return this->data()[ index ];
+		}
+
+		//! copy the text out in to a std::string, which is good for as long as need be
+		std::string str() const {
+			return std::string( this->data(), size_ );
+		}
+
+#ifdef TMPLSQL_STRING_VIEW
+		//! the text as a std::string_view, good for as long as the text_ref is
+		operator std::string_view() const {
+			return std::string_view( this->data(), size_ );
+		}
+#endif
+
+		//! is the text the same as t's
+		bool operator==( const text_ref& t ) const {
+			return size_ == t.size_ && ! memcmp( this->data(), t.data(), size_ );
+		}
+
+		//! is the text the same as s
+		bool operator==( const std::string& s ) const {
+			return size_ == s.size() && ! memcmp( this->data(), s.data(), size_ );
+		}
+
+		//! is the text the same as s
+		bool operator==( const char *s ) const {
+			return ! strncmp( this->data(), s, size_ ) && ! s[ size_ ];
+		}
+
+		//! is the text different to t's
+		bool operator!=( const text_ref& t ) const {
+			return ! ( *this == t );
+		}
+
+		//! is the text different to s
+		bool operator!=( const std::string& s ) const {
+			return ! ( *this == s );
+		}
+
+		//! is the text different to s
+		bool operator!=( const char *s ) const {
+			return ! ( *this == s );
+		}
+
+		//! abort when a text_ref is used after the results it points in to have been freed.
+		/*! The results are always kept track of, so this may be turned on and off at any time.  On by default when
+		  the library is built with DEBUG defined */
+		static bool check_lifetime;
+
+	private:
+		//! if check_lifetime is set, make sure the results pointed in to are still there
+		void check() const {
+			if ( check_lifetime && life_ && ! life_->results ) {
+				std::cerr << "tmplsql::text_ref used after the result_set it points in to was freed" << std::endl;
+				abort();
+			}
+		}
+
+		//! stop counting as a view of the results, freeing what's left of them if they're gone
+		void release() {
+			if ( life_ && 0 == --life_->views && ! life_->results ) {
+				delete life_;
+			}
+			life_ = 0;
+		}
+
+		const char *data_;
+		size_t size_;
+		// counted as a view of the results while held, and freed by the last to let go of it once they're gone
+		detail::result_life *life_;
+	};
+
+	//! is the text of t the same as s
+	inline bool operator==( const std::string& s, const text_ref& t ) {
+		return t == s;
+	}
+
+	//! is the text of t the same as s
+	inline bool operator==( const char *s, const text_ref& t ) {
+		return t == s;
+	}
+
+} // namespace tmplsql
+
+//! write the text of t to str
+inline std::ostream& operator<<( std::ostream& str, const tmplsql::text_ref& t ) {
+	str.write( t.data(), t.size() );
+	return str;
+}
+
+#endif // _TMPLSQL_TEXT_REF_H_
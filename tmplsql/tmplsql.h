@@ -10,7 +10,16 @@
 
 #include "tmplsql/commas.h"
 #include "tmplsql/rdms.h"
+#include "tmplsql/text_ref.h"
+#include "tmplsql/sql_writer.h"
 #include "tmplsql/recordset.h"
+#include "tmplsql/columns.h"
+#include "tmplsql/returning.h"
+#include "tmplsql/stream_recordset.h"
+#include "tmplsql/cursor_recordset.h"
+#include "tmplsql/copy_writer.h"
+#include "tmplsql/copy_reader.h"
+#include "tmplsql/async.h"
 #include "tmplsql/handle.h"
 #include "tmplsql/fields.h"
 #include "tmplsql/row_saver.h"